@@ -13,16 +13,27 @@ layout(binding = 0) uniform UniformBufferObject
   mat4 proj;
 } ubo;
 
+// Undoes the normalization of quantized vertex attributes (MeshDequantization)
+layout(push_constant) uniform Dequantization
+{
+  vec4 positionScale;
+  vec4 positionOffset;
+  vec4 texCoordScaleOffset; // xy scale, zw offset
+} dequant;
+
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
+layout(location = 1) in vec2 inTexCoord;
 
-layout(location = 0) out vec3 fragColor;
-layout(location = 1) out vec2 fragTexCoord;
+// Per instance placement of the model, see Scene
+layout(location = 2) in mat4 instanceTransform;
+
+layout(location = 0) out vec2 fragTexCoord;
 
 void main()
 {
-  gl_Position  = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-  fragColor    = inColor;
-  fragTexCoord = inTexCoord;
+  vec3 position = dequant.positionOffset.xyz + dequant.positionScale.xyz * inPosition;
+
+  gl_Position  = ubo.proj * ubo.view * ubo.model * instanceTransform * vec4(position, 1.0);
+  fragTexCoord = dequant.texCoordScaleOffset.zw +
+                 dequant.texCoordScaleOffset.xy * inTexCoord;
 }
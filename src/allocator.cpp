@@ -0,0 +1,293 @@
+#include "common.hpp"
+#include "allocator.hpp"
+#include "device.hpp"
+#include "utils.hpp"
+
+static VkDeviceSize AlignUp( VkDeviceSize value, VkDeviceSize alignment )
+{
+    return ( alignment > 1 )
+        ? ( value + alignment - 1 ) / alignment * alignment
+        : value;
+}
+
+void MemoryAllocator::init( Device*      device,
+                            VkDeviceSize blockSize )
+{
+    this->device    = device;
+    this->blockSize = blockSize;
+
+    vkGetPhysicalDeviceMemoryProperties( this->device->physicalDevice,
+                                         &this->memoryProperties );
+
+    this->pools.clear();
+    this->pools.resize( this->memoryProperties.memoryTypeCount * 2 );
+}
+
+void MemoryAllocator::deinit()
+{
+    for ( auto& pool : this->pools )
+    {
+        for ( auto& block : pool.blocks )
+        {
+            this->releaseBlock( block );
+        }
+    }
+    this->pools.clear();
+}
+
+Allocation MemoryAllocator::allocate( const VkMemoryRequirements& requirements,
+                                      VkMemoryPropertyFlags       properties,
+                                      AllocationType              type )
+{
+    assert( this->device != nullptr );
+
+    uint32_t memoryType = FindMemoryType( this->device->physicalDevice,
+                                          requirements.memoryTypeBits,
+                                          properties );
+    uint32_t poolIdx    = memoryType * 2 + (uint32_t)type;
+    Pool&    pool       = this->pools[ poolIdx ];
+
+    Allocation allocation;
+    allocation.pool = poolIdx;
+    allocation.size = requirements.size;
+
+    // Try existing blocks first, largest resources get a block of their own.
+    bool dedicated = ( requirements.size > this->blockSize / 2 );
+    if ( !dedicated )
+    {
+        for ( uint32_t i = 0; i < pool.blocks.size(); i++ )
+        {
+            Block& block = pool.blocks[ i ];
+
+            if ( block.memory != VK_NULL_HANDLE && !block.dedicated &&
+                 this->allocateFromBlock( block,
+                                          requirements.size,
+                                          requirements.alignment,
+                                          &allocation.offset ) )
+            {
+                allocation.block = i;
+                break;
+            }
+        }
+    }
+
+    if ( allocation.block == UINT32_MAX )
+    {
+        VkDeviceSize size = dedicated ? requirements.size : this->blockSize;
+
+        allocation.block = this->createBlock( pool, memoryType, size, dedicated );
+
+        bool success = this->allocateFromBlock( pool.blocks[ allocation.block ],
+                                                requirements.size,
+                                                requirements.alignment,
+                                                &allocation.offset );
+        assert( success );
+        (void)success;
+    }
+
+    Block& block = pool.blocks[ allocation.block ];
+
+    allocation.memory = block.memory;
+    if ( block.mapped != nullptr )
+    {
+        allocation.mapped = (uint8_t*)block.mapped + allocation.offset;
+    }
+
+    return allocation;
+}
+
+void MemoryAllocator::free( Allocation& allocation )
+{
+    if ( allocation.memory == VK_NULL_HANDLE )
+    {
+        return;
+    }
+
+    assert( allocation.pool < this->pools.size() );
+    Block& block = this->pools[ allocation.pool ].blocks[ allocation.block ];
+
+    // Insert the range back in offset order and merge it with its neighbours.
+    Range range = { allocation.offset, allocation.size };
+
+    auto it = block.freeRanges.begin();
+    while ( it != block.freeRanges.end() && it->offset < range.offset )
+    {
+        ++it;
+    }
+    it = block.freeRanges.insert( it, range );
+
+    if ( it + 1 != block.freeRanges.end() &&
+         it->offset + it->size == ( it + 1 )->offset )
+    {
+        it->size += ( it + 1 )->size;
+        block.freeRanges.erase( it + 1 );
+    }
+    if ( it != block.freeRanges.begin() &&
+         ( it - 1 )->offset + ( it - 1 )->size == it->offset )
+    {
+        ( it - 1 )->size += it->size;
+        block.freeRanges.erase( it );
+    }
+
+    block.used -= allocation.size;
+
+    if ( block.dedicated && block.used == 0 )
+    {
+        this->releaseBlock( block );
+    }
+
+    allocation = Allocation();
+}
+
+uint32_t MemoryAllocator::getBlockCount() const
+{
+    uint32_t count = 0;
+
+    for ( auto& pool : this->pools )
+    {
+        for ( auto& block : pool.blocks )
+        {
+            count += ( block.memory != VK_NULL_HANDLE ) ? 1 : 0;
+        }
+    }
+
+    return count;
+}
+
+VkDeviceSize MemoryAllocator::getUsedBytes() const
+{
+    VkDeviceSize used = 0;
+
+    for ( auto& pool : this->pools )
+    {
+        for ( auto& block : pool.blocks )
+        {
+            used += block.used;
+        }
+    }
+
+    return used;
+}
+
+uint32_t MemoryAllocator::createBlock( Pool&        pool,
+                                       uint32_t     memoryType,
+                                       VkDeviceSize size,
+                                       bool         dedicated )
+{
+    // Reuse a released slot so indices held by live allocations stay valid.
+    uint32_t idx = 0;
+    while ( idx < pool.blocks.size() &&
+            pool.blocks[ idx ].memory != VK_NULL_HANDLE )
+    {
+        idx++;
+    }
+    if ( idx == pool.blocks.size() )
+    {
+        pool.blocks.emplace_back();
+    }
+
+    Block& block = pool.blocks[ idx ];
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize  = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VK_CHECK_RESULT( this->device->allocateMemory( &allocInfo,
+                                                   &block.memory ) );
+
+    block.size      = size;
+    block.used      = 0;
+    block.mapped    = nullptr;
+    block.dedicated = dedicated;
+    block.freeRanges.assign( 1, Range{ 0, size } );
+
+    // Host visible blocks stay mapped for their whole lifetime.
+    if ( this->memoryProperties.memoryTypes[ memoryType ].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT )
+    {
+        VK_CHECK_RESULT( this->device->mapMemory( block.memory,
+                                                  0,
+                                                  VK_WHOLE_SIZE,
+                                                  0,
+                                                  &block.mapped ) );
+    }
+
+    return idx;
+}
+
+void MemoryAllocator::releaseBlock( Block& block )
+{
+    if ( block.memory == VK_NULL_HANDLE )
+    {
+        return;
+    }
+
+    if ( block.mapped != nullptr )
+    {
+        this->device->unmapMemory( block.memory );
+        block.mapped = nullptr;
+    }
+
+    this->device->freeMemory( block.memory );
+    block.memory = VK_NULL_HANDLE;
+    block.size   = 0;
+    block.used   = 0;
+    block.freeRanges.clear();
+}
+
+bool MemoryAllocator::allocateFromBlock( Block&        block,
+                                         VkDeviceSize  size,
+                                         VkDeviceSize  alignment,
+                                         VkDeviceSize* offset )
+{
+    // Best fit: pick the free range that leaves the least space behind.
+    std::size_t  best      = block.freeRanges.size();
+    VkDeviceSize bestWaste = UINT64_MAX;
+
+    for ( std::size_t i = 0; i < block.freeRanges.size(); i++ )
+    {
+        const Range& range   = block.freeRanges[ i ];
+        VkDeviceSize aligned = AlignUp( range.offset, alignment );
+        VkDeviceSize padding = aligned - range.offset;
+
+        if ( range.size < padding + size )
+        {
+            continue;
+        }
+
+        VkDeviceSize waste = range.size - padding - size;
+        if ( waste < bestWaste )
+        {
+            best      = i;
+            bestWaste = waste;
+        }
+    }
+
+    if ( best == block.freeRanges.size() )
+    {
+        return false;
+    }
+
+    Range        range   = block.freeRanges[ best ];
+    VkDeviceSize aligned = AlignUp( range.offset, alignment );
+    VkDeviceSize end     = range.offset + range.size;
+
+    // Split the range into the padding before and the remainder after.
+    block.freeRanges.erase( block.freeRanges.begin() + best );
+    if ( aligned + size < end )
+    {
+        block.freeRanges.insert( block.freeRanges.begin() + best,
+                                 Range{ aligned + size, end - aligned - size } );
+    }
+    if ( aligned > range.offset )
+    {
+        block.freeRanges.insert( block.freeRanges.begin() + best,
+                                 Range{ range.offset, aligned - range.offset } );
+    }
+
+    block.used += size;
+    *offset     = aligned;
+
+    return true;
+}
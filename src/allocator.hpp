@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class Device;
+
+const VkDeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+
+// Linear and optimal resources are kept in separate blocks so neighbouring
+// sub-allocations never violate bufferImageGranularity.
+enum class AllocationType
+{
+    LINEAR,  // Buffers and linearly tiled images
+    OPTIMAL  // Optimally tiled images
+};
+
+// A range of a VkDeviceMemory block handed out by MemoryAllocator.
+struct Allocation
+{
+    friend class MemoryAllocator;
+
+public:
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize   offset = 0;
+    VkDeviceSize   size   = 0;
+    void*          mapped = nullptr; // Set when the memory is host visible
+
+private:
+
+    uint32_t pool  = UINT32_MAX;
+    uint32_t block = UINT32_MAX;
+};
+
+// Sub-allocates resources from large VkDeviceMemory blocks, one set of
+// blocks per memory type and AllocationType. Free space in each block is
+// tracked as an offset ordered list of ranges and handed out best fit.
+class MemoryAllocator
+{
+public:
+
+    MemoryAllocator() {}
+
+    MemoryAllocator( Device*      device,
+                     VkDeviceSize blockSize = DEFAULT_MEMORY_BLOCK_SIZE )
+    {
+        this->init( device, blockSize );
+    }
+
+    ~MemoryAllocator() { this->deinit(); }
+
+    void init( Device*      device,
+               VkDeviceSize blockSize = DEFAULT_MEMORY_BLOCK_SIZE );
+
+    void deinit();
+
+    Allocation allocate( const VkMemoryRequirements& requirements,
+                         VkMemoryPropertyFlags       properties,
+                         AllocationType              type );
+
+    void free( Allocation& allocation );
+
+    // Number of live VkDeviceMemory objects.
+    uint32_t getBlockCount() const;
+
+    // Bytes currently handed out to resources.
+    VkDeviceSize getUsedBytes() const;
+
+private:
+
+    struct Range
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Block
+    {
+        VkDeviceMemory     memory    = VK_NULL_HANDLE;
+        VkDeviceSize       size      = 0;
+        VkDeviceSize       used      = 0;
+        void*              mapped    = nullptr;
+        bool               dedicated = false;
+        std::vector<Range> freeRanges; // Sorted by offset
+    };
+
+    struct Pool
+    {
+        std::vector<Block> blocks; // Released blocks are reused in place
+    };
+
+    Device*                          device    = nullptr;
+    VkDeviceSize                     blockSize = DEFAULT_MEMORY_BLOCK_SIZE;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    std::vector<Pool>                pools; // Indexed by memory type * 2 + type
+
+    uint32_t createBlock( Pool&        pool,
+                          uint32_t     memoryType,
+                          VkDeviceSize size,
+                          bool         dedicated );
+
+    void releaseBlock( Block& block );
+
+    bool allocateFromBlock( Block&        block,
+                            VkDeviceSize  size,
+                            VkDeviceSize  alignment,
+                            VkDeviceSize* offset );
+};
@@ -4,33 +4,52 @@
  * Public Methods
  */
 
-void VulkanApplication::run( int width, int height )
+void VulkanApplication::run( int                       width,
+                             int                       height,
+                             const ApplicationOptions& options )
 {
-    glfwInit();
+    this->options = options;
+
+    if ( !this->options.headless )
+    {
+        glfwInit();
+    }
     initVulkan( width, height );
     mainLoop();
 }
 
 VulkanApplication::~VulkanApplication()
 {
-    this->device.destroySemaphore( this->renderFinishSemaphore );
-    this->device.destroySemaphore( this->imageAvailableSemaphore );
+    for ( auto& frame : this->frames )
+    {
+        this->device.destroyFence( frame.fence );
+        this->device.destroySemaphore( frame.renderFinished );
+        this->device.destroySemaphore( frame.imageAvailable );
+    }
+    this->frames.clear();
+    this->recorder.deinit();
+    this->descriptorSets.clear();
+    this->uniforms.deinit();
     this->descriptorPool.deinit();
-    this->uniform.deinit();
+    this->culler.deinit();
+    this->scene.deinit();
     this->model.deinit();
     this->texture.deinit();
     this->depth.deinit();
+    this->offscreen.deinit();
+    this->upload.deinit();
     this->commandPool.deinit();
-    this->graphicsPipeline.deinit();
-
-    for ( auto& dsetlayout : this->descriptorSetLayouts )
-    {
-        dsetlayout.deinit();
-    }
+    this->pipelines.deinit();
+    this->pipelineCache.deinit();
+    this->shader.deinit();
+    this->layouts.deinit();
     
     this->renderPass.deinit();
-    this->swapchain.deinit();
-    vkDestroySurfaceKHR( this->instance.id, this->surface, nullptr );
+    if ( !this->options.headless )
+    {
+        this->swapchain.deinit();
+        vkDestroySurfaceKHR( this->instance.id, this->surface, nullptr );
+    }
     std::cout << "Got here!" << std::endl;
     this->device.deinit();
 
@@ -39,7 +58,11 @@ VulkanApplication::~VulkanApplication()
 #endif
     
     this->instance.deinit();
-    glfwDestroyWindow( this->window );
+
+    if ( this->window != nullptr )
+    {
+        glfwDestroyWindow( this->window );
+    }
 }
 
 /*
@@ -66,9 +89,12 @@ void VulkanApplication::initVulkan( int width, int height )
     this->width  = width;
     this->height = height;
 
+    this->threadPool.init();
+
     this->instance.init( "Hello Triangle",
                          "No Engine",
-                         GetRequiredExtensions( enableValidationLayers ),
+                         GetRequiredExtensions( enableValidationLayers,
+                                                this->options.headless ),
                          requiredValidationLayers );
     std::cout << "Created instance!" << std::endl;
 
@@ -76,94 +102,155 @@ void VulkanApplication::initVulkan( int width, int height )
     this->createDebugCallback();
 #endif
 
-    this->createSurface();
+    // Headless rendering needs neither a surface nor the swapchain extension.
+    std::vector<const char*> deviceExtensions;
+    if ( !this->options.headless )
+    {
+        this->createSurface();
+        deviceExtensions = requiredDeviceExtensions;
+    }
 
     this->physical = PickPhysicalDevice( this->instance.id,
                                          this->surface,
-                                         requiredDeviceExtensions );
+                                         deviceExtensions );
 
     this->device.init( this->physical,
                        this->surface,
-                       requiredDeviceExtensions,
+                       deviceExtensions,
                        requiredValidationLayers );
 
-    this->swapchain.init( &this->device,
-                          this->surface,
-                          this->width,
-                          this->height,
-                          { (uint32_t)this->device.graphicsQueueIdx,
-                                  (uint32_t)this->device.presentQueueIdx } );
-    std::cout << "Created SwapChain!" << std::endl;
+    // Decode the texture on a worker while the rest of the device objects
+    // and the model are created
+    TextureLoader            textureLoader( &this->device, &this->threadPool );
+    std::future<TextureData> pendingTexture = textureLoader.load( TEXTURE_PATH );
+
+    this->createCommandPool();
+    std::cout << "Created Command Pool!" << std::endl;
+
+    // Uploads go through a separate transfer family when the device has one
+    if ( this->options.transferQueue )
+    {
+        this->upload.init( &this->device,
+                           this->device.transferQueue,
+                           this->device.transferQueueIdx,
+                           this->device.graphicsQueue,
+                           this->device.graphicsQueueIdx );
+    }
+    else
+    {
+        this->upload.init( &this->device,
+                           this->device.graphicsQueue,
+                           this->device.graphicsQueueIdx,
+                           this->device.graphicsQueue,
+                           this->device.graphicsQueueIdx );
+    }
+    std::cout << "Uploading on "
+              << ( this->upload.isDedicated() ? "transfer" : "graphics" )
+              << " queue!" << std::endl;
+
+    this->createRenderTarget();
+    std::cout << "Created Render Target!" << std::endl;
 
     this->createRenderPass();
     std::cout << "Created Render Pass!" << std::endl;
 
+    this->createShader();
     this->createDescriptorSetLayout();
     std::cout << "Created Descriptor Layout" << std::endl;
+    this->pipelineCache.init( &this->device,
+                              this->options.pipelineCache ? PIPELINE_CACHE_PATH
+                                                          : std::string() );
+    this->pipelines.init( &this->device, &this->pipelineCache );
     this->createGraphicsPipeline();
     std::cout << "Created Graphics Pipeline!" << std::endl;
         
-    this->createCommandPool();
-    std::cout << "Created Command Pool!" << std::endl;
-        
     std::cout << "Creating Depth Image!" << std::endl;
     this->depth.init( &this->device,
-                      this->device.graphicsQueue,
-                      &this->commandPool,
-                      this->swapchain.extent.width,
-                      this->swapchain.extent.height,
+                      &this->upload,
+                      this->getExtent().width,
+                      this->getExtent().height,
                       FindDepthFormat( this->physical ),
                       ImageType::DEPTH );
     std::cout << "Created Depth Image!" << std::endl;
 
-    this->swapchain.createFramebuffers( this->renderPass.getRenderPass(),
-                                        &this->depth,
-                                        1 );
+    this->createFramebuffers();
     std::cout << "Created Framebuffer!" << std::endl;
 
-    std::cout << "Creating Texture!" << std::endl;
-    this->texture.init( &this->device,
-                        this->device.graphicsQueue,
-                        &this->commandPool,
-                        TEXTURE_PATH );
-    std::cout << "Created Texture!" << std::endl;
+    ModelOptions modelOptions;
+    modelOptions.useCache = this->options.meshCache;
+    modelOptions.optimize = this->options.optimizeMesh;
+    modelOptions.layout   = this->options.vertexLayout;
 
     this->model.init( &this->device,
-                      this->device.graphicsQueue,
-                      &this->commandPool,
-                      MODEL_PATH );
+                      &this->upload,
+                      MODEL_PATH,
+                      &this->threadPool,
+                      modelOptions );
     std::cout << "Loaded model!" << std::endl;
 
-    this->uniform.init( &this->device,
-                        this->device.graphicsQueue,
-                        &this->commandPool,
-                        sizeof(UniformBufferObject),
-                        BufferUsage::UNIFORM );
-    std::cout << "Created Uniform Buffer!" << std::endl;
-        
+    std::cout << "Creating Texture!" << std::endl;
+    this->texture.init( &this->device,
+                        &this->upload,
+                        pendingTexture.get() );
+    std::cout << "Created Texture!" << std::endl;
+
     this->createDescriptorPool();
     std::cout << "Created Descriptor Pool!" << std::endl;
-    this->createDescriptorSet();
-    std::cout << "Created Descriptor Sets!" << std::endl;
-        
-    this->createCommandBuffers();
-    std::cout << "Created Command Buffers!" << std::endl;
-        
-    this->createSemaphores();
+
+    this->createFrameResources();
+    std::cout << "Created Frame Resources!" << std::endl;
+
+    this->createScene();
+    std::cout << "Created Scene!" << std::endl;
+
+    // Submit every upload recorded while loading in one batch
+    this->upload.flush();
+
+    std::cout << "Device memory: "
+              << this->device.allocator.getBlockCount() << " blocks, "
+              << this->device.allocator.getUsedBytes() / 1024 << " KiB used"
+              << std::endl;
 }
 
 void VulkanApplication::mainLoop()
 {
-    while ( !glfwWindowShouldClose( this->window ) )
+    this->frameStatistics.init( this->options.frames );
+
+    for ( uint32_t frame = 0;
+          this->options.frames == 0 || frame < this->options.frames;
+          frame++ )
     {
-        glfwPollEvents();
+        if ( !this->options.headless )
+        {
+            if ( glfwWindowShouldClose( this->window ) )
+            {
+                break;
+            }
 
-        this->updateUniformBuffer();
+            glfwPollEvents();
+        }
+
+        this->frameStatistics.begin();
         this->drawFrame();
+        this->frameStatistics.end();
     }
 
     // Wait for logical device to finish
     this->device.waitIdle();
+
+    if ( this->options.frames > 0 )
+    {
+        std::string label = this->options.headless ? "Headless" : "Windowed";
+        label += ", " + std::to_string( this->scene.getInstanceCount() ) +
+                 " instances";
+        if ( this->getDrawBatchCount() > 1 )
+        {
+            label += ", " + std::to_string( this->getDrawBatchCount() ) +
+                     " batches";
+        }
+
+        this->frameStatistics.report( std::cout, label );
+    }
 }
 
 void VulkanApplication::recreateSwapChain( int width, int height )
@@ -173,32 +260,39 @@ void VulkanApplication::recreateSwapChain( int width, int height )
     this->width  = width;
     this->height = height;
 
+    VkFormat previousFormat = this->swapchain.imageFormat;
+
     this->swapchain.refresh( &this->device,
                              this->surface,
                              this->width,
                              this->height,
                              { (uint32_t)this->device.graphicsQueueIdx,
                                (uint32_t)this->device.presentQueueIdx } );
-    this->createRenderPass();
 
-    this->createGraphicsPipeline();
+    // Pipelines only depend on the render pass, which only changes if the
+    // new swapchain has a different format
+    if ( this->swapchain.imageFormat != previousFormat )
+    {
+        this->renderPass.deinit();
 
+        this->createRenderPass();
+        this->createGraphicsPipeline();
+    }
+
+    this->depth.deinit();
     this->depth.init( &this->device,
-                      this->device.graphicsQueue,
-                      &this->commandPool,
+                      &this->upload,
                       this->swapchain.extent.width,
                       this->swapchain.extent.height,
                       FindDepthFormat( this->physical ),
                       ImageType::DEPTH );
+    this->upload.flush();
 
-    this->swapchain.createFramebuffers( this->renderPass.getRenderPass(),
-                                        &this->depth,
-                                        1 );
-
-    this->createCommandBuffers();
+    this->createFramebuffers();
 }
 
-void VulkanApplication::updateUniformBuffer()
+uint32_t VulkanApplication::updateUniformBuffer( uint32_t   frameIdx,
+                                                 glm::mat4* transform )
 {
     static auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -207,62 +301,263 @@ void VulkanApplication::updateUniformBuffer()
         currentTime - startTime
         ).count() / 1000.0f;
 
-    float aspect = (float)this->swapchain.extent.width /
-        (float)this->swapchain.extent.height;
+    float aspect = (float)this->getExtent().width /
+        (float)this->getExtent().height;
     UniformBufferObject ubo = {};
     ubo.model       = glm::rotate( glm::mat4(),
                                    time * glm::radians( 90.0f ),
                                    glm::vec3( 0.0f, 0.0f, 1.0f ) );
-    ubo.view        = glm::lookAt( glm::vec3( 2.0f, 2.0f, 2.0f ),
+    ubo.view        = glm::lookAt( glm::vec3( 2.0f, 2.0f, 2.0f ) * this->sceneScale,
                                    glm::vec3( 0.0f, 0.0f, 0.0f ),
                                    glm::vec3( 0.0f, 0.0f, 1.0f ) );
     ubo.proj        = glm::perspective( glm::radians(45.0f), aspect,
-                                        0.1f, 10.0f );
+                                        0.1f * this->sceneScale,
+                                        10.0f * this->sceneScale );
     ubo.proj[1][1] *= -1; // Flip y coord to deal with vulkan's coordinate system
 
-    this->uniform.copy( (void*)&ubo, true, sizeof(ubo) );
+    *transform = ubo.proj * ubo.view * ubo.model;
+
+    return this->uniforms.write( frameIdx, 0, &ubo, sizeof(ubo) );
+}
+
+void VulkanApplication::recordCommandBuffer( FrameResources&  frame,
+                                             VkFramebuffer    framebuffer,
+                                             uint32_t         uniformOffset,
+                                             const glm::mat4& transform )
+{
+    CommandBuffer& cmdbuf = frame.commandBuffer;
+
+    cmdbuf.reset();
+    cmdbuf.begin( CommandBufferUsage::ONE_TIME );
+
+    // Cull before the render pass, compute work is not allowed inside one
+    if ( this->options.gpuCulling )
+    {
+        this->culler.record( cmdbuf,
+                             this->currentFrame,
+                             this->scene,
+                             this->model,
+                             transform );
+    }
+                  
+    // Start Render Pass
+    VkRect2D renderArea = {};
+    renderArea.offset = { 0, 0 };
+    renderArea.extent = this->getExtent();
+    std::vector<VkClearValue> clearValues( 2 );
+    clearValues[0].color        = { 0.0f, 0.0f, 0.0f, 1.0f };
+    clearValues[1].depthStencil = { 1.0f, 0 };
+
+    uint32_t batches = this->getDrawBatchCount();
+
+    if ( batches > 1 )
+    {
+        // Each thread records a share of the batches into its own secondary
+        // command buffer, executed in batch order by the primary
+        uint32_t instanceCount = this->scene.getInstanceCount();
+
+        this->recorder.record(
+            this->currentFrame,
+            this->renderPass,
+            0,
+            framebuffer,
+            batches,
+            [&]( CommandBuffer& secondary, std::size_t begin, std::size_t end ) {
+                this->recordDrawState( secondary, renderArea, uniformOffset );
+
+                for ( std::size_t batch = begin; batch < end; batch++ )
+                {
+                    uint32_t first = (uint32_t)( batch * instanceCount / batches );
+                    uint32_t last  = (uint32_t)( ( batch + 1 ) * instanceCount / batches );
+
+                    secondary.drawIndexed( this->model.indexCount,
+                                           last - first,
+                                           0,
+                                           0,
+                                           first );
+                }
+            } );
+
+        cmdbuf.beginRenderPass( this->renderPass,
+                                framebuffer,
+                                renderArea,
+                                clearValues,
+                                VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
+
+        this->recorder.execute( cmdbuf, this->currentFrame );
+    }
+    else
+    {
+        cmdbuf.beginRenderPass( this->renderPass,
+                                framebuffer,
+                                renderArea,
+                                clearValues,
+                                VK_SUBPASS_CONTENTS_INLINE );
+
+        this->recordDrawState( cmdbuf, renderArea, uniformOffset );
+
+        // Every instance of the model in one draw, with the visible instance
+        // count written by culling when it is enabled
+        if ( this->options.gpuCulling )
+        {
+            cmdbuf.drawIndexedIndirect( this->culler.getDrawCommand( this->currentFrame ).id,
+                                        0,
+                                        1,
+                                        sizeof(VkDrawIndexedIndirectCommand) );
+        }
+        else
+        {
+            cmdbuf.drawIndexed( this->model.indexCount,
+                                this->scene.getInstanceCount(),
+                                0,
+                                0,
+                                0 );
+        }
+    }
+
+    cmdbuf.endRenderPass();
+
+    cmdbuf.end();
+}
+
+void VulkanApplication::recordDrawState( CommandBuffer& cmdbuf,
+                                         VkRect2D       renderArea,
+                                         uint32_t       uniformOffset )
+{
+    // Bind Pipeline
+    cmdbuf.bindPipeline( VK_PIPELINE_BIND_POINT_GRAPHICS, *this->graphicsPipeline );
+
+    // Viewport and scissor follow the current extent
+    VkViewport viewport = {};
+    viewport.x        = 0.0f;
+    viewport.y        = 0.0f;
+    viewport.width    = (float)renderArea.extent.width;
+    viewport.height   = (float)renderArea.extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    cmdbuf.setViewport( 0, 1, &viewport );
+    cmdbuf.setScissor( 0, 1, &renderArea );
+
+    // Bind Vertex Buffers
+    cmdbuf.bindVertexBuffer( 0, this->model.vertexBuffer, 0 );
+    cmdbuf.bindVertexBuffer( INSTANCE_BINDING,
+                             this->options.gpuCulling
+                             ? this->culler.getVisibleInstances( this->currentFrame )
+                             : this->scene.getInstanceBuffer( this->currentFrame ),
+                             0 );
+
+    // Bind Index Buffer
+    cmdbuf.bindIndexBuffer( this->model.indexBuffer, 0, this->model.indexType );
+
+    // Dequantization of the model's packed vertex attributes
+    cmdbuf.pushConstants( *this->pipelineLayout,
+                          VK_SHADER_STAGE_VERTEX_BIT,
+                          0,
+                          sizeof(MeshDequantization),
+                          &this->model.dequantization );
+
+    // Bind uniform buffer(s)
+    cmdbuf.bindDescriptorSets( VK_PIPELINE_BIND_POINT_GRAPHICS,
+                               *this->graphicsPipeline,
+                               *this->pipelineLayout,
+                               0,
+                               this->descriptorSets,
+                               1,
+                               &uniformOffset );
+}
+
+uint32_t VulkanApplication::getDrawBatchCount() const
+{
+    // Culled instances are counted on the GPU, so they are drawn with a
+    // single indirect draw
+    if ( this->options.gpuCulling )
+    {
+        return 1;
+    }
+
+    uint32_t batches = std::min( this->options.drawBatches,
+                                 this->scene.getInstanceCount() );
+
+    return std::max( batches, 1u );
 }
 
 void VulkanApplication::drawFrame()
 {
-    uint32_t imageIdx;
-    auto result = this->device.acquireNextImage(
-        this->swapchain.id,
-        std::numeric_limits<uint64_t>::max(), // Disable timeout for image to become available
-        this->imageAvailableSemaphore,
-        VK_NULL_HANDLE,
-        &imageIdx
-        );
+    FrameResources& frame = this->frames[ this->currentFrame ];
+
+    // Wait until the GPU has finished the last frame that used these resources
+    VK_CHECK_RESULT( this->device.waitForFences(
+                         1,
+                         &frame.fence,
+                         VK_TRUE,
+                         std::numeric_limits<uint64_t>::max()
+                         ) );
 
-    if ( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR )
+    uint32_t imageIdx = 0;
+    if ( !this->options.headless )
     {
-        this->recreateSwapChain( this->width, this->height );
-        return;
+        auto result = this->device.acquireNextImage(
+            this->swapchain.id,
+            std::numeric_limits<uint64_t>::max(), // Disable timeout for image to become available
+            frame.imageAvailable,
+            VK_NULL_HANDLE,
+            &imageIdx
+            );
+
+        if ( result == VK_ERROR_OUT_OF_DATE_KHR )
+        {
+            this->recreateSwapChain( this->width, this->height );
+            return;
+        }
+        if ( result != VK_SUBOPTIMAL_KHR )
+        {
+            VK_CHECK_RESULT( result );
+        }
     }
-    VK_CHECK_RESULT( result );
+
+    // Only reset the fence once work is certain to be submitted with it
+    VK_CHECK_RESULT( this->device.resetFences( 1, &frame.fence ) );
+
+    glm::mat4 transform;
+    uint32_t  uniformOffset = this->updateUniformBuffer( this->currentFrame,
+                                                         &transform );
+    this->scene.update( this->currentFrame );
+    this->recordCommandBuffer( frame,
+                               this->getFramebuffers()[ imageIdx ],
+                               uniformOffset,
+                               transform );
 
     // Submit command buffer
-    VkSemaphore waitSemaphores[]      = { this->imageAvailableSemaphore };
+    VkSemaphore waitSemaphores[]      = { frame.imageAvailable };
     VkPipelineStageFlags waitStages[] = {
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
     };
-    VkSemaphore signalSemaphores[]    = { this->renderFinishSemaphore };
+    VkSemaphore signalSemaphores[]    = { frame.renderFinished };
 
     VkSubmitInfo submitInfo = {};
-    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount   = 1;
-    submitInfo.pWaitSemaphores      = waitSemaphores;
-    submitInfo.pWaitDstStageMask    = waitStages;
-    submitInfo.commandBufferCount   = 1;
-    submitInfo.pCommandBuffers      = this->commandBuffers[imageIdx].getHandle();
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores    = signalSemaphores;
-
-    this->device.queueWaitIdle( this->device.graphicsQueue );
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = frame.commandBuffer.getHandle();
+    if ( !this->options.headless )
+    {
+        submitInfo.waitSemaphoreCount   = 1;
+        submitInfo.pWaitSemaphores      = waitSemaphores;
+        submitInfo.pWaitDstStageMask    = waitStages;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = signalSemaphores;
+    }
+
     VK_CHECK_RESULT( this->device.queueSubmit( this->device.graphicsQueue,
                                                1,
                                                &submitInfo,
-                                               VK_NULL_HANDLE ) );
+                                               frame.fence ) );
+
+    this->currentFrame = ( this->currentFrame + 1 ) % this->frames.size();
+
+    if ( this->options.headless )
+    {
+        return;
+    }
 
     // Submit result to swap chain
     VkSwapchainKHR swapchains[] = { this->swapchain.id };
@@ -276,7 +571,27 @@ void VulkanApplication::drawFrame()
     presentInfo.pImageIndices      = &imageIdx;
     presentInfo.pResults           = nullptr;
 
-    this->device.queuePresent( this->device.presentQueue, &presentInfo );
+    auto result = this->device.queuePresent( this->device.presentQueue,
+                                             &presentInfo );
+
+    if ( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR )
+    {
+        this->recreateSwapChain( this->width, this->height );
+    }
+}
+
+VkExtent2D VulkanApplication::getExtent() const
+{
+    return this->options.headless
+        ? this->offscreen.extent
+        : this->swapchain.extent;
+}
+
+std::vector<VkFramebuffer>& VulkanApplication::getFramebuffers()
+{
+    return this->options.headless
+        ? this->offscreen.framebuffers
+        : this->swapchain.framebuffers;
 }
 
 void VulkanApplication::createSurface()
@@ -295,55 +610,133 @@ void VulkanApplication::createSurface()
                                               &this->surface ) );
 }
 
+void VulkanApplication::createRenderTarget()
+{
+    if ( this->options.headless )
+    {
+        this->offscreen.init( &this->device,
+                              &this->upload,
+                              this->width,
+                              this->height );
+        return;
+    }
+
+    this->swapchain.init( &this->device,
+                          this->surface,
+                          this->width,
+                          this->height,
+                          { (uint32_t)this->device.graphicsQueueIdx,
+                                  (uint32_t)this->device.presentQueueIdx } );
+}
+
+void VulkanApplication::createFramebuffers()
+{
+    if ( this->options.headless )
+    {
+        this->offscreen.createFramebuffers( this->renderPass.getRenderPass(),
+                                            &this->depth,
+                                            1 );
+        return;
+    }
+
+    this->swapchain.createFramebuffers( this->renderPass.getRenderPass(),
+                                        &this->depth,
+                                        1 );
+}
+
 void VulkanApplication::createRenderPass()
 {
+    if ( this->options.headless )
+    {
+        this->renderPass.init( &this->device,
+                               this->offscreen.imageFormat,
+                               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL );
+        return;
+    }
+
     this->renderPass.init( &this->device,
                            this->swapchain.imageFormat );
 }
 
+void VulkanApplication::createShader()
+{
+    auto vs_code = ReadFile( "shaders/vert.spv" );
+    auto fs_code = ReadFile( "shaders/frag.spv" );
+    this->shader.init( &this->device, vs_code, fs_code, {}, {}, {} );
+}
+
 void VulkanApplication::createDescriptorSetLayout()
 {
-    std::vector<DescriptorBinding> bindings;
-    bindings.emplace_back( 0,
-                           DescriptorType::UNIFORM_BUFFER,
-                           1,
-                           VK_SHADER_STAGE_VERTEX_BIT );
-    bindings.emplace_back( 1,
-                           DescriptorType::COMBINED_IMAGE_SAMPLER,
-                           1,
-                           VK_SHADER_STAGE_FRAGMENT_BIT ); 
-    this->descriptorSetLayouts.emplace_back( &this->device, bindings );
-
-    this->pipelineLayout.init( &this->device,
-                               this->descriptorSetLayouts );
+    const ShaderReflection& reflection = this->shader.getReflection();
+
+    this->layouts.init( &this->device );
+
+    // Uniforms are bound at a per frame offset into the UniformRing
+    for ( uint32_t set = 0; set < reflection.getSetCount(); set++ )
+    {
+        std::vector<uint32_t> dynamicBindings;
+        if ( set == 0 )
+        {
+            dynamicBindings.push_back( 0 );
+        }
+
+        this->descriptorSetLayouts.push_back(
+            this->layouts.getSetLayout( reflection.getBindings( set,
+                                                                dynamicBindings ) )
+            );
+    }
+
+    // The shaders must agree with the struct pushed before every draw
+    if ( reflection.pushConstants.size() != 1 ||
+         reflection.pushConstants[0].size != sizeof(MeshDequantization) )
+    {
+        throw std::runtime_error( "Shader push constants do not match MeshDequantization" );
+    }
+
+    this->pipelineLayout = this->layouts.getPipelineLayout( this->descriptorSetLayouts,
+                                                            reflection.pushConstants );
 }
 
 void VulkanApplication::createGraphicsPipeline(  )
 {
-    // Load shader
-    auto vs_code = ReadFile( "shaders/vert.spv" );
-    auto fs_code = ReadFile( "shaders/frag.spv" );
-    GraphicsShader shader( &this->device, vs_code, fs_code, {}, {}, {} );
+    PipelineDescription description;
+    description.shader     = &this->shader;
+    description.layout     = this->pipelineLayout;
+    description.renderPass = &this->renderPass;
+
+    // Describe the format of the input vertex data, per vertex from the
+    // model followed by per instance from the scene
+    description.vertexInfo = {
+        this->options.vertexLayout.getBindingDescription(),
+        Scene::GetBindingDescription( INSTANCE_BINDING )
+    };
+    description.attributeInfo = this->options.vertexLayout.getAttributeDescriptions();
 
-    // Describe the format of the input vertex data
-    auto vertexInfo    = Vertex::getBindingDescription();
-    auto attributeInfo = Vertex::getAttributeDescriptions();
-    std::vector<VkVertexInputAttributeDescription> attributeInfo2;
+    auto instanceAttributes = Scene::GetAttributeDescriptions( INSTANCE_BINDING,
+                                                               INSTANCE_LOCATION );
+    description.attributeInfo.insert( description.attributeInfo.end(),
+                                      instanceAttributes.begin(),
+                                      instanceAttributes.end() );
 
-    for ( auto& ai : attributeInfo )
+    // The vertex layout decides how attributes are packed, but must feed
+    // every input the vertex shader declares
+    for ( const auto& input : this->shader.getReflection().inputs )
     {
-        attributeInfo2.emplace_back( ai );
+        bool found = false;
+        for ( const auto& attribute : description.attributeInfo )
+        {
+            found = found || attribute.location == input.location;
+        }
+
+        if ( !found )
+        {
+            throw std::runtime_error( "No vertex attribute for shader input at location " +
+                                      std::to_string( input.location ) );
+        }
     }
 
-    this->pipelineLayout.init( &this->device, this->descriptorSetLayouts );
-
-    this->graphicsPipeline.init( &this->device,
-                                 &this->renderPass,
-                                 &shader,
-                                 &this->pipelineLayout,
-                                 &this->swapchain,
-                                 vertexInfo,
-                                 attributeInfo2 );
+    this->pipelines.compile( { description }, &this->threadPool );
+    this->graphicsPipeline = this->pipelines.get( description );
 }
 
 void VulkanApplication::createCommandPool()
@@ -356,96 +749,108 @@ void VulkanApplication::createCommandPool()
 void VulkanApplication::createDescriptorPool()
 {
     this->descriptorPool.init( &this->device,
-                               &this->descriptorSetLayouts[ 0 ],
+                               this->descriptorSetLayouts[ 0 ],
                                20 );
 }
 
-void VulkanApplication::createDescriptorSet()
+void VulkanApplication::createFrameResources()
 {
-    std::cout << "Creating descriptor sets!" << std::endl;
-    this->descriptorSets.emplace_back( this->descriptorPool.allocateDescriptorSet() );
-    std::cout << "Created descriptor sets!" << std::endl;
-    this->descriptorSets[ 0 ].update( this->uniform, 0, 0 );
+    uint32_t count = this->options.framesInFlight;
+    count = ( count < 1 ) ? 1 : count;
+    count = ( count > MAX_FRAMES_IN_FLIGHT ) ? MAX_FRAMES_IN_FLIGHT : count;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    // Start signalled so the first wait on each frame returns immediately
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    this->frames.resize( count );
+
+    // One uniform block per frame in a single mapped buffer, selected at
+    // bind time with a dynamic offset so every frame shares a descriptor set
+    this->uniforms.init( &this->device,
+                         &this->upload,
+                         sizeof(UniformBufferObject),
+                         1,
+                         count );
+
+    this->descriptorSets.emplace_back(
+        this->descriptorPool.allocateDescriptorSet()
+        );
+    this->descriptorSets[ 0 ].update( this->uniforms.buffer,
+                                      0,
+                                      0,
+                                      0,
+                                      this->uniforms.getBlockSize() );
     this->descriptorSets[ 0 ].update( this->texture.getImage(),
                                       this->texture.getSampler(),
                                       1,
                                       0 );
-}
 
-void VulkanApplication::createCommandBuffers()
-{
-    std::cout << "Creating Command Buffers!" << std::endl;
-    this->commandPool.reset();
-    std::cout << "Reset Command Buffers!" << std::endl;
-    this->commandBuffers.resize( this->swapchain.framebuffers.size() );
-    std::cout << "Resized Command Buffers!" << std::endl;
+    this->recorder.init( &this->device,
+                         this->device.graphicsQueue,
+                         this->device.graphicsQueueIdx,
+                         &this->threadPool,
+                         count );
 
-    for ( auto& cmdbuf : this->commandBuffers )
+    for ( auto& frame : this->frames )
     {
-        cmdbuf.deinit();
-        cmdbuf.init( &this->device,
-                     this->device.graphicsQueue,
-                     &this->commandPool );
+        frame.commandBuffer.init( &this->device,
+                                  this->device.graphicsQueue,
+                                  &this->commandPool );
+
+        VK_CHECK_RESULT( this->device.createSemaphore(
+                             &semaphoreCreateInfo,
+                             &frame.imageAvailable
+                             ) );
+        VK_CHECK_RESULT( this->device.createSemaphore(
+                             &semaphoreCreateInfo,
+                             &frame.renderFinished
+                             ) );
+        VK_CHECK_RESULT( this->device.createFence( &fenceCreateInfo,
+                                                   &frame.fence ) );
     }
 
-    std::size_t ii = 0;
-    for ( auto& cmdbuf : this->commandBuffers )
-    {
-        cmdbuf.begin();
-                  
-        // Start Render Pass
-        VkRect2D renderArea = {};
-        renderArea.offset = { 0, 0 };
-        renderArea.extent = this->swapchain.extent;
-        std::vector<VkClearValue> clearValues( 2 );
-        clearValues[0].color        = { 0.0f, 0.0f, 0.0f, 1.0f };
-        clearValues[1].depthStencil = { 1.0f, 0 };
-        
-        cmdbuf.beginRenderPass( this->renderPass,
-                                this->swapchain.framebuffers[ ii++ ],
-                                renderArea,
-                                clearValues,
-                                VK_SUBPASS_CONTENTS_INLINE );
-
-        // Bind Pipeline
-        cmdbuf.bindPipeline( VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline );
-
-        // Bind Vertex Buffer
-        cmdbuf.bindVertexBuffer( 0, this->model.vertexBuffer, 0 );
-
-        // Bind Index Buffer
-        cmdbuf.bindIndexBuffer( this->model.indexBuffer, 0, VK_INDEX_TYPE_UINT32 );
-
-        // Bind uniform buffer(s)
-        cmdbuf.bindDescriptorSets( VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                   this->graphicsPipeline,
-                                   this->pipelineLayout,
-                                   0,
-                                   this->descriptorSets,
-                                   0,
-                                   nullptr );
-      
-        cmdbuf.drawIndexed( this->model.indexSize, 1, 0, 0, 0 );
+    this->currentFrame = 0;
+}
 
-        cmdbuf.endRenderPass();
+void VulkanApplication::createScene()
+{
+    this->scene.init( &this->device,
+                      &this->upload,
+                      (uint32_t)this->frames.size() );
+
+    // Lay the instances out on a square grid in the ground plane, spaced so
+    // neighbouring models do not overlap
+    uint32_t  count   = ( this->options.instances > 0 ) ? this->options.instances : 1;
+    uint32_t  side    = (uint32_t)std::ceil( std::sqrt( (double)count ) );
+    glm::vec3 size    = this->model.boundsMax - this->model.boundsMin;
+    float     spacing = 1.25f * std::max( size.x, size.y );
+    float     start   = -0.5f * spacing * ( side - 1 );
+
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+        glm::vec3 position( start + spacing * ( i % side ),
+                            start + spacing * ( i / side ),
+                            0.0f );
 
-        cmdbuf.end();
+        this->scene.addInstance( glm::translate( glm::mat4(), position ) );
     }
-}
 
-void VulkanApplication::createSemaphores()
-{
-    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    this->sceneScale = (float)side;
 
-    VK_CHECK_RESULT( this->device.createSemaphore(
-                         &semaphoreCreateInfo,
-                         &this->imageAvailableSemaphore
-                         ) );
-    VK_CHECK_RESULT( this->device.createSemaphore(
-                         &semaphoreCreateInfo,
-                         &this->renderFinishSemaphore
-                         ) );
+    if ( this->options.gpuCulling )
+    {
+        this->culler.init( &this->device,
+                           &this->upload,
+                           &this->layouts,
+                           &this->pipelineCache,
+                           ReadFile( CULL_SHADER_PATH ),
+                           (uint32_t)this->frames.size() );
+    }
 }
 
 #if defined( DEBUG_BUILD )
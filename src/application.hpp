@@ -9,25 +9,38 @@
 #include <GLFW/glfw3.h>
 
 #include <stdlib.h>
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <chrono>
 #include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "benchmark.hpp"
 #include "buffer.hpp"
 #include "common.hpp"
+#include "culling.hpp"
 #include "device.hpp"
 #include "image.hpp"
 #include "instance.hpp"
 #include "model.hpp"
+#include "offscreen.hpp"
 #include "pipeline.hpp"
+#include "pipelinecache.hpp"
+#include "recorder.hpp"
 #include "renderpass.hpp"
 #include "descriptor.hpp"
+#include "scene.hpp"
 #include "shader.hpp"
 #include "swapchain.hpp"
 #include "texture.hpp"
+#include "threadpool.hpp"
 #include "ubo.hpp"
+#include "uniformring.hpp"
+#include "upload.hpp"
 #include "utils.hpp"
 
 const int WIDTH  = 800;
@@ -36,11 +49,50 @@ const int HEIGHT = 600;
 const std::string MODEL_PATH   = "models/chalet.obj";
 const std::string TEXTURE_PATH = "textures/chalet.jpg";
 
+const std::string PIPELINE_CACHE_PATH = "pipeline.cache";
+
+const std::string CULL_SHADER_PATH = "shaders/cull.spv";
+
+const uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+
+// Vertex buffer binding and first shader location of per instance data
+const uint32_t INSTANCE_BINDING  = 1;
+const uint32_t INSTANCE_LOCATION = 2;
+
+struct ApplicationOptions
+{
+    bool     headless       = false; // Render to an offscreen image without a window
+    uint32_t frames         = 0;     // Number of frames to render, 0 runs until closed
+    uint32_t framesInFlight = 2;     // Frames the CPU may record ahead of the GPU
+    bool     transferQueue  = true;  // Upload on a dedicated transfer queue if present
+    bool     meshCache      = true;  // Load models through their binary mesh cache
+    bool     optimizeMesh   = false; // Reorder models for vertex cache and overdraw
+    bool     pipelineCache  = true;  // Keep compiled pipelines on disk between runs
+    uint32_t instances      = 1;     // Copies of the model, laid out in a grid
+    bool     gpuCulling     = true;  // Cull instances against the frustum in a compute pass
+    uint32_t drawBatches    = 1;     // Draws the scene is split into, recorded in parallel
+
+    VertexLayout vertexLayout; // Packed vertex format of loaded models
+};
+
+// Resources owned by a single frame in flight. The CPU only touches them
+// once the frame's fence shows the GPU is done with its previous use.
+// Uniform data lives in the frame's slice of the application's UniformRing.
+struct FrameResources
+{
+    VkFence       fence          = VK_NULL_HANDLE;
+    VkSemaphore   imageAvailable = VK_NULL_HANDLE;
+    VkSemaphore   renderFinished = VK_NULL_HANDLE;
+    CommandBuffer commandBuffer;
+};
+
 class VulkanApplication
 {
 public:
     
-    void run( int width, int height );
+    void run( int                       width,
+              int                       height,
+              const ApplicationOptions& options = ApplicationOptions() );
 
     VulkanApplication()
     {}
@@ -48,28 +100,40 @@ public:
     ~VulkanApplication(  );
 
 private:
+
+    ApplicationOptions options;
+
+    ThreadPool threadPool; // CPU side asset processing
     
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
     int         width;
     int         height;
 
     Instance                 instance;
-    VkDebugReportCallbackEXT callback;
-    VkSurfaceKHR             surface;
+    VkDebugReportCallbackEXT callback = VK_NULL_HANDLE;
+    VkSurfaceKHR             surface  = VK_NULL_HANDLE;
 
     VkPhysicalDevice physical = VK_NULL_HANDLE;
     Device           device;
 
-    SwapChain swapchain;
+    SwapChain       swapchain;
+    OffscreenTarget offscreen;
    
     RenderPass renderPass;
 
-    std::vector<DescriptorSetLayout> descriptorSetLayouts;
-    PipelineLayout                   pipelineLayout;
+    LayoutCache                       layouts;
+    std::vector<DescriptorSetLayout*> descriptorSetLayouts;     // Owned by layouts
+    PipelineLayout*                   pipelineLayout = nullptr; // Owned by layouts
 
-    GraphicsPipeline graphicsPipeline;
+    GraphicsShader       shader;
+    PipelineCache        pipelineCache;
+    PipelineVariantCache pipelines;
+    GraphicsPipeline*    graphicsPipeline = nullptr; // Owned by pipelines
 
-    CommandPool commandPool;
+    CommandPool      commandPool;
+    ParallelRecorder recorder;    // Secondary command buffers of split draws
+
+    UploadContext upload;
 
     Image depth;
 
@@ -77,15 +141,20 @@ private:
 
     Model model;
 
-    Buffer uniform;
+    Scene scene;             // Instances of model
+    float sceneScale = 1.0f; // Moves the camera back to fit the instance grid
+
+    FrustumCuller culler; // Only initialized with gpuCulling
+
+    DescriptorPool descriptorPool; // Frees the descriptor sets
 
-    DescriptorPool              descriptorPool;
-    std::vector<DescriptorSet>  descriptorSets; // Freed when descriptorPool is destroyed
+    UniformRing                uniforms;
+    std::vector<DescriptorSet> descriptorSets; // Shared by all frames
 
-    std::vector<CommandBuffer> commandBuffers;
+    std::vector<FrameResources> frames;
+    uint32_t                    currentFrame = 0;
 
-    VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
-    VkSemaphore renderFinishSemaphore   = VK_NULL_HANDLE;
+    FrameStatistics frameStatistics;
 
     static void onWindowResized( GLFWwindow* window,
                                  int         width,
@@ -97,14 +166,39 @@ private:
 
     void recreateSwapChain( int width, int height );
 
-    void updateUniformBuffer();
+    // Writes this frame's uniforms and returns their dynamic offset, along
+    // with the transform from model to clip space they describe.
+    uint32_t updateUniformBuffer( uint32_t frameIdx, glm::mat4* transform );
+
+    void recordCommandBuffer( FrameResources&  frame,
+                              VkFramebuffer    framebuffer,
+                              uint32_t         uniformOffset,
+                              const glm::mat4& transform );
+
+    // Binds everything the scene's draws need. Called once per command
+    // buffer, as secondary command buffers inherit no state.
+    void recordDrawState( CommandBuffer& cmdbuf,
+                          VkRect2D       renderArea,
+                          uint32_t       uniformOffset );
+
+    uint32_t getDrawBatchCount() const;
 
     void drawFrame();
 
+    VkExtent2D getExtent() const;
+
+    std::vector<VkFramebuffer>& getFramebuffers();
+
     void createSurface();
 
+    void createRenderTarget();
+
+    void createFramebuffers();
+
     void createRenderPass();
 
+    void createShader();
+
     void createDescriptorSetLayout();
 
     void createGraphicsPipeline();
@@ -113,11 +207,9 @@ private:
 
     void createDescriptorPool();
 
-    void createDescriptorSet();
-
-    void createCommandBuffers();
+    void createFrameResources();
 
-    void createSemaphores();
+    void createScene();
 
 #if defined( DEBUG_BUILD )
 #ifndef WIN32
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "benchmark.hpp"
+#include "model.hpp"
+#include "threadpool.hpp"
+#include "weld.hpp"
+
+/*
+ * Frame Timing
+ */
+
+void FrameStatistics::init( std::size_t expectedFrames )
+{
+    this->samples.clear();
+    this->samples.reserve( expectedFrames );
+}
+
+void FrameStatistics::reset()
+{
+    this->samples.clear();
+}
+
+void FrameStatistics::begin()
+{
+    this->start = Clock::now();
+
+    if ( this->samples.empty() )
+    {
+        this->first = this->start;
+    }
+}
+
+void FrameStatistics::end()
+{
+    this->last = Clock::now();
+
+    std::chrono::duration<double, std::milli> elapsed = this->last - this->start;
+    this->samples.push_back( elapsed.count() );
+}
+
+void FrameStatistics::addSample( double milliseconds )
+{
+    this->samples.push_back( milliseconds );
+}
+
+std::size_t FrameStatistics::count() const
+{
+    return this->samples.size();
+}
+
+double FrameStatistics::mean() const
+{
+    if ( this->samples.empty() )
+    {
+        return 0.0;
+    }
+
+    return std::accumulate( this->samples.begin(), this->samples.end(), 0.0 ) /
+        (double)this->samples.size();
+}
+
+double FrameStatistics::min() const
+{
+    if ( this->samples.empty() )
+    {
+        return 0.0;
+    }
+
+    return *std::min_element( this->samples.begin(), this->samples.end() );
+}
+
+double FrameStatistics::max() const
+{
+    if ( this->samples.empty() )
+    {
+        return 0.0;
+    }
+
+    return *std::max_element( this->samples.begin(), this->samples.end() );
+}
+
+double FrameStatistics::percentile( double p ) const
+{
+    assert( p >= 0.0 && p <= 100.0 );
+
+    if ( this->samples.empty() )
+    {
+        return 0.0;
+    }
+
+    std::vector<double> sorted( this->samples );
+    std::size_t rank = (std::size_t)std::ceil( p / 100.0 * sorted.size() );
+    rank = ( rank == 0 ) ? 0 : rank - 1;
+
+    std::nth_element( sorted.begin(), sorted.begin() + rank, sorted.end() );
+
+    return sorted[ rank ];
+}
+
+void FrameStatistics::report( std::ostream&      out,
+                              const std::string& label ) const
+{
+    std::chrono::duration<double> wall = this->last - this->first;
+    double fps = ( wall.count() > 0.0 )
+        ? (double)this->samples.size() / wall.count()
+        : 0.0;
+
+    out << std::fixed << std::setprecision( 3 )
+        << label << ": "  << this->samples.size() << " frames"
+        << ", mean "      << this->mean()           << " ms"
+        << ", p50 "       << this->percentile( 50 ) << " ms"
+        << ", p99 "       << this->percentile( 99 ) << " ms"
+        << ", min "       << this->min()            << " ms"
+        << ", max "       << this->max()            << " ms"
+        << ", "           << fps                    << " fps"
+        << std::endl;
+}
+
+/*
+ * Vertex Welding
+ */
+
+static void ReportWeld( std::ostream&          out,
+                        const std::string&     label,
+                        const FrameStatistics& statistics,
+                        std::size_t            uniqueVertices,
+                        double                 baseline )
+{
+    out << std::fixed << std::setprecision( 3 )
+        << label << ": "  << uniqueVertices      << " vertices"
+        << ", min "       << statistics.min()    << " ms"
+        << ", mean "      << statistics.mean()   << " ms"
+        << ", speedup "   << std::setprecision( 2 )
+        << baseline / statistics.min() << "x"
+        << std::endl;
+}
+
+void RunWeldBenchmark( std::size_t indexCount, std::ostream& out )
+{
+    const uint32_t RUNS = 5;
+
+    // A grid with two triangles per cell references most vertices six times
+    std::size_t side = (std::size_t)std::sqrt( (double)indexCount / 6.0 ) + 2;
+
+    std::vector<Vertex> stream;
+    stream.reserve( ( side - 1 ) * ( side - 1 ) * 6 );
+
+    auto gridVertex = [side]( std::size_t x, std::size_t y ) {
+        Vertex vertex = {};
+        vertex.pos      = glm::vec3( (float)x,
+                                     (float)y,
+                                     std::sin( (float)( x + y ) * 0.1f ) );
+        vertex.texCoord = glm::vec2( (float)x / side, (float)y / side );
+        return vertex;
+    };
+
+    for ( std::size_t y = 0; y + 1 < side; y++ )
+    {
+        for ( std::size_t x = 0; x + 1 < side; x++ )
+        {
+            stream.push_back( gridVertex( x,     y     ) );
+            stream.push_back( gridVertex( x + 1, y     ) );
+            stream.push_back( gridVertex( x,     y + 1 ) );
+            stream.push_back( gridVertex( x + 1, y     ) );
+            stream.push_back( gridVertex( x + 1, y + 1 ) );
+            stream.push_back( gridVertex( x,     y + 1 ) );
+        }
+    }
+
+    out << "Welding " << stream.size() << " indices, best of " << RUNS
+        << " runs" << std::endl;
+
+    // The previous Model::init approach
+    FrameStatistics mapStatistics( RUNS );
+    std::size_t     mapUnique = 0;
+    for ( uint32_t run = 0; run < RUNS; run++ )
+    {
+        mapStatistics.begin();
+
+        std::unordered_map<Vertex, int> uniqueVertices = {};
+        std::vector<Vertex>             vertices;
+        std::vector<uint32_t>           indices;
+
+        for ( const auto& vertex : stream )
+        {
+            if ( uniqueVertices.count( vertex ) == 0 )
+            {
+                uniqueVertices[vertex] = vertices.size();
+                vertices.push_back( vertex );
+            }
+
+            indices.push_back( uniqueVertices[vertex] );
+        }
+
+        mapStatistics.end();
+        mapUnique = vertices.size();
+    }
+
+    double baseline = mapStatistics.min();
+    ReportWeld( out, "unordered_map", mapStatistics, mapUnique, baseline );
+
+    auto runWelder = [&]( const std::string& label, ThreadPool* pool ) {
+        FrameStatistics       statistics( RUNS );
+        std::vector<uint32_t> remap;
+        std::vector<uint32_t> firsts;
+
+        for ( uint32_t run = 0; run < RUNS; run++ )
+        {
+            statistics.begin();
+            WeldVertices( stream.data(),
+                          sizeof(Vertex),
+                          stream.size(),
+                          remap,
+                          firsts,
+                          pool );
+            statistics.end();
+        }
+
+        ReportWeld( out, label, statistics, firsts.size(), baseline );
+    };
+
+    runWelder( "weld serial", nullptr );
+
+    ThreadPool pool( 0 );
+    runWelder( "weld " + std::to_string( pool.getThreadCount() ) + " threads",
+               &pool );
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Frame Timing
+ */
+
+class FrameStatistics
+{
+public:
+
+    FrameStatistics() {}
+
+    FrameStatistics( std::size_t expectedFrames )
+    {
+        this->init( expectedFrames );
+    }
+
+    void init( std::size_t expectedFrames );
+
+    void reset();
+
+    // Marks the start of a frame.
+    void begin();
+
+    // Marks the end of a frame and records its duration.
+    void end();
+
+    // Records an externally measured frame time in milliseconds.
+    void addSample( double milliseconds );
+
+    std::size_t count() const;
+
+    double mean() const;
+
+    double min() const;
+
+    double max() const;
+
+    // Returns the p-th percentile ( 0 <= p <= 100 ) using nearest rank.
+    double percentile( double p ) const;
+
+    void report( std::ostream& out, const std::string& label ) const;
+
+private:
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+    std::vector<double> samples;
+    Clock::time_point   start;
+    Clock::time_point   first;
+    Clock::time_point   last;
+};
+
+/*
+ * Vertex Welding
+ */
+
+// Welds a synthetic grid mesh of about indexCount indices with
+// std::unordered_map, the serial welder and the parallel welder, and
+// reports the timings of each.
+void RunWeldBenchmark( std::size_t indexCount, std::ostream& out );
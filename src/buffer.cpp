@@ -1,26 +1,32 @@
 #include <cstring>
 #include "common.hpp"
 #include "buffer.hpp"
+#include "upload.hpp"
 
 void Buffer::init( Device*          device,
-                   VkQueue          queue,
-                   CommandPool*     commandPool,
+                   UploadContext*   upload,
                    VkDeviceSize     size,
-                   BufferUsage      usage )
+                   BufferUsage      usage,
+                   MemoryLocation   location )
 {
-    this->device      = device;
-    this->queue       = queue;
-    this->commandPool = commandPool;
-    this->size        = size;
+    this->device       = device;
+    this->upload       = upload;
+    this->uploadTicket = 0;
+    this->size         = size;
+    this->usage        = usage;
+    this->location     = location;
 
-    // Create staging buffer.
-        
     VkBufferUsageFlags    uflags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
     VkMemoryPropertyFlags pflags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
-    this->staging       = this->createBuffer( uflags );
-    this->stagingMemory = this->allocateMemory( staging, pflags );
+    // Create staging buffer. Host visible buffers are written directly.
+
+    if ( this->location == MemoryLocation::DEVICE )
+    {
+        this->staging       = this->createBuffer( uflags );
+        this->stagingMemory = this->allocateMemory( staging, pflags );
+    }
 
     //  Create device buffer.
         
@@ -36,8 +42,19 @@ void Buffer::init( Device*          device,
     case BufferUsage::UNIFORM:
         uflags |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
         break;
+    case BufferUsage::STORAGE:
+        uflags |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        break;
+    case BufferUsage::INDIRECT:
+        uflags |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+        break;
+    }
+    if ( this->location == MemoryLocation::DEVICE )
+    {
+        pflags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     }
-    pflags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
     this->id     = this->createBuffer( uflags );
     this->memory = this->allocateMemory( this->id, pflags );
@@ -47,21 +64,26 @@ void Buffer::init( Device*          device,
 
 void Buffer::deinit(  )
 {
-    if ( this->memory != VK_NULL_HANDLE )
+    // Pending uploads may still read the staging buffer or write this one.
+    if ( this->id != VK_NULL_HANDLE && this->upload != nullptr )
     {
-        this->device->freeMemory( this->memory );
+        this->upload->wait( this->uploadTicket );
     }
+
     if ( this->id != VK_NULL_HANDLE )
     {
         this->device->destroyBuffer( this->id );
-    }
-    if ( this->stagingMemory != VK_NULL_HANDLE )
-    {
-        this->device->freeMemory( this->stagingMemory );
+        this->id = VK_NULL_HANDLE;
     }
     if ( this->staging != VK_NULL_HANDLE )
     {
         this->device->destroyBuffer( this->staging );
+        this->staging = VK_NULL_HANDLE;
+    }
+    if ( this->device != nullptr )
+    {
+        this->device->allocator.free( this->memory );
+        this->device->allocator.free( this->stagingMemory );
     }
 }
 
@@ -73,50 +95,68 @@ void Buffer::copy( void*       data,
 
     len = ( len > this->size ) ? this->size : len;
 
+    // Host visible memory needs no transfer.
+    if ( this->location == MemoryLocation::HOST )
+    {
+        if ( data != nullptr )
+        {
+            std::memcpy( this->memory.mapped, data, len );
+        }
+
+        return;
+    }
+
     if ( data != nullptr )
     {
-        void*        mem  = nullptr;
-        VkDeviceSize size = (VkDeviceSize)this->size;
-            
-        this->device->mapMemory( this->stagingMemory,
-                                 0,
-                                 size,
-                                 0,
-                                 &mem );
-        std::memcpy( mem, data, size );
-        this->device->unmapMemory( this->stagingMemory );
+        // Don't overwrite staging data an earlier upload has yet to read.
+        this->upload->wait( this->uploadTicket );
+
+        std::memcpy( this->stagingMemory.mapped, data, len );
     }
 
     if ( toDevice )
     {
-        CommandBuffer commandBuffer( this->device,
-                                     this->queue,
-                                     this->commandPool );
-        commandBuffer.begin( CommandBufferUsage::ONE_TIME );
+        CommandBuffer& commandBuffer = this->upload->getCommandBuffer();
             
         VkBufferCopy copyRegion = {};
         copyRegion.srcOffset = 0;
         copyRegion.dstOffset = 0;
-        copyRegion.size      = size;
+        copyRegion.size      = len;
 
         commandBuffer.copyBuffer( this->staging, this->id, 1, &copyRegion );
 
-        commandBuffer.end();
-
-        // Submit CommandBuffer.
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers    = &commandBuffer.id;
-
-        this->device->queueWaitIdle( queue );
-        VK_CHECK_RESULT( this->device->queueSubmit( this->queue,
-                                                    1,
-                                                    &submitInfo,
-                                                    VK_NULL_HANDLE ) );
-        this->device->queueWaitIdle( queue );
-
-        //commandBuffer.deinit();
+        VkAccessFlags        dstAccess = 0;
+        VkPipelineStageFlags dstStage  = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        switch( this->usage )
+        {
+        case BufferUsage::VERTEX:
+            dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+            break;
+        case BufferUsage::INDEX:
+            dstAccess = VK_ACCESS_INDEX_READ_BIT;
+            break;
+        case BufferUsage::UNIFORM:
+            dstAccess = VK_ACCESS_UNIFORM_READ_BIT;
+            dstStage  = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            break;
+        case BufferUsage::STORAGE:
+            dstAccess = VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+            dstStage  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            break;
+        case BufferUsage::INDIRECT:
+            dstAccess = VK_ACCESS_SHADER_READ_BIT |
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+            dstStage  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+            break;
+        }
+
+        this->upload->transferOwnership( this->id, dstAccess, dstStage );
+
+        this->uploadTicket = this->upload->getTicket();
     }
 }
 
@@ -135,25 +175,22 @@ VkBuffer Buffer::createBuffer( VkBufferUsageFlags usage )
     return buffer;
 }
 
-VkDeviceMemory Buffer::allocateMemory( VkBuffer              buffer,
-                                       VkMemoryPropertyFlags props )
+Allocation Buffer::allocateMemory( VkBuffer              buffer,
+                                   VkMemoryPropertyFlags props )
 {
     VkMemoryRequirements memreqs;
     this->device->getBufferMemoryRequirements( buffer,
                                                &memreqs );
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize  = memreqs.size;
-    allocInfo.memoryTypeIndex = FindMemoryType( this->device->physicalDevice,
-                                                memreqs.memoryTypeBits,
-                                                props );
-
-    VkDeviceMemory memory2 = VK_NULL_HANDLE;
-    VK_CHECK_RESULT( this->device->allocateMemory( &allocInfo,
-                                                   &memory2 ) );
+    Allocation allocation = this->device->allocator.allocate(
+        memreqs,
+        props,
+        AllocationType::LINEAR
+        );
 
-    this->device->bindBufferMemory( buffer, memory2, 0 );
+    VK_CHECK_RESULT( this->device->bindBufferMemory( buffer,
+                                                     allocation.memory,
+                                                     allocation.offset ) );
 
-    return memory2;
+    return allocation;
 }
@@ -1,16 +1,26 @@
 #pragma once
 
+#include "common.hpp"
 #include "commandbuffer.hpp"
 #include "device.hpp"
 #include "utils.hpp"
 
 class CommandPool;
+class UploadContext;
 
 enum class BufferUsage
 {
     VERTEX,
     INDEX,
-    UNIFORM
+    UNIFORM,
+    STORAGE, // Read and written by shaders, and bindable as a vertex buffer
+    INDIRECT // Draw or dispatch parameters, written by shaders
+};
+
+enum class MemoryLocation
+{
+    DEVICE, // Device local, written through a staging buffer
+    HOST    // Host visible and coherent, written directly by the CPU
 };
 
 class Buffer
@@ -19,30 +29,32 @@ class Buffer
 
 public:
 
-    VkBuffer       id;
-    VkDeviceMemory memory;
+    VkBuffer   id = VK_NULL_HANDLE;
+    Allocation memory;
 
-    Buffer( Device*      device,
-            VkQueue      queue,
-            CommandPool* commandPool,
-            VkDeviceSize size,
-            BufferUsage  usage )
+    Buffer( Device*        device,
+            UploadContext* upload,
+            VkDeviceSize   size,
+            BufferUsage    usage,
+            MemoryLocation location = MemoryLocation::DEVICE )
     {
-        this->init( device, queue, commandPool, size, usage );
+        this->init( device, upload, size, usage, location );
     }
 
     Buffer() {}
 
     ~Buffer() { this->deinit(); }
 
-    void init( Device*      device,
-               VkQueue      queue,
-               CommandPool* commandPool,
-               VkDeviceSize size,
-               BufferUsage  usage );
+    void init( Device*        device,
+               UploadContext* upload,
+               VkDeviceSize   size,
+               BufferUsage    usage,
+               MemoryLocation location = MemoryLocation::DEVICE );
 
     void deinit();
 
+    // Writes data to the buffer. Device local buffers record the transfer
+    // into the upload context and complete once its batch has executed.
     void copy( void*       data     = nullptr,
                bool        toDevice = true,
                std::size_t len      = UINT32_MAX );
@@ -50,16 +62,18 @@ public:
 private:
 
     VkBuffer         staging       = VK_NULL_HANDLE;
-    VkDeviceMemory   stagingMemory = VK_NULL_HANDLE;
+    Allocation       stagingMemory;
 
     Device*          device        = nullptr;
-    VkQueue          queue         = VK_NULL_HANDLE;
-    CommandPool*     commandPool   = nullptr;
+    UploadContext*   upload        = nullptr;
+    UploadTicket     uploadTicket  = 0;
     VkDeviceSize     size          = 0;
+    BufferUsage      usage         = BufferUsage::VERTEX;
+    MemoryLocation   location      = MemoryLocation::DEVICE;
     bool             initialized   = false;
 
     VkBuffer createBuffer( VkBufferUsageFlags usage );
 
-    VkDeviceMemory allocateMemory( VkBuffer              buffer,
-                                   VkMemoryPropertyFlags props );
+    Allocation allocateMemory( VkBuffer              buffer,
+                               VkMemoryPropertyFlags props );
 };
@@ -10,8 +10,8 @@ void CommandPool::init( Device*  device,
     
     VkCommandPoolCreateInfo poolCreateInfo = {};
     poolCreateInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolCreateInfo.flags            = 0;
-    poolCreateInfo.queueFamilyIndex = this->device->graphicsQueueIdx; 
+    poolCreateInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolCreateInfo.queueFamilyIndex = queueIdx;
 
     VK_CHECK_RESULT( this->device->createCommandPool( &poolCreateInfo,
                                                       &this->id ) );
@@ -19,7 +19,11 @@ void CommandPool::init( Device*  device,
 
 void CommandPool::deinit()
 {
-    this->device->destroyCommandPool( this->id );
+    if ( this->id != VK_NULL_HANDLE )
+    {
+        this->device->destroyCommandPool( this->id );
+        this->id = VK_NULL_HANDLE;
+    }
 }
 
 void CommandPool::reset()
@@ -28,11 +32,14 @@ void CommandPool::reset()
                                     VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT );
 }
 
-void CommandPool::allocateCommandBuffer( VkCommandBuffer* cmdbuf )
+void CommandPool::allocateCommandBuffer( VkCommandBuffer*   cmdbuf,
+                                         CommandBufferLevel level )
 {
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.level              = ( level == CommandBufferLevel::SECONDARY )
+                                   ? VK_COMMAND_BUFFER_LEVEL_SECONDARY
+                                   : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandPool        = this->id;
     allocInfo.commandBufferCount = 1;
 
@@ -44,15 +51,17 @@ void CommandPool::freeCommandBuffer( VkCommandBuffer* commandBuffer )
     this->device->freeCommandBuffers( this->id, 1, commandBuffer );
 }
 
-void CommandBuffer::init( Device*      device,
-                          VkQueue      queue,
-                          CommandPool* pool )
+void CommandBuffer::init( Device*            device,
+                          VkQueue            queue,
+                          CommandPool*       pool,
+                          CommandBufferLevel level )
 {
     this->device = device;
     this->queue  = queue;
     this->pool   = pool;
+    this->level  = level;
 
-    this->pool->allocateCommandBuffer( &this->id );
+    this->pool->allocateCommandBuffer( &this->id, this->level );
 }
 
 void CommandBuffer::deinit()
@@ -89,15 +98,64 @@ void CommandBuffer::begin( CommandBufferUsage usage )
     this->began = true;
 }
 
+void CommandBuffer::begin( RenderPass&        renderPass,
+                           uint32_t           subpass,
+                           VkFramebuffer      framebuffer,
+                           CommandBufferUsage usage )
+{
+    assert( !this->began && this->level == CommandBufferLevel::SECONDARY );
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass  = renderPass.renderPass;
+    inheritanceInfo.subpass     = subpass;
+    inheritanceInfo.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags            = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    switch( usage )
+    {
+    case CommandBufferUsage::ONE_TIME:
+        beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        break;
+    case CommandBufferUsage::SIMULTANEOUS_USE:
+        beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        break;
+    }
+
+    vkBeginCommandBuffer( this->id, &beginInfo );
+
+    this->began      = true;
+    this->renderPass = true;
+}
+
 void CommandBuffer::end()
 {
     assert( this->began && !this->ended );
 
     VK_CHECK_RESULT( vkEndCommandBuffer( this->id ) );
 
+    // A secondary buffer's part of the render pass ends with the buffer
+    if ( this->level == CommandBufferLevel::SECONDARY )
+    {
+        this->renderPass = false;
+    }
+
     this->ended = true;
 }
 
+void CommandBuffer::reset()
+{
+    assert( !this->renderPass );
+
+    VK_CHECK_RESULT( vkResetCommandBuffer( this->id, 0 ) );
+
+    this->began = false;
+    this->ended = false;
+}
+
 // RenderPass Commands
 void CommandBuffer::beginRenderPass( RenderPass&              renderPass,
                                      VkFramebuffer              framebuffer,
@@ -144,6 +202,26 @@ void CommandBuffer::executeCommands( uint32_t               commandBufferCount,
     vkCmdExecuteCommands( this->id, commandBufferCount, pCommandBuffers );
 }
 
+void CommandBuffer::executeCommands( const std::vector<CommandBuffer*>& commandBuffers )
+{
+    assert( this->began && this->level == CommandBufferLevel::PRIMARY );
+
+    std::vector<VkCommandBuffer> ids;
+    ids.reserve( commandBuffers.size() );
+
+    for ( auto commandBuffer : commandBuffers )
+    {
+        assert( commandBuffer->ended &&
+                commandBuffer->level == CommandBufferLevel::SECONDARY );
+        ids.push_back( commandBuffer->id );
+    }
+
+    if ( !ids.empty() )
+    {
+        vkCmdExecuteCommands( this->id, ids.size(), ids.data() );
+    }
+}
+
 // State Commands
 
 void CommandBuffer::bindPipeline( VkPipelineBindPoint pipelineBindPoint,
@@ -154,6 +232,14 @@ void CommandBuffer::bindPipeline( VkPipelineBindPoint pipelineBindPoint,
     vkCmdBindPipeline( this->id, pipelineBindPoint, pipeline.pipeline );
 }
 
+void CommandBuffer::bindPipeline( VkPipelineBindPoint pipelineBindPoint,
+                                  ComputePipeline&    pipeline )
+{
+    assert( this->began );
+
+    vkCmdBindPipeline( this->id, pipelineBindPoint, pipeline.pipeline );
+}
+
 void CommandBuffer::bindDescriptorSets(
     VkPipelineBindPoint               pipelineBindPoint,
     GraphicsPipeline&                 pipeline,
@@ -165,6 +251,23 @@ void CommandBuffer::bindDescriptorSets(
     uint32_t                          dynamicOffsetCount,
     const uint32_t*                   pDynamicOffsets
     )
+{
+    this->bindDescriptorSets( pipelineBindPoint,
+                              layout,
+                              firstSet,
+                              descriptorSets,
+                              dynamicOffsetCount,
+                              pDynamicOffsets );
+}
+
+void CommandBuffer::bindDescriptorSets(
+    VkPipelineBindPoint               pipelineBindPoint,
+    PipelineLayout&                   layout,
+    uint32_t                          firstSet,
+    const std::vector<DescriptorSet>& descriptorSets,
+    uint32_t                          dynamicOffsetCount,
+    const uint32_t*                   pDynamicOffsets
+    )
 {
     assert( this->began );
 
@@ -543,6 +646,15 @@ void CommandBuffer::pushConstants( VkPipelineLayout   layout,
                         size, pValues );
 }
 
+void CommandBuffer::pushConstants( PipelineLayout&    layout,
+                                   VkShaderStageFlags stageFlags,
+                                   uint32_t           offset,
+                                   uint32_t           size,
+                                   const void*        pValues )
+{
+    this->pushConstants( layout.id, stageFlags, offset, size, pValues );
+}
+
 //TODO: Remove when other cmdbuf methods have been added
 VkCommandBuffer* CommandBuffer::getHandle()
 {
@@ -23,6 +23,12 @@ enum class CommandBufferUsage
     SIMULTANEOUS_USE
 };
 
+enum class CommandBufferLevel
+{
+    PRIMARY,  // Submitted to a queue
+    SECONDARY // Executed from a primary command buffer
+};
+
 class CommandPool
 {
     friend class Device;
@@ -55,7 +61,8 @@ private:
     Device*       device = nullptr;
     VkQueue       queue  = VK_NULL_HANDLE;
 
-    void allocateCommandBuffer( VkCommandBuffer* cmdbuf );
+    void allocateCommandBuffer( VkCommandBuffer*   cmdbuf,
+                                CommandBufferLevel level = CommandBufferLevel::PRIMARY );
     void freeCommandBuffer( VkCommandBuffer* commandBuffer );
 };
 
@@ -86,7 +93,8 @@ public:
           pool( c.pool ),
           began( c.began ),
           renderPass( c.renderPass ),
-          ended( c.began )
+          ended( c.ended ),
+          level( c.level )
     {}
 
     CommandBuffer( CommandBuffer&& c ) noexcept
@@ -96,31 +104,55 @@ public:
           pool( c.pool ),
           began( c.began ),
           renderPass( c.renderPass ),
-          ended( c.began )
+          ended( c.ended ),
+          level( c.level )
     {}
 
-    CommandBuffer( Device*      device,
-                   VkQueue      queue,
-                   CommandPool* pool )
+    CommandBuffer( Device*            device,
+                   VkQueue            queue,
+                   CommandPool*       pool,
+                   CommandBufferLevel level = CommandBufferLevel::PRIMARY )
     {
-        this->init( device, queue, pool );
+        this->init( device, queue, pool, level );
     }
 
     ~CommandBuffer() { this->deinit(); }
 
-    void init( Device*      device,
-               VkQueue      queue,
-               CommandPool* pool );
+    void init( Device*            device,
+               VkQueue            queue,
+               CommandPool*       pool,
+               CommandBufferLevel level = CommandBufferLevel::PRIMARY );
 
     void deinit();
 
-    CommandBuffer& operator=( CommandBuffer&& c ) { return *this; }
+    CommandBuffer& operator=( CommandBuffer&& c )
+    {
+        this->id         = c.id;
+        this->device     = c.device;
+        this->queue      = c.queue;
+        this->pool       = c.pool;
+        this->began      = c.began;
+        this->renderPass = c.renderPass;
+        this->ended      = c.ended;
+        this->level      = c.level;
+        return *this;
+    }
 
     // Basic Commands
     void begin(
         CommandBufferUsage usage = CommandBufferUsage::SIMULTANEOUS_USE
         );
+    // Begins a secondary command buffer that records into subpass of
+    // renderPass. Giving the framebuffer, if known, may let the driver
+    // optimize. Nothing is inherited besides the render pass, so all
+    // state must be bound again.
+    void begin( RenderPass&        renderPass,
+                uint32_t           subpass,
+                VkFramebuffer      framebuffer = VK_NULL_HANDLE,
+                CommandBufferUsage usage       = CommandBufferUsage::ONE_TIME );
     void end();
+    // Returns the buffer to the initial state so it can be recorded again.
+    void reset();
 
     // RenderPass Commands
     void beginRenderPass( RenderPass&                renderPass,
@@ -134,10 +166,13 @@ public:
     // Execution Commands
     void executeCommands( uint32_t               commandBufferCount,
                           const VkCommandBuffer* pCommandBuffers );
+    void executeCommands( const std::vector<CommandBuffer*>& commandBuffers );
 
     // State Commands
     void bindPipeline( VkPipelineBindPoint pipelineBindPoint,
                        GraphicsPipeline&   pipeline );
+    void bindPipeline( VkPipelineBindPoint pipelineBindPoint,
+                       ComputePipeline&    pipeline );
     void bindDescriptorSets( VkPipelineBindPoint               pipelineBindPoint,
                              GraphicsPipeline&                 pipeline,
                              PipelineLayout&                   layout,
@@ -147,6 +182,12 @@ public:
                              const std::vector<DescriptorSet>& descriptorSets,
                              uint32_t                          dynamicOffsetCount,
                              const uint32_t*                   pDynamicOffsets );
+    void bindDescriptorSets( VkPipelineBindPoint               pipelineBindPoint,
+                             PipelineLayout&                   layout,
+                             uint32_t                          firstSet,
+                             const std::vector<DescriptorSet>& descriptorSets,
+                             uint32_t                          dynamicOffsetCount,
+                             const uint32_t*                   pDynamicOffsets );
     void bindVertexBuffers( uint32_t             firstBinding,
                             std::vector<Buffer>& buffers,
                             const VkDeviceSize*  pOffsets );
@@ -283,6 +324,11 @@ public:
                         uint32_t           offset,
                         uint32_t           size,
                         const void*        pValues );
+    void pushConstants( PipelineLayout&    layout,
+                        VkShaderStageFlags stageFlags,
+                        uint32_t           offset,
+                        uint32_t           size,
+                        const void*        pValues );
 
     //TODO: Remove when other cmdbuf methods have been added
     VkCommandBuffer* getHandle();
@@ -296,4 +342,6 @@ private:
     bool            began      = false;
     bool            renderPass = false;
     bool            ended      = false;
+
+    CommandBufferLevel level = CommandBufferLevel::PRIMARY;
 };
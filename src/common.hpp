@@ -16,6 +16,9 @@ typedef VkExtent3D Extent3D;
 typedef VkOffset2D Offset2D;
 typedef VkOffset3D Offset3D;
 
+// Identifies a batch of uploads recorded by an UploadContext.
+typedef uint64_t UploadTicket;
+
 /**
  * Common Enum Declarations
  */
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "common.hpp"
+#include "culling.hpp"
+
+// Smallest visible instance buffer allocated
+static const uint32_t MIN_VISIBLE_CAPACITY = 64;
+
+// Descriptor bindings of shaders/cull.comp
+static const uint32_t CULL_INSTANCES_BINDING    = 0;
+static const uint32_t CULL_VISIBLE_BINDING      = 1;
+static const uint32_t CULL_DRAW_COMMAND_BINDING = 2;
+
+void GetFrustumPlanes( const glm::mat4& transform, glm::vec4 planes[6] )
+{
+    // Rows of the matrix, as GLM stores columns
+    glm::vec4 rows[4];
+    for ( uint32_t row = 0; row < 4; row++ )
+    {
+        rows[ row ] = glm::vec4( transform[0][ row ],
+                                 transform[1][ row ],
+                                 transform[2][ row ],
+                                 transform[3][ row ] );
+    }
+
+    planes[0] = rows[3] + rows[0]; // Left
+    planes[1] = rows[3] - rows[0]; // Right
+    planes[2] = rows[3] + rows[1]; // Bottom
+    planes[3] = rows[3] - rows[1]; // Top
+    planes[4] = rows[2];           // Near
+    planes[5] = rows[3] - rows[2]; // Far
+
+    for ( uint32_t p = 0; p < 6; p++ )
+    {
+        planes[ p ] /= glm::length( glm::vec3( planes[ p ] ) );
+    }
+}
+
+/*
+ * Frustum Culler
+ */
+
+void FrustumCuller::init( Device*                     device,
+                          UploadContext*              upload,
+                          LayoutCache*                layouts,
+                          PipelineCache*              cache,
+                          const std::vector<uint8_t>& code,
+                          uint32_t                    frames )
+{
+    this->deinit();
+
+    this->device = device;
+    this->upload = upload;
+
+    this->shader.init( this->device, code );
+
+    const ShaderReflection& reflection = this->shader.getReflection();
+    if ( reflection.getSetCount() != 1 ||
+         reflection.pushConstants.size() != 1 ||
+         reflection.pushConstants[0].size != sizeof(CullConstants) )
+    {
+        throw std::runtime_error( "Culling shader does not match CullConstants" );
+    }
+
+    DescriptorSetLayout* setLayout = layouts->getSetLayout( reflection.getBindings( 0 ) );
+    PipelineLayout*      layout    = layouts->getPipelineLayout( { setLayout },
+                                                                 reflection.pushConstants );
+
+    this->pipeline.init( this->device,
+                         &this->shader,
+                         layout,
+                         SpecializationConstants(),
+                         cache );
+
+    this->descriptorPool.init( this->device, setLayout, frames );
+
+    this->frames.resize( frames );
+    for ( auto& frame : this->frames )
+    {
+        frame.drawCommand.reset( new Buffer( this->device,
+                                             this->upload,
+                                             sizeof(VkDrawIndexedIndirectCommand),
+                                             BufferUsage::INDIRECT ) );
+
+        this->descriptorSets.push_back( this->descriptorPool.allocateDescriptorSet() );
+    }
+}
+
+void FrustumCuller::deinit()
+{
+    this->frames.clear();
+    this->descriptorSets.clear();
+    this->descriptorPool.deinit();
+    this->pipeline.deinit();
+    this->shader.deinit();
+}
+
+void FrustumCuller::record( CommandBuffer&   commandBuffer,
+                            uint32_t         frame,
+                            Scene&           scene,
+                            const Model&     model,
+                            const glm::mat4& transform )
+{
+    assert( frame < this->frames.size() );
+
+    FrameData& data  = this->frames[ frame ];
+    uint32_t   count = scene.getInstanceCount();
+
+    // The GPU is done with this frame's buffers, so they can be replaced
+    if ( !data.visible || count > data.capacity )
+    {
+        uint32_t capacity = std::max( data.capacity, MIN_VISIBLE_CAPACITY );
+        while ( capacity < count )
+        {
+            capacity *= 2;
+        }
+
+        data.visible.reset( new Buffer( this->device,
+                                        this->upload,
+                                        capacity * sizeof(InstanceData),
+                                        BufferUsage::STORAGE ) );
+        data.capacity = capacity;
+    }
+
+    // The scene may have replaced its buffer since the last frame
+    DescriptorSet& descriptorSet = this->descriptorSets[ frame ];
+    descriptorSet.update( scene.getInstanceBuffer( frame ), CULL_INSTANCES_BINDING, 0 );
+    descriptorSet.update( *data.visible, CULL_VISIBLE_BINDING, 0 );
+    descriptorSet.update( *data.drawCommand, CULL_DRAW_COMMAND_BINDING, 0 );
+
+    // Start from no instances, culling counts the visible ones
+    VkDrawIndexedIndirectCommand drawCommand = {};
+    drawCommand.indexCount = model.indexCount;
+
+    commandBuffer.updateBuffer( data.drawCommand->id,
+                                0,
+                                sizeof(drawCommand),
+                                (const uint32_t*)&drawCommand );
+
+    VkBufferMemoryBarrier resetBarrier = {};
+    resetBarrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    resetBarrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    resetBarrier.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT |
+                                       VK_ACCESS_SHADER_WRITE_BIT;
+    resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    resetBarrier.buffer              = data.drawCommand->id;
+    resetBarrier.offset              = 0;
+    resetBarrier.size                = VK_WHOLE_SIZE;
+
+    commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                   0,
+                                   0, nullptr,
+                                   1, &resetBarrier,
+                                   0, nullptr );
+
+    if ( count > 0 )
+    {
+        glm::vec3 boundsCenter = 0.5f * ( model.boundsMin + model.boundsMax );
+        float     boundsRadius = 0.5f * glm::length( model.boundsMax - model.boundsMin );
+
+        CullConstants constants = {};
+        GetFrustumPlanes( transform, constants.planes );
+        constants.sphere        = glm::vec4( boundsCenter, boundsRadius );
+        constants.instanceCount = count;
+
+        PipelineLayout& layout = *this->pipeline.getLayout();
+
+        commandBuffer.bindPipeline( VK_PIPELINE_BIND_POINT_COMPUTE, this->pipeline );
+        commandBuffer.bindDescriptorSets( VK_PIPELINE_BIND_POINT_COMPUTE,
+                                          layout,
+                                          0,
+                                          { descriptorSet },
+                                          0,
+                                          nullptr );
+        commandBuffer.pushConstants( layout,
+                                     VK_SHADER_STAGE_COMPUTE_BIT,
+                                     0,
+                                     sizeof(constants),
+                                     &constants );
+        this->pipeline.dispatch( commandBuffer, count );
+    }
+
+    // Make the visible instances and their count available to the draw
+    VkMemoryBarrier cullBarrier = {};
+    cullBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+    commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                   VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                   VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                   0,
+                                   1, &cullBarrier,
+                                   0, nullptr,
+                                   0, nullptr );
+}
+
+Buffer& FrustumCuller::getVisibleInstances( uint32_t frame )
+{
+    assert( frame < this->frames.size() && this->frames[ frame ].visible );
+
+    return *this->frames[ frame ].visible;
+}
+
+Buffer& FrustumCuller::getDrawCommand( uint32_t frame )
+{
+    assert( frame < this->frames.size() );
+
+    return *this->frames[ frame ].drawCommand;
+}
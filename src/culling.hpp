@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "buffer.hpp"
+#include "commandbuffer.hpp"
+#include "descriptor.hpp"
+#include "device.hpp"
+#include "model.hpp"
+#include "pipeline.hpp"
+#include "pipelinecache.hpp"
+#include "scene.hpp"
+#include "shader.hpp"
+
+class UploadContext;
+
+/*
+ * Frustum Culling
+ */
+
+// Push constants of shaders/cull.comp.
+struct CullConstants
+{
+    glm::vec4 planes[6];     // Inward facing, normalized
+    glm::vec4 sphere;        // Model space bounding sphere, radius in w
+    uint32_t  instanceCount;
+};
+
+// Extracts the planes of the frustum transform clips to, in the space
+// transform takes its input from. Depth is expected to range from 0 to 1.
+void GetFrustumPlanes( const glm::mat4& transform, glm::vec4 planes[6] );
+
+// Culls the instances of a Scene against the view frustum on the GPU. A
+// compute pass appends the transforms of visible instances to a buffer and
+// counts them into a VkDrawIndexedIndirectCommand, so the CPU records the
+// same commands however many instances there are.
+class FrustumCuller
+{
+public:
+
+    FrustumCuller() {}
+
+    FrustumCuller( const FrustumCuller& ) = delete;
+    FrustumCuller& operator=( const FrustumCuller& ) = delete;
+
+    ~FrustumCuller() { this->deinit(); }
+
+    // Builds the culling pipeline from code, the SPIR-V of shaders/cull.comp,
+    // with layouts taken from layouts.
+    void init( Device*                     device,
+               UploadContext*              upload,
+               LayoutCache*                layouts,
+               PipelineCache*              cache,
+               const std::vector<uint8_t>& code,
+               uint32_t                    frames );
+
+    void deinit();
+
+    // Records culling of the instances in the scene's buffer for frame,
+    // which must be up to date. transform takes model space to clip space
+    // without the instance transform. Must be recorded outside a render
+    // pass, and the frame's previous GPU use must have completed.
+    void record( CommandBuffer&   commandBuffer,
+                 uint32_t         frame,
+                 Scene&           scene,
+                 const Model&     model,
+                 const glm::mat4& transform );
+
+    // Transforms of the visible instances, bound as the instance buffer.
+    Buffer& getVisibleInstances( uint32_t frame );
+
+    // A single VkDrawIndexedIndirectCommand drawing the visible instances.
+    Buffer& getDrawCommand( uint32_t frame );
+
+private:
+
+    struct FrameData
+    {
+        std::unique_ptr<Buffer> visible;
+        std::unique_ptr<Buffer> drawCommand;
+        uint32_t                capacity = 0; // In instances
+    };
+
+    Device*                    device = nullptr;
+    UploadContext*             upload = nullptr;
+    ComputeShader              shader;
+    ComputePipeline            pipeline;
+    DescriptorPool             descriptorPool;
+    std::vector<DescriptorSet> descriptorSets; // One per frame
+    std::vector<FrameData>     frames;
+};
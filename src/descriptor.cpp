@@ -1,6 +1,26 @@
+#include <algorithm>
+#include <cassert>
+
 #include "common.hpp"
 #include "descriptor.hpp"
-#include <cassert>
+#include "utils.hpp"
+
+template<typename T>
+static T* FindLayout( std::unordered_multimap<uint64_t, T>& entries,
+                      uint64_t                              hash,
+                      const std::vector<uint8_t>&           key )
+{
+    auto range = entries.equal_range( hash );
+    for ( auto it = range.first; it != range.second; ++it )
+    {
+        if ( it->second.key == key )
+        {
+            return &it->second;
+        }
+    }
+
+    return nullptr;
+}
 
 void DescriptorBinding::init( uint32_t           binding,
                               DescriptorType     type,
@@ -49,6 +69,7 @@ void DescriptorSetLayout::deinit()
     if ( this->id != VK_NULL_HANDLE )
     {
         this->device->destroyDescriptorSetLayout( this->id );
+        this->id = VK_NULL_HANDLE;
     }
 }
 
@@ -92,6 +113,12 @@ void DescriptorPool::init( Device*              device,
         }
     }
 
+    // Room for the descriptors of every set, not just one
+    for ( auto& psiz : poolSizes )
+    {
+        psiz.descriptorCount *= this->maxSets;
+    }
+
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = poolSizes.size();
@@ -107,6 +134,7 @@ void DescriptorPool::deinit()
     if ( this->id != VK_NULL_HANDLE )
     {
         this->device->destroyDescriptorPool( this->id );
+        this->id = VK_NULL_HANDLE;
     }
 }
 
@@ -213,10 +241,9 @@ void DescriptorSet::update( const Image&   image,
 }
 
 void PipelineLayout::init( Device*                                 device,
-                           const std::vector<DescriptorSetLayout>& layouts )
+                           const std::vector<DescriptorSetLayout>& layouts,
+                           const std::vector<VkPushConstantRange>& pushConstantRanges )
 {
-    this->device = device;
-    
     std::vector<VkDescriptorSetLayout> internalLayouts;
     internalLayouts.reserve( layouts.size() );
 
@@ -225,14 +252,38 @@ void PipelineLayout::init( Device*                                 device,
         internalLayouts.emplace_back( layout.id );
     }
 
+    this->create( device, internalLayouts, pushConstantRanges );
+}
+
+void PipelineLayout::init( Device*                                  device,
+                           const std::vector<DescriptorSetLayout*>& layouts,
+                           const std::vector<VkPushConstantRange>&  pushConstantRanges )
+{
+    std::vector<VkDescriptorSetLayout> internalLayouts;
+    internalLayouts.reserve( layouts.size() );
+
+    for ( auto layout : layouts )
+    {
+        internalLayouts.emplace_back( layout->id );
+    }
+
+    this->create( device, internalLayouts, pushConstantRanges );
+}
+
+void PipelineLayout::create( Device*                                   device,
+                             const std::vector<VkDescriptorSetLayout>& internalLayouts,
+                             const std::vector<VkPushConstantRange>&   pushConstantRanges )
+{
+    this->device = device;
+
     VkPipelineLayoutCreateInfo info;
     info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     info.pNext                  = nullptr;
     info.flags                  = 0;
     info.setLayoutCount         = internalLayouts.size();
     info.pSetLayouts            = internalLayouts.data();
-    info.pushConstantRangeCount = 0;
-    info.pPushConstantRanges    = nullptr;
+    info.pushConstantRangeCount = pushConstantRanges.size();
+    info.pPushConstantRanges    = pushConstantRanges.data();
 
     VK_CHECK_RESULT( this->device->createPipelineLayout( &info, &this->id ) );
 }
@@ -242,5 +293,98 @@ void PipelineLayout::deinit()
     if ( this->id != VK_NULL_HANDLE )
     {
         this->device->destroyPipelineLayout( this->id );
+        this->id = VK_NULL_HANDLE;
+    }
+}
+
+/*
+ * Layout Cache
+ */
+
+void LayoutCache::init( Device* device )
+{
+    this->deinit();
+
+    this->device = device;
+}
+
+void LayoutCache::deinit()
+{
+    // Pipeline layouts refer to the set layouts
+    this->pipelineLayouts.clear();
+    this->setLayouts.clear();
+}
+
+DescriptorSetLayout* LayoutCache::getSetLayout(
+    const std::vector<DescriptorBinding>& bindings
+    )
+{
+    std::vector<DescriptorBinding> sorted( bindings );
+    std::sort( sorted.begin(),
+               sorted.end(),
+               []( const DescriptorBinding& lhs, const DescriptorBinding& rhs ) {
+                   return lhs.binding < rhs.binding;
+               } );
+
+    std::vector<uint8_t> key;
+    for ( const auto& binding : sorted )
+    {
+        AppendKey( key, binding.binding );
+        AppendKey( key, binding.type );
+        AppendKey( key, binding.count );
+        AppendKey( key, binding.stages );
+    }
+    uint64_t hash = HashBytes( key.data(), key.size() );
+
+    auto entry = FindLayout( this->setLayouts, hash, key );
+    if ( entry == nullptr )
+    {
+        Entry<DescriptorSetLayout> created;
+        created.key    = std::move( key );
+        created.layout = std::unique_ptr<DescriptorSetLayout>(
+            new DescriptorSetLayout( this->device, sorted )
+            );
+
+        entry = &this->setLayouts.emplace( hash, std::move( created ) )->second;
     }
+
+    return entry->layout.get();
+}
+
+PipelineLayout* LayoutCache::getPipelineLayout(
+    const std::vector<DescriptorSetLayout*>& setLayouts,
+    const std::vector<VkPushConstantRange>&  pushConstantRanges
+    )
+{
+    // Set layouts are unique within the cache, so their addresses identify
+    // their contents
+    std::vector<uint8_t> key;
+    for ( auto layout : setLayouts )
+    {
+        AppendKey( key, layout );
+    }
+    for ( const auto& range : pushConstantRanges )
+    {
+        AppendKey( key, range );
+    }
+    uint64_t hash = HashBytes( key.data(), key.size() );
+
+    auto entry = FindLayout( this->pipelineLayouts, hash, key );
+    if ( entry == nullptr )
+    {
+        Entry<PipelineLayout> created;
+        created.key    = std::move( key );
+        created.layout = std::unique_ptr<PipelineLayout>(
+            new PipelineLayout( this->device, setLayouts, pushConstantRanges )
+            );
+
+        entry = &this->pipelineLayouts.emplace( hash, std::move( created ) )->second;
+    }
+
+    return entry->layout.get();
+}
+
+std::size_t LayoutCache::getCount() const
+{
+    return this->setLayouts.size() + this->pipelineLayouts.size();
 }
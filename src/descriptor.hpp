@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <vulkan/vulkan.h>
@@ -98,7 +100,9 @@ public:
         id( d.id ),
         device( d.device ),
         bindings( std::move( d.bindings ) )
-    {}
+    {
+        d.id = VK_NULL_HANDLE;
+    }
 
     ~DescriptorSetLayout()
     {
@@ -189,16 +193,28 @@ private:
 struct PipelineLayout
 {
     friend class CommandBuffer;
+    friend class ComputePipeline;
     friend class GraphicsPipeline;
+    friend struct PipelineDescription;
     
 public:
 
     PipelineLayout() {}
 
     PipelineLayout( Device*                                 device,
-                    const std::vector<DescriptorSetLayout>& layouts )
+                    const std::vector<DescriptorSetLayout>& layouts,
+                    const std::vector<VkPushConstantRange>& pushConstantRanges =
+                        std::vector<VkPushConstantRange>() )
+    {
+        this->init( device, layouts, pushConstantRanges );
+    }
+
+    PipelineLayout( Device*                                  device,
+                    const std::vector<DescriptorSetLayout*>& layouts,
+                    const std::vector<VkPushConstantRange>&  pushConstantRanges =
+                        std::vector<VkPushConstantRange>() )
     {
-        this->init( device, layouts );
+        this->init( device, layouts, pushConstantRanges );
     }
 
     ~PipelineLayout()
@@ -207,12 +223,74 @@ public:
     }
 
     void init( Device*                                 device,
-               const std::vector<DescriptorSetLayout>& layouts );
+               const std::vector<DescriptorSetLayout>& layouts,
+               const std::vector<VkPushConstantRange>& pushConstantRanges =
+                   std::vector<VkPushConstantRange>() );
+
+    void init( Device*                                  device,
+               const std::vector<DescriptorSetLayout*>& layouts,
+               const std::vector<VkPushConstantRange>&  pushConstantRanges =
+                   std::vector<VkPushConstantRange>() );
 
     void deinit();
     
 private:
 
+    void create( Device*                                   device,
+                 const std::vector<VkDescriptorSetLayout>& internalLayouts,
+                 const std::vector<VkPushConstantRange>&   pushConstantRanges );
+
     Device*          device = nullptr;
     VkPipelineLayout id     = VK_NULL_HANDLE;
 };
+
+// Descriptor set and pipeline layouts keyed by their contents, so shaders
+// declaring the same bindings share one layout object. Sets allocated for
+// one are then compatible with every pipeline using it.
+class LayoutCache
+{
+public:
+
+    LayoutCache() {}
+
+    LayoutCache( Device* device )
+    {
+        this->init( device );
+    }
+
+    LayoutCache( const LayoutCache& ) = delete;
+    LayoutCache& operator=( const LayoutCache& ) = delete;
+
+    ~LayoutCache() { this->deinit(); }
+
+    void init( Device* device );
+
+    // Destroys every layout. Nothing may still use them.
+    void deinit();
+
+    // The order of bindings does not matter.
+    DescriptorSetLayout* getSetLayout( const std::vector<DescriptorBinding>& bindings );
+
+    // Set layouts must come from this cache.
+    PipelineLayout* getPipelineLayout(
+        const std::vector<DescriptorSetLayout*>& setLayouts,
+        const std::vector<VkPushConstantRange>&  pushConstantRanges =
+            std::vector<VkPushConstantRange>()
+        );
+
+    std::size_t getCount() const;
+
+private:
+
+    template<typename T>
+    struct Entry
+    {
+        std::vector<uint8_t> key;
+        std::unique_ptr<T>   layout;
+    };
+
+    Device* device = nullptr;
+
+    std::unordered_multimap<uint64_t, Entry<DescriptorSetLayout>> setLayouts;
+    std::unordered_multimap<uint64_t, Entry<PipelineLayout>>      pipelineLayouts;
+};
@@ -9,6 +9,10 @@ void Device::init( VkPhysicalDevice               physicalDevice,
                    const std::vector<const char*> validationLayers )
 {
     this->physicalDevice = physicalDevice;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties( this->physicalDevice, &properties );
+    this->limits = PhysicalDeviceLimits( properties.limits );
     
     // Create queues for both the graphics and presentation families
     QueueFamilyIndices indices = FindQueueFamilies( this->physicalDevice,
@@ -16,10 +20,12 @@ void Device::init( VkPhysicalDevice               physicalDevice,
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<int> uniqueQueueFamilies = {
         indices.graphicsFamily,
-        indices.presentFamily
+        indices.presentFamily,
+        indices.transferFamily
     };
     this->graphicsQueueIdx = indices.graphicsFamily;
     this->presentQueueIdx  = indices.presentFamily;
+    this->transferQueueIdx = indices.transferFamily;
         
     float queuePriority = 1.0f;
 
@@ -63,13 +69,19 @@ void Device::init( VkPhysicalDevice               physicalDevice,
                       0, &this->graphicsQueue);
     vkGetDeviceQueue( this->id, this->presentQueueIdx,
                       0, &this->presentQueue );
+    vkGetDeviceQueue( this->id, this->transferQueueIdx,
+                      0, &this->transferQueue );
+
+    this->allocator.init( this );
 }
 
 void Device::deinit()
 {
     if ( this->id != VK_NULL_HANDLE )
     {
+        this->allocator.deinit();
         vkDestroyDevice( this->id, nullptr );
+        this->id = VK_NULL_HANDLE;
     }
 }
 
@@ -125,6 +137,38 @@ void Device::destroySemaphore( VkSemaphore semaphore )
     vkDestroySemaphore( this->id, semaphore, nullptr );
 }
 
+// Fence Methods
+
+VkResult Device::createFence( const VkFenceCreateInfo* pCreateInfo,
+                              VkFence*                 pFence )
+{
+    return vkCreateFence( this->id, pCreateInfo, nullptr, pFence );
+}
+
+void Device::destroyFence( VkFence fence )
+{
+    vkDestroyFence( this->id, fence, nullptr );
+}
+
+VkResult Device::waitForFences( uint32_t       fenceCount,
+                                const VkFence* pFences,
+                                VkBool32       waitAll,
+                                uint64_t       timeout )
+{
+    return vkWaitForFences( this->id, fenceCount, pFences, waitAll, timeout );
+}
+
+VkResult Device::resetFences( uint32_t       fenceCount,
+                              const VkFence* pFences )
+{
+    return vkResetFences( this->id, fenceCount, pFences );
+}
+
+VkResult Device::getFenceStatus( VkFence fence )
+{
+    return vkGetFenceStatus( this->id, fence );
+}
+
 // Descriptor Methods
 
 VkResult Device::createDescriptorSetLayout(
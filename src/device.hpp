@@ -3,27 +3,43 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 
+#include "allocator.hpp"
+#include "instance.hpp"
+
 class Device
 {
     friend class Buffer;
     friend class CommandPool;
+    friend class ComputePipeline;
+    friend class ComputeShader;
     friend class DescriptorPool;
     friend class DescriptorSetLayout;
     friend class DescriptorSetLayoutContainer;
     friend class Image;
+    friend class MemoryAllocator;
     friend class GraphicsPipeline;
     friend class GraphicsShader;
+    friend class OffscreenTarget;
+    friend class PipelineCache;
     friend class PipelineLayout;
     friend class RenderPass;
     friend class SwapChain;
+    friend class Texture;
+    friend class UploadContext;
     
 public:
 
     int              graphicsQueueIdx = -1;
     int              presentQueueIdx  = -1;
+    int              transferQueueIdx = -1;
 
     VkQueue          graphicsQueue = VK_NULL_HANDLE;
     VkQueue          presentQueue  = VK_NULL_HANDLE;
+    VkQueue          transferQueue = VK_NULL_HANDLE; // Same as graphicsQueue without a separate family
+
+    PhysicalDeviceLimits limits;
+
+    MemoryAllocator  allocator;
 
     Device( VkPhysicalDevice               physicalDevice,
             VkSurfaceKHR                   surface,
@@ -76,6 +92,18 @@ public:
                               VkSemaphore*                 pSemaphore );
     void destroySemaphore( VkSemaphore semaphore );
 
+    // Fence Methods
+    VkResult createFence( const VkFenceCreateInfo* pCreateInfo,
+                          VkFence*                 pFence );
+    void destroyFence( VkFence fence );
+    VkResult waitForFences( uint32_t       fenceCount,
+                            const VkFence* pFences,
+                            VkBool32       waitAll,
+                            uint64_t       timeout );
+    VkResult resetFences( uint32_t       fenceCount,
+                          const VkFence* pFences );
+    VkResult getFenceStatus( VkFence fence );
+
     // Descriptor Methods
     void updateDescriptorSets( uint32_t                    descriptorWriteCount,
                                const VkWriteDescriptorSet* pDescriptorWrites,
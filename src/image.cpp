@@ -1,25 +1,36 @@
+#include <algorithm>
 #include <cstring>
 #include "common.hpp"
 #include "device.hpp"
 #include "image.hpp"
+#include "upload.hpp"
 
 void Image::init( Device*          device,
-                  VkQueue          queue,
-                  CommandPool*     commandPool,
+                  UploadContext*   upload,
                   uint32_t         width,
                   uint32_t         height,
                   VkFormat         format,
                   ImageType        type,
                   void*            data,
-                  std::size_t      dataSize )
+                  std::size_t      dataSize,
+                  uint32_t         mipLevels,
+                  uint32_t         dataLevels,
+                  uint32_t         arrayLayers )
 {
-    this->device      = device;
-    this->queue       = queue;
-    this->commandPool = commandPool;
-    this->width       = width;
-    this->height      = height;
-    this->format      = format;
-    this->type        = type;
+    this->device       = device;
+    this->upload       = upload;
+    this->uploadTicket = 0;
+    this->width        = width;
+    this->height       = height;
+    this->format       = format;
+    this->type         = type;
+    this->mipLevels    = mipLevels;
+    this->arrayLayers  = arrayLayers;
+
+    assert( dataLevels >= 1 && dataLevels <= mipLevels );
+    assert( ( mipLevels == 1 && arrayLayers == 1 ) || type == ImageType::COLOR );
+
+    bool generateMipmaps = dataLevels < mipLevels;
 
     VkImageUsageFlags  usage;
     VkImageLayout      initialLayout, finalLayout;
@@ -28,9 +39,15 @@ void Image::init( Device*          device,
     if ( this->type == ImageType::COLOR )
     {
         usage         = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-        initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+        initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         finalLayout   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         aspectFlags   = VK_IMAGE_ASPECT_COLOR_BIT;
+
+        if ( generateMipmaps )
+        {
+            // Levels are blitted from the ones above them
+            usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
     }
     else if ( this->type == ImageType::DEPTH )
     {
@@ -39,6 +56,13 @@ void Image::init( Device*          device,
         finalLayout   = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         aspectFlags   = VK_IMAGE_ASPECT_DEPTH_BIT;
     }
+    else if ( this->type == ImageType::RENDER_TARGET )
+    {
+        usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        finalLayout   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        aspectFlags   = VK_IMAGE_ASPECT_COLOR_BIT;
+    }
         
     VkImageCreateInfo imageInfo = {};
     imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -47,8 +71,8 @@ void Image::init( Device*          device,
     imageInfo.extent.width  = this->width;
     imageInfo.extent.height = this->height;
     imageInfo.extent.depth  = 1;
-    imageInfo.mipLevels     = 1;
-    imageInfo.arrayLayers   = 1;
+    imageInfo.mipLevels     = this->mipLevels;
+    imageInfo.arrayLayers   = this->arrayLayers;
     imageInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.tiling        = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.usage         = usage;
@@ -62,88 +86,43 @@ void Image::init( Device*          device,
     this->device->getImageMemoryRequirements( this->id,
                                               &memRequirements );
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize  = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType( this->device->physicalDevice,
-                                                memRequirements.memoryTypeBits,
-                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    
-    VK_CHECK_RESULT( this->device->allocateMemory( &allocInfo,
-                                                   &this->memory ) );
+    this->memory = this->device->allocator.allocate(
+        memRequirements,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        AllocationType::OPTIMAL
+        );
 
-    this->device->bindImageMemory( this->id, this->memory, 0 );
+    VK_CHECK_RESULT( this->device->bindImageMemory( this->id,
+                                                    this->memory.memory,
+                                                    this->memory.offset ) );
 
     if ( this->type == ImageType::COLOR )
     {
-        VkImage        staging       = VK_NULL_HANDLE;
-        VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
-    
-        VkImageCreateInfo stagingInfo = {};
-        stagingInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        stagingInfo.imageType     = VK_IMAGE_TYPE_2D;
-        stagingInfo.format        = this->format;
-        stagingInfo.extent.width  = this->width;
-        stagingInfo.extent.height = this->height;
-        stagingInfo.extent.depth  = 1;
-        stagingInfo.mipLevels     = 1;
-        stagingInfo.arrayLayers   = 1;
-        stagingInfo.samples       = VK_SAMPLE_COUNT_1_BIT;
-        stagingInfo.tiling        = VK_IMAGE_TILING_LINEAR;
-        stagingInfo.usage         = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-        stagingInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
-        stagingInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-
-        VK_CHECK_RESULT( this->device->createImage( &stagingInfo,
-                                                    &staging ) );
-            
-        VkMemoryRequirements stagingMemReqs;
-        this->device->getImageMemoryRequirements( staging,
-                                                  &stagingMemReqs );
-
-        VkMemoryAllocateInfo saInfo = {};
-        saInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        saInfo.allocationSize  = stagingMemReqs.size;
-        saInfo.memoryTypeIndex = FindMemoryType( this->device->physicalDevice,
-                                                 stagingMemReqs.memoryTypeBits,
-                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-
-        VK_CHECK_RESULT( this->device->allocateMemory( &saInfo,
-                                                       &stagingMemory ) );
-
-        VK_CHECK_RESULT( this->device->bindImageMemory( staging,
-                                                        stagingMemory,
-                                                        0 ) );
-
-        // Copy pixel data to staging area
-        void* stagingData;
-        VK_CHECK_RESULT( this->device->mapMemory( stagingMemory,
-                                                  0,
-                                                  (VkDeviceSize)dataSize,
-                                                  0,
-                                                  &stagingData ) );
-        std::memcpy( stagingData, data, dataSize );
-        this->device->unmapMemory( stagingMemory );
-
-        // Optimize image layouts
-        this->transitionLayout( staging,
-                                VK_IMAGE_LAYOUT_PREINITIALIZED,
-                                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                type );
         this->transitionLayout( this->id,
                                 initialLayout,
                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                type );
+                                type,
+                                this->mipLevels );
         initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 
-        // Copy image from staging area to device memory
-        this->copy( staging );
+        this->copyFromBuffer( (const uint8_t*)data, dataSize, dataLevels );
     }
 
     // Transition image to final layout
-    this->transitionLayout( this->id, initialLayout, finalLayout, type );
-    this->layout = finalLayout;
+    if ( generateMipmaps )
+    {
+        this->generateMipmaps( dataLevels );
+    }
+    else
+    {
+        this->transitionLayout( this->id,
+                                initialLayout,
+                                finalLayout,
+                                type,
+                                this->mipLevels );
+    }
+    this->layout       = finalLayout;
+    this->uploadTicket = this->upload->getTicket();
 
     // Create Image View
     this->createView( aspectFlags );
@@ -151,17 +130,24 @@ void Image::init( Device*          device,
 
 void Image::deinit()
 {
-    if ( this->view != VK_NULL_HANDLE )
+    if ( this->id != VK_NULL_HANDLE && this->upload != nullptr )
     {
-        this->device->destroyImageView( this->view );
+        this->upload->wait( this->uploadTicket );
     }
-    if ( this->memory != VK_NULL_HANDLE )
+
+    if ( this->view != VK_NULL_HANDLE )
     {
-        this->device->freeMemory( this->memory );
+        this->device->destroyImageView( this->view );
+        this->view = VK_NULL_HANDLE;
     }
     if ( this->id != VK_NULL_HANDLE )
     {
         this->device->destroyImage( this->id );
+        this->id = VK_NULL_HANDLE;
+    }
+    if ( this->device != nullptr )
+    {
+        this->device->allocator.free( this->memory );
     }
 }
 
@@ -170,13 +156,15 @@ void Image::createView( VkImageAspectFlags aspectFlags )
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image                           = this->id;
-    viewInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.viewType                        = ( this->arrayLayers > 1 )
+        ? VK_IMAGE_VIEW_TYPE_2D_ARRAY
+        : VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format                          = this->format;
     viewInfo.subresourceRange.aspectMask     = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel   = 0;
-    viewInfo.subresourceRange.levelCount     = 1;
+    viewInfo.subresourceRange.levelCount     = this->mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount     = 1;
+    viewInfo.subresourceRange.layerCount     = this->arrayLayers;
 
     VK_CHECK_RESULT( this->device->createImageView( &viewInfo,
                                                     &this->view ) );
@@ -185,13 +173,9 @@ void Image::createView( VkImageAspectFlags aspectFlags )
 void Image::transitionLayout( VkImage       image,
                               VkImageLayout oldLayout,
                               VkImageLayout newLayout,
-                              ImageType     type )
+                              ImageType     type,
+                              uint32_t      levelCount )
 {
-    CommandBuffer commandBuffer( this->device,
-                                 this->queue,
-                                 this->commandPool );
-    commandBuffer.begin( CommandBufferUsage::ONE_TIME );
-
     // Create memory barrier
     VkImageMemoryBarrier barrier = {};
     barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -200,7 +184,7 @@ void Image::transitionLayout( VkImage       image,
     barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
     barrier.image                           = image;
-    if ( type == ImageType::COLOR )
+    if ( type == ImageType::COLOR || type == ImageType::RENDER_TARGET )
     {
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     }
@@ -209,30 +193,31 @@ void Image::transitionLayout( VkImage       image,
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
     }
     barrier.subresourceRange.baseMipLevel   = 0;
-    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.levelCount     = levelCount;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount     = 1;
+    barrier.subresourceRange.layerCount     = this->arrayLayers;
     barrier.srcAccessMask                   = 0; // TODO
     barrier.dstAccessMask                   = 0; // TODO
 
-    // Create barrier masks
-    if ( oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED &&
-         newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL )
-    {
-        barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    }
-    else if ( oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED &&
-              newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL )
+    // Create barrier masks. Transitions share a command buffer with the
+    // copies around them, so the stages must order them correctly.
+    VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+    if ( oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
+         newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL )
     {
-        barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+        barrier.srcAccessMask = 0;
         barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        dstStage              = VK_PIPELINE_STAGE_TRANSFER_BIT;
     }
     else if ( oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
               newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL )
     {
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        srcStage              = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStage              = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     }
     else if ( oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
               newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL )
@@ -240,6 +225,15 @@ void Image::transitionLayout( VkImage       image,
         barrier.srcAccessMask = 0;
         barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dstStage              = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    }
+    else if ( oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
+              newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL )
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dstStage              = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     }
     else
     {
@@ -247,80 +241,279 @@ void Image::transitionLayout( VkImage       image,
         assert( 0 );
     }
 
-    commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                                   VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+    // Transfer work stays on the upload queue. Making transfer writes
+    // visible to graphics stages may move the image to another queue family,
+    // and anything else is done on the graphics queue.
+    if ( dstStage == VK_PIPELINE_STAGE_TRANSFER_BIT )
+    {
+        this->upload->getCommandBuffer().pipelineBarrier( srcStage,
+                                                          dstStage,
+                                                          0,
+                                                          0,
+                                                          nullptr,
+                                                          0,
+                                                          nullptr,
+                                                          1,
+                                                          &barrier );
+    }
+    else if ( srcStage == VK_PIPELINE_STAGE_TRANSFER_BIT )
+    {
+        this->upload->transferOwnership( image,
+                                         barrier.subresourceRange,
+                                         oldLayout,
+                                         newLayout,
+                                         barrier.dstAccessMask,
+                                         dstStage );
+    }
+    else
+    {
+        this->upload->getGraphicsCommandBuffer().pipelineBarrier( srcStage,
+                                                                  dstStage,
+                                                                  0,
+                                                                  0,
+                                                                  nullptr,
+                                                                  0,
+                                                                  nullptr,
+                                                                  1,
+                                                                  &barrier );
+    }
+}
+
+void Image::copyFromBuffer( const uint8_t* data,
+                            std::size_t    dataSize,
+                            uint32_t       levelCount )
+{
+    // Buffer offsets of a copy must be a multiple of both 4 and the texel
+    // or block size, which tightly packed levels of odd sized formats and
+    // small mips are not, so each level is placed at the next valid offset
+    VkDeviceSize blockSize = GetFormatBlockSize( this->format );
+    VkDeviceSize alignment = ( blockSize != 0 ) ? blockSize
+                                                : GetFormatTexelSize( this->format );
+    alignment = ( alignment % 4 == 0 ) ? alignment
+              : ( alignment % 2 == 0 ) ? alignment * 2
+                                       : alignment * 4;
+
+    std::vector<VkBufferImageCopy> regions( levelCount );
+    std::vector<VkDeviceSize>      sourceOffsets( levelCount );
+    std::vector<VkDeviceSize>      levelSizes( levelCount );
+    VkDeviceSize                   sourceOffset  = 0;
+    VkDeviceSize                   stagingOffset = 0;
+
+    // One region per level covering every layer, all copied by a single
+    // command
+    for ( uint32_t level = 0; level < levelCount; level++ )
+    {
+        uint32_t levelWidth  = std::max( this->width >> level, 1u );
+        uint32_t levelHeight = std::max( this->height >> level, 1u );
+
+        stagingOffset = ( stagingOffset + alignment - 1 ) / alignment * alignment;
+
+        VkBufferImageCopy& region = regions[ level ];
+        region                                 = {};
+        region.bufferOffset                    = stagingOffset;
+        region.bufferRowLength                 = 0; // Tightly packed
+        region.bufferImageHeight               = 0;
+        region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel       = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = this->arrayLayers;
+        region.imageOffset                     = { 0, 0, 0 };
+        region.imageExtent                     = { levelWidth, levelHeight, 1 };
+
+        levelSizes[ level ]    = GetImageLevelSize( this->format, levelWidth, levelHeight ) *
+                                 this->arrayLayers;
+        sourceOffsets[ level ] = sourceOffset;
+        sourceOffset  += levelSizes[ level ];
+        stagingOffset += levelSizes[ level ];
+    }
+    assert( sourceOffset <= dataSize );
+
+    VkBuffer   staging = VK_NULL_HANDLE;
+    Allocation stagingMemory;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size        = stagingOffset;
+    bufferInfo.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK_RESULT( this->device->createBuffer( &bufferInfo,
+                                                 &staging ) );
+
+    VkMemoryRequirements stagingMemReqs;
+    this->device->getBufferMemoryRequirements( staging,
+                                               &stagingMemReqs );
+
+    stagingMemory = this->device->allocator.allocate(
+        stagingMemReqs,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        AllocationType::LINEAR
+        );
+
+    VK_CHECK_RESULT( this->device->bindBufferMemory( staging,
+                                                     stagingMemory.memory,
+                                                     stagingMemory.offset ) );
+
+    for ( uint32_t level = 0; level < levelCount; level++ )
+    {
+        std::memcpy( (uint8_t*)stagingMemory.mapped + regions[ level ].bufferOffset,
+                     data + sourceOffsets[ level ],
+                     levelSizes[ level ] );
+    }
+
+    this->upload->getCommandBuffer().copyBufferToImage( staging,
+                                                        this->id,
+                                                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                        levelCount,
+                                                        regions.data() );
+
+    // Keep the staging buffer until the batch reading it has executed
+    this->upload->deferRelease( staging, stagingMemory );
+}
+
+void Image::generateMipmaps( uint32_t firstLevel )
+{
+    VkImageSubresourceRange range = {};
+    range.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel   = 0;
+    range.levelCount     = this->mipLevels;
+    range.baseArrayLayer = 0;
+    range.layerCount     = this->arrayLayers;
+
+    // Blits need a graphics queue, so the uploaded levels are handed over
+    // from the transfer queue first
+    this->upload->transferOwnership( this->id,
+                                     range,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_ACCESS_TRANSFER_READ_BIT |
+                                     VK_ACCESS_TRANSFER_WRITE_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT );
+
+    CommandBuffer& commandBuffer = this->upload->getGraphicsCommandBuffer();
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = this->id;
+    barrier.subresourceRange                = range;
+    barrier.subresourceRange.levelCount     = 1;
+
+    // Uploaded levels that are never blitted from end up in the same layout
+    // as the sources, so one barrier below covers every level but the last
+    if ( firstLevel > 1 )
+    {
+        VkImageMemoryBarrier upper = barrier;
+        upper.subresourceRange.baseMipLevel = 0;
+        upper.subresourceRange.levelCount   = firstLevel - 1;
+        upper.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        upper.newLayout                     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        upper.srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+        upper.dstAccessMask                 = VK_ACCESS_TRANSFER_READ_BIT;
+
+        commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       0,
+                                       0,
+                                       nullptr,
+                                       0,
+                                       nullptr,
+                                       1,
+                                       &upper );
+    }
+
+    for ( uint32_t level = firstLevel; level < this->mipLevels; level++ )
+    {
+        // The level above becomes the blit source
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout                     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask                 = VK_ACCESS_TRANSFER_READ_BIT;
+
+        commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       0,
+                                       0,
+                                       nullptr,
+                                       0,
+                                       nullptr,
+                                       1,
+                                       &barrier );
+
+        VkImageBlit blit = {};
+        blit.srcSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel       = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount     = this->arrayLayers;
+        blit.srcOffsets[1].x               = (int32_t)std::max( this->width >> ( level - 1 ), 1u );
+        blit.srcOffsets[1].y               = (int32_t)std::max( this->height >> ( level - 1 ), 1u );
+        blit.srcOffsets[1].z               = 1;
+        blit.dstSubresource                = blit.srcSubresource;
+        blit.dstSubresource.mipLevel       = level;
+        blit.dstOffsets[1].x               = (int32_t)std::max( this->width >> level, 1u );
+        blit.dstOffsets[1].y               = (int32_t)std::max( this->height >> level, 1u );
+        blit.dstOffsets[1].z               = 1;
+
+        commandBuffer.blitImage( this->id,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                 this->id,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 1,
+                                 &blit,
+                                 VK_FILTER_LINEAR );
+    }
+
+    // Every level but the last is now in TRANSFER_SRC
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount   = this->mipLevels - 1;
+    barrier.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout                     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask                 = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask                 = VK_ACCESS_SHADER_READ_BIT;
+
+    VkImageMemoryBarrier lastLevel = barrier;
+    lastLevel.subresourceRange.baseMipLevel = this->mipLevels - 1;
+    lastLevel.subresourceRange.levelCount   = 1;
+    lastLevel.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    lastLevel.srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    VkImageMemoryBarrier barriers[2] = { barrier, lastLevel };
+
+    commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                                    0,
                                    0,
                                    nullptr,
                                    0,
                                    nullptr,
-                                   1,
-                                   &barrier );
-
-    commandBuffer.end();
-
-    // Submit CommandBuffer
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &commandBuffer.id;
+                                   2,
+                                   barriers );
+}
 
-    this->device->queueWaitIdle( queue );
-    VK_CHECK_RESULT( this->device->queueSubmit( this->queue,
-                                                1,
-                                                &submitInfo,
-                                                VK_NULL_HANDLE ) );
-    this->device->queueWaitIdle( queue );
+uint32_t Image::getMipLevels() const
+{
+    return this->mipLevels;
+}
 
-    //commandBuffer.deinit();
+uint32_t Image::getArrayLayers() const
+{
+    return this->arrayLayers;
 }
 
-void Image::copy( VkImage src )
+bool Image::SupportsMipmapBlits( Device* device, VkFormat format )
 {
-    CommandBuffer commandBuffer( this->device, this->queue, this->commandPool );
-    commandBuffer.begin( CommandBufferUsage::ONE_TIME );
-
-    VkImageSubresourceLayers subResource = {};
-    subResource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-    subResource.baseArrayLayer = 0;
-    subResource.mipLevel       = 0;
-    subResource.layerCount     = 1;
-
-    VkImageCopy region = {};
-    region.srcSubresource = subResource;
-    region.dstSubresource = subResource;
-    region.srcOffset      = {0, 0, 0};
-    region.dstOffset      = {0, 0, 0};
-    region.extent.width   = this->width;
-    region.extent.height  = this->height;
-    region.extent.depth   = 1;
-
-    commandBuffer.copyImage( src,
-                             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                             this->id,
-                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                             1,
-                             &region );
-
-    commandBuffer.end();
-
-    // Submit CommandBuffer
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &commandBuffer.id;
-
-    this->device->queueWaitIdle( queue );
-    VK_CHECK_RESULT( this->device->queueSubmit( this->queue,
-                                                1,
-                                                &submitInfo,
-                                                VK_NULL_HANDLE ) );
-    this->device->queueWaitIdle( queue );
-
-    //commandBuffer.deinit();
+    return IsFormatSupported( device->physicalDevice,
+                              format,
+                              VK_IMAGE_TILING_OPTIMAL,
+                              VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                              VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT );
 }
 
-void Sampler::init( Device* device )
+void Sampler::init( Device* device, uint32_t mipLevels )
 {
     this->device = device;
 
@@ -340,7 +533,7 @@ void Sampler::init( Device* device )
     samplerInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias              = 0.0f;
     samplerInfo.minLod                  = 0.0f;
-    samplerInfo.maxLod                  = 0.0f;
+    samplerInfo.maxLod                  = (float)( mipLevels - 1 );
 
     VK_CHECK_RESULT( this->device->createSampler( &samplerInfo,
                                                   &this->id ) );
@@ -351,5 +544,6 @@ void Sampler::deinit(  )
     if ( this->id != VK_NULL_HANDLE )
     {
         this->device->destroySampler( this->id );
+        this->id = VK_NULL_HANDLE;
     }
 }
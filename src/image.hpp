@@ -2,15 +2,18 @@
 
 #include <vulkan/vulkan.h>
 
+#include "common.hpp"
 #include "utils.hpp"
 #include "device.hpp"
 #include "commandbuffer.hpp"
 
 class CommandPool;
+class UploadContext;
 
 enum ImageType {
     COLOR,
-    DEPTH
+    DEPTH,
+    RENDER_TARGET
 };
 
 class Image 
@@ -19,29 +22,33 @@ class Image
     
 public:
 
-    VkImage        id     = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
-    VkImageView    view   = VK_NULL_HANDLE;
-
-    Image( Device*      device,
-           VkQueue      queue,
-           CommandPool* commandPool,
-           uint32_t     width,
-           uint32_t     height,
-           VkFormat     format,
-           ImageType    type,
-           void*        data     = nullptr,
-           std::size_t  dataSize = 0 )
+    VkImage     id   = VK_NULL_HANDLE;
+    Allocation  memory;
+    VkImageView view = VK_NULL_HANDLE;
+
+    Image( Device*        device,
+           UploadContext* upload,
+           uint32_t       width,
+           uint32_t       height,
+           VkFormat       format,
+           ImageType      type,
+           void*          data       = nullptr,
+           std::size_t    dataSize    = 0,
+           uint32_t       mipLevels   = 1,
+           uint32_t       dataLevels  = 1,
+           uint32_t       arrayLayers = 1 )
     {
         this->init( device,
-                    queue,
-                    commandPool,
+                    upload,
                     width,
                     height,
                     format,
                     type,
                     data,
-                    dataSize );
+                    dataSize,
+                    mipLevels,
+                    dataLevels,
+                    arrayLayers );
     }
 
     Image() {}
@@ -51,37 +58,65 @@ public:
         this->deinit();
     }
 
-    void init( Device*      device,
-               VkQueue      queue,
-               CommandPool* commandPool,
-               uint32_t     width,
-               uint32_t     height,
-               VkFormat     format,
-               ImageType    type,
-               void*        data     = nullptr,
-               std::size_t  dataSize = 0 );
+    // Layout transitions and pixel uploads are recorded into the upload
+    // context and take effect once its current batch is submitted.
+    //
+    // data holds the first dataLevels of mipLevels levels, tightly packed,
+    // largest first, with every array layer of a level stored together.
+    // Levels past those are generated by blitting, which requires
+    // SupportsMipmapBlits( format ). Images with several layers are viewed
+    // as 2D arrays.
+    void init( Device*        device,
+               UploadContext* upload,
+               uint32_t       width,
+               uint32_t       height,
+               VkFormat       format,
+               ImageType      type,
+               void*          data        = nullptr,
+               std::size_t    dataSize    = 0,
+               uint32_t       mipLevels   = 1,
+               uint32_t       dataLevels  = 1,
+               uint32_t       arrayLayers = 1 );
 
     void deinit();
 
+    uint32_t getMipLevels() const;
+
+    uint32_t getArrayLayers() const;
+
+    // True when the device can filter format while blitting between levels.
+    static bool SupportsMipmapBlits( Device* device, VkFormat format );
+
 private:
 
-    Device*        device      = nullptr;
-    VkQueue        queue       = VK_NULL_HANDLE;
-    CommandPool*   commandPool = nullptr;
+    Device*        device       = nullptr;
+    UploadContext* upload       = nullptr;
+    UploadTicket   uploadTicket = 0;
     uint32_t       width;
     uint32_t       height;
     VkFormat       format;
     ImageType      type;
     VkImageLayout  layout;
+    uint32_t       mipLevels    = 1;
+    uint32_t       arrayLayers  = 1;
 
     void createView( VkImageAspectFlags aspectFlags );
 
     void transitionLayout( VkImage       image,
                            VkImageLayout oldLayout,
                            VkImageLayout newLayout,
-                           ImageType     type );
-
-    void copy( VkImage src );
+                           ImageType     type,
+                           uint32_t      levelCount = 1 );
+
+    // Uploads the first levelCount levels, laid out as described for init,
+    // with one staging buffer and a single copy command.
+    void copyFromBuffer( const uint8_t* data,
+                         std::size_t    dataSize,
+                         uint32_t       levelCount );
+
+    // Fills levels firstLevel and up by blitting from the level above, then
+    // moves every level to the shader read layout.
+    void generateMipmaps( uint32_t firstLevel );
 };
 
 class Sampler
@@ -92,14 +127,15 @@ public:
 
     Sampler() {}
 
-    Sampler( Device* device )
+    Sampler( Device* device, uint32_t mipLevels = 1 )
     {
-        this->init( device );
+        this->init( device, mipLevels );
     }
 
     ~Sampler() { this->deinit(); }
 
-    void init( Device* device );
+    // Allows sampling from every level of an image with mipLevels levels.
+    void init( Device* device, uint32_t mipLevels = 1 );
 
     void deinit();
 
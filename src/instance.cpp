@@ -40,6 +40,7 @@ void Instance::deinit()
     if ( this->id != VK_NULL_HANDLE )
     {
         vkDestroyInstance( this->id, nullptr );
+        this->id = VK_NULL_HANDLE;
     }
 }
 
@@ -186,6 +186,7 @@ private:
 
 struct PhysicalDeviceLimits
 {
+    friend class Device;
     friend class PhysicalDeviceInfo;
     
 public:
@@ -1,12 +1,175 @@
+#include <cstdlib>
+#include <cstring>
+
 #include "application.hpp"
+#include "meshcache.hpp"
+
+static void PrintUsage( const char* program )
+{
+    std::cerr << "Usage: " << program
+              << " [--headless] [--frames N] [--frames-in-flight N]"
+              << " [--no-transfer-queue] [--no-mesh-cache] [--optimize-mesh]"
+              << " [--no-pipeline-cache] [--instances N] [--no-gpu-culling]"
+              << " [--draw-batches N]"
+              << " [--position-format float|snorm16|half]"
+              << " [--texcoord-format float|unorm16|half]"
+              << std::endl
+              << "       " << program << " --build-mesh-cache [--optimize-mesh]"
+              << " [--position-format F] [--texcoord-format F]"
+              << std::endl
+              << "       " << program << " --bench-weld [INDICES]"
+              << std::endl
+              << "       " << program << " --bench-instances [FRAMES]"
+              << std::endl;
+}
 
 int main( int argc, char** argv )
 {
+    ApplicationOptions options;
+    bool               buildMeshCache = false;
+
+    if ( argc >= 2 && strcmp( argv[1], "--bench-weld" ) == 0 )
+    {
+        std::size_t indexCount = ( argc >= 3 )
+            ? (std::size_t)strtoull( argv[2], nullptr, 10 )
+            : 6000000;
+
+        RunWeldBenchmark( indexCount, std::cout );
+        return EXIT_SUCCESS;
+    }
+
+    // Headless frame times with growing numbers of instances, each drawn
+    // with a single instanced draw
+    if ( argc >= 2 && strcmp( argv[1], "--bench-instances" ) == 0 )
+    {
+        static const uint32_t INSTANCE_COUNTS[] = { 1000, 10000, 100000 };
+
+        options.headless = true;
+        options.frames   = ( argc >= 3 )
+            ? (uint32_t)strtoul( argv[2], nullptr, 10 )
+            : 300;
+
+        for ( uint32_t instances : INSTANCE_COUNTS )
+        {
+            options.instances = instances;
+
+            VulkanApplication app;
+
+            try
+            {
+                app.run( WIDTH, HEIGHT, options );
+            }
+            catch (const std::runtime_error& e)
+            {
+                std::cerr << e.what() << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[i], "--headless" ) == 0 )
+        {
+            options.headless = true;
+        }
+        else if ( strcmp( argv[i], "--no-transfer-queue" ) == 0 )
+        {
+            options.transferQueue = false;
+        }
+        else if ( strcmp( argv[i], "--no-mesh-cache" ) == 0 )
+        {
+            options.meshCache = false;
+        }
+        else if ( strcmp( argv[i], "--no-pipeline-cache" ) == 0 )
+        {
+            options.pipelineCache = false;
+        }
+        else if ( strcmp( argv[i], "--no-gpu-culling" ) == 0 )
+        {
+            options.gpuCulling = false;
+        }
+        else if ( strcmp( argv[i], "--optimize-mesh" ) == 0 )
+        {
+            options.optimizeMesh = true;
+        }
+        else if ( strcmp( argv[i], "--build-mesh-cache" ) == 0 )
+        {
+            buildMeshCache = true;
+        }
+        else if ( strcmp( argv[i], "--position-format" ) == 0 && i + 1 < argc &&
+                  ParsePositionFormat( argv[i + 1],
+                                       &options.vertexLayout.position ) )
+        {
+            i++;
+        }
+        else if ( strcmp( argv[i], "--texcoord-format" ) == 0 && i + 1 < argc &&
+                  ParseTexCoordFormat( argv[i + 1],
+                                       &options.vertexLayout.texCoord ) )
+        {
+            i++;
+        }
+        else if ( strcmp( argv[i], "--frames" ) == 0 && i + 1 < argc )
+        {
+            options.frames = (uint32_t)strtoul( argv[++i], nullptr, 10 );
+        }
+        else if ( strcmp( argv[i], "--frames-in-flight" ) == 0 && i + 1 < argc )
+        {
+            options.framesInFlight = (uint32_t)strtoul( argv[++i], nullptr, 10 );
+        }
+        else if ( strcmp( argv[i], "--instances" ) == 0 && i + 1 < argc )
+        {
+            options.instances = (uint32_t)strtoul( argv[++i], nullptr, 10 );
+        }
+        else if ( strcmp( argv[i], "--draw-batches" ) == 0 && i + 1 < argc )
+        {
+            options.drawBatches = (uint32_t)strtoul( argv[++i], nullptr, 10 );
+        }
+        else
+        {
+            PrintUsage( argv[0] );
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Preprocess the model offline without starting Vulkan
+    if ( buildMeshCache )
+    {
+        ModelOptions modelOptions;
+        modelOptions.optimize = options.optimizeMesh;
+        modelOptions.layout   = options.vertexLayout;
+
+        ThreadPool pool( 0 );
+        if ( !BuildMeshCache( MODEL_PATH, &pool, modelOptions ) )
+        {
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Wrote " << GetMeshCachePath( MODEL_PATH ) << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    // Without a window there is nothing to close, so bound the run.
+    if ( options.headless && options.frames == 0 )
+    {
+        std::cerr << "--headless requires --frames N" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Culling draws whatever is visible with one indirect draw
+    if ( options.drawBatches > 1 && options.gpuCulling )
+    {
+        std::cerr << "--draw-batches requires --no-gpu-culling" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     VulkanApplication app;
 
     try
     {
-        app.run( WIDTH, HEIGHT );
+        app.run( WIDTH, HEIGHT, options );
     }
     catch (const std::runtime_error& e)
     {
@@ -16,4 +179,3 @@ int main( int argc, char** argv )
 
     return EXIT_SUCCESS;
 }
-
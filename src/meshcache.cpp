@@ -0,0 +1,134 @@
+#include <cstring>
+
+#include "common.hpp"
+#include "meshcache.hpp"
+
+// Vertex data starts on a 16 byte boundary so it can be read in place.
+static const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+static uint64_t AlignUp( uint64_t value, uint64_t alignment )
+{
+    return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+/*
+ * Mesh Cache Format
+ */
+
+std::string GetMeshCachePath( const std::string& sourceFileName )
+{
+    return sourceFileName + ".meshcache";
+}
+
+uint32_t GetIndexSize( std::size_t vertexCount )
+{
+    return ( vertexCount <= 65536 ) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+/*
+ * Mesh Cache
+ */
+
+bool MeshCache::init( const std::string&     fileName,
+                      const MeshCacheHeader& expected )
+{
+    this->deinit();
+
+    if ( !this->file.init( fileName ) ||
+         this->file.getSize() < sizeof(MeshCacheHeader) )
+    {
+        this->deinit();
+        return false;
+    }
+
+    std::memcpy( &this->header, this->file.getData(), sizeof(MeshCacheHeader) );
+
+    const MeshCacheHeader& h = this->header;
+    uint64_t fileSize = this->file.getSize();
+    bool     valid    =
+        h.magic        == MESH_CACHE_MAGIC      &&
+        h.version      == MESH_CACHE_VERSION    &&
+        h.sourceHash   == expected.sourceHash   &&
+        h.vertexStride == expected.vertexStride &&
+        h.indexSize    == GetIndexSize( h.vertexCount ) &&
+        h.flags        == expected.flags        &&
+        h.vertexFormat == expected.vertexFormat &&
+        h.vertexOffset % MESH_CACHE_ALIGNMENT == 0 &&
+        h.indexOffset  % MESH_CACHE_ALIGNMENT == 0 &&
+        h.vertexOffset <= fileSize &&
+        (uint64_t)h.vertexStride * h.vertexCount <= fileSize - h.vertexOffset &&
+        h.indexOffset  <= fileSize &&
+        (uint64_t)h.indexSize * h.indexCount <= fileSize - h.indexOffset;
+
+    if ( !valid || !this->checkIndices() )
+    {
+        this->deinit();
+        return false;
+    }
+
+    return true;
+}
+
+bool MeshCache::checkIndices() const
+{
+    const MeshCacheHeader& h = this->header;
+    const uint8_t*         indices = this->file.getData() + h.indexOffset;
+
+    // The offset is aligned, so indices can be read in place
+    for ( uint32_t i = 0; i < h.indexCount; i++ )
+    {
+        uint32_t index = ( h.indexSize == sizeof(uint16_t) )
+            ? ( (const uint16_t*)indices )[i]
+            : ( (const uint32_t*)indices )[i];
+
+        if ( index >= h.vertexCount )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MeshCache::deinit()
+{
+    this->file.deinit();
+    this->header = {};
+}
+
+const void* MeshCache::getVertices() const
+{
+    return this->file.getData() + this->header.vertexOffset;
+}
+
+const void* MeshCache::getIndices() const
+{
+    return this->file.getData() + this->header.indexOffset;
+}
+
+bool MeshCache::Write( const std::string& fileName,
+                       MeshCacheHeader    header,
+                       const void*        vertices,
+                       const void*        indices )
+{
+    uint64_t vertexBytes = (uint64_t)header.vertexStride * header.vertexCount;
+    uint64_t indexBytes  = (uint64_t)header.indexSize * header.indexCount;
+
+    header.magic        = MESH_CACHE_MAGIC;
+    header.version      = MESH_CACHE_VERSION;
+    header.vertexOffset = AlignUp( sizeof(MeshCacheHeader), MESH_CACHE_ALIGNMENT );
+    header.indexOffset  = AlignUp( header.vertexOffset + vertexBytes,
+                                   MESH_CACHE_ALIGNMENT );
+
+    static const uint8_t padding[MESH_CACHE_ALIGNMENT] = {};
+
+    // Streamed straight from the caller's data, so large meshes are never
+    // copied
+    return WriteFileAtomic( fileName, {
+        { &header,  sizeof(header) },
+        { padding,  (std::size_t)( header.vertexOffset - sizeof(header) ) },
+        { vertices, (std::size_t)vertexBytes },
+        { padding,  (std::size_t)( header.indexOffset - header.vertexOffset - vertexBytes ) },
+        { indices,  (std::size_t)indexBytes }
+    } );
+}
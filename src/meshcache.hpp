@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "utils.hpp"
+
+/*
+ * Mesh Cache Format
+ */
+
+// A preprocessed mesh stored as a fixed header followed by the vertex and
+// index data exactly as they are uploaded, so a cached mesh can be copied
+// from the mapped file into a staging buffer without any parsing.
+const uint32_t MESH_CACHE_MAGIC   = 0x4853454D; // "MESH"
+const uint32_t MESH_CACHE_VERSION = 3;
+
+// Processing applied when the cache was built. A cache is only used when
+// its flags match the requested ones.
+enum MeshCacheFlags : uint32_t
+{
+    MESH_CACHE_OPTIMIZED = 1 << 0 // Reordered for vertex cache, overdraw and fetch
+};
+
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;   // HashBytes of the file the mesh was built from
+    uint32_t vertexStride; // In bytes
+    uint32_t vertexCount;
+    uint32_t indexSize;    // Bytes per index
+    uint32_t indexCount;
+    uint32_t flags;        // MeshCacheFlags
+    uint32_t vertexFormat; // Identifies the packed vertex layout
+    uint64_t vertexOffset; // From the start of the file
+    uint64_t indexOffset;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    float    positionScale[3];  // Dequantization of packed attributes
+    float    positionOffset[3];
+    float    texCoordScale[2];
+    float    texCoordOffset[2];
+};
+
+// Cache files sit next to their source, e.g. models/chalet.obj.meshcache.
+std::string GetMeshCachePath( const std::string& sourceFileName );
+
+// Bytes per index for a mesh with vertexCount vertices.
+uint32_t GetIndexSize( std::size_t vertexCount );
+
+/*
+ * Mesh Cache
+ */
+
+class MeshCache
+{
+public:
+
+    MeshCacheHeader header = {};
+
+    MeshCache() {}
+
+    ~MeshCache() { this->deinit(); }
+
+    // Maps a cache file and validates it against the source hash, layout
+    // and flags in expected. The index size is chosen per mesh, so it must
+    // match GetIndexSize of the vertex count, and every index is checked to
+    // be in range. Returns false if the file is missing, stale or
+    // malformed, in which case the mesh should be rebuilt.
+    bool init( const std::string&     fileName,
+               const MeshCacheHeader& expected );
+
+    void deinit();
+
+    const void* getVertices() const;
+
+    const void* getIndices() const;
+
+    // Writes header, which describes the vertex and index data, followed by
+    // the data itself. The magic, version and offsets are filled in here.
+    // Writes to a temporary file and renames it over the destination so a
+    // reader never maps a partially written cache.
+    static bool Write( const std::string& fileName,
+                       MeshCacheHeader    header,
+                       const void*        vertices,
+                       const void*        indices );
+
+private:
+
+    // True if every index refers to one of the cached vertices.
+    bool checkIndices() const;
+
+    MappedFile file;
+};
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cstring>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "common.hpp"
+#include "meshopt.hpp"
+
+static const uint32_t NO_VERTEX = UINT32_MAX;
+
+namespace
+{
+    // FIFO cache simulated with per-vertex insertion times: a vertex is
+    // cached while fewer than cacheSize misses have happened since it was
+    // inserted. Advancing the clock by cacheSize flushes the cache.
+    class CacheSimulator
+    {
+    public:
+
+        CacheSimulator( std::size_t vertexCount, uint32_t cacheSize ) :
+            timestamps( vertexCount, 0 ),
+            cacheSize( cacheSize ),
+            time( cacheSize + 1 )
+        {}
+
+        // Returns 1 on a miss.
+        uint32_t access( uint32_t vertex )
+        {
+            if ( this->time - this->timestamps[ vertex ] > this->cacheSize )
+            {
+                this->timestamps[ vertex ] = this->time++;
+                return 1;
+            }
+
+            return 0;
+        }
+
+        void flush()
+        {
+            this->time += this->cacheSize + 1;
+        }
+
+    private:
+
+        std::vector<uint64_t> timestamps;
+        uint64_t              cacheSize;
+        uint64_t              time;
+    };
+
+    struct Cluster
+    {
+        uint32_t start;
+        uint32_t end;
+        float    sortKey;
+    };
+}
+
+/*
+ * Mesh Optimization
+ */
+
+VertexCacheStatistics AnalyzeVertexCache( const uint32_t* indices,
+                                          std::size_t     indexCount,
+                                          std::size_t     vertexCount,
+                                          uint32_t        cacheSize )
+{
+    VertexCacheStatistics statistics;
+
+    CacheSimulator       cache( vertexCount, cacheSize );
+    std::vector<uint8_t> referenced( vertexCount, 0 );
+    std::size_t          misses = 0;
+    std::size_t          unique = 0;
+
+    for ( std::size_t i = 0; i < indexCount; i++ )
+    {
+        misses += cache.access( indices[i] );
+
+        unique += referenced[ indices[i] ] ? 0 : 1;
+        referenced[ indices[i] ] = 1;
+    }
+
+    if ( indexCount >= 3 )
+    {
+        statistics.acmr = (float)misses / (float)( indexCount / 3 );
+    }
+    if ( unique > 0 )
+    {
+        statistics.atvr = (float)misses / (float)unique;
+    }
+
+    return statistics;
+}
+
+void OptimizeVertexCache( uint32_t*              indices,
+                          std::size_t            indexCount,
+                          std::size_t            vertexCount,
+                          uint32_t               cacheSize,
+                          std::vector<uint32_t>* clusters )
+{
+    std::size_t triangleCount = indexCount / 3;
+
+    if ( clusters != nullptr )
+    {
+        clusters->clear();
+    }
+    if ( triangleCount == 0 )
+    {
+        return;
+    }
+
+    // Triangles using each vertex, and how many of those are still unemitted
+    std::vector<uint32_t> live( vertexCount, 0 );
+    std::vector<uint32_t> offsets( vertexCount + 1, 0 );
+    std::vector<uint32_t> adjacency( triangleCount * 3 );
+
+    for ( std::size_t i = 0; i < triangleCount * 3; i++ )
+    {
+        live[ indices[i] ]++;
+    }
+    for ( std::size_t v = 0; v < vertexCount; v++ )
+    {
+        offsets[ v + 1 ] = offsets[ v ] + live[ v ];
+    }
+
+    std::vector<uint32_t> fill( offsets.begin(), offsets.end() - 1 );
+    for ( std::size_t i = 0; i < triangleCount * 3; i++ )
+    {
+        adjacency[ fill[ indices[i] ]++ ] = (uint32_t)( i / 3 );
+    }
+
+    std::vector<uint64_t> timestamps( vertexCount, 0 );
+    std::vector<uint8_t>  emitted( triangleCount, 0 );
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    uint64_t              time   = cacheSize + 1;
+    std::size_t           cursor = 0;
+
+    deadEnd.reserve( triangleCount * 3 );
+    result.reserve( triangleCount * 3 );
+
+    // Recently emitted vertices with live triangles, otherwise the next
+    // vertex in input order that still has some.
+    auto skipDeadEnd = [&]() -> uint32_t {
+        while ( !deadEnd.empty() )
+        {
+            uint32_t vertex = deadEnd.back();
+            deadEnd.pop_back();
+
+            if ( live[ vertex ] > 0 )
+            {
+                return vertex;
+            }
+        }
+
+        while ( cursor < vertexCount )
+        {
+            if ( live[ cursor ] > 0 )
+            {
+                return (uint32_t)cursor++;
+            }
+            cursor++;
+        }
+
+        return NO_VERTEX;
+    };
+
+    uint32_t fanning = skipDeadEnd();
+    if ( clusters != nullptr )
+    {
+        clusters->push_back( 0 );
+    }
+
+    while ( fanning != NO_VERTEX )
+    {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex
+        for ( uint32_t a = offsets[ fanning ]; a < offsets[ fanning + 1 ]; a++ )
+        {
+            uint32_t triangle = adjacency[ a ];
+            if ( emitted[ triangle ] )
+            {
+                continue;
+            }
+
+            for ( uint32_t k = 0; k < 3; k++ )
+            {
+                uint32_t vertex = indices[ triangle * 3 + k ];
+
+                result.push_back( vertex );
+                deadEnd.push_back( vertex );
+                candidates.push_back( vertex );
+                live[ vertex ]--;
+
+                if ( time - timestamps[ vertex ] > cacheSize )
+                {
+                    timestamps[ vertex ] = time++;
+                }
+            }
+
+            emitted[ triangle ] = 1;
+        }
+
+        // Prefer the oldest candidate that will still be cached after its
+        // remaining triangles are emitted
+        uint32_t next         = NO_VERTEX;
+        int64_t  bestPriority = -1;
+        for ( uint32_t vertex : candidates )
+        {
+            if ( live[ vertex ] == 0 )
+            {
+                continue;
+            }
+
+            int64_t priority = 0;
+            int64_t age      = (int64_t)( time - timestamps[ vertex ] );
+            if ( age + 2 * (int64_t)live[ vertex ] <= (int64_t)cacheSize )
+            {
+                priority = age;
+            }
+
+            if ( priority > bestPriority )
+            {
+                bestPriority = priority;
+                next         = vertex;
+            }
+        }
+
+        if ( next == NO_VERTEX )
+        {
+            next = skipDeadEnd();
+
+            if ( next != NO_VERTEX && clusters != nullptr &&
+                 clusters->back() != result.size() / 3 )
+            {
+                clusters->push_back( (uint32_t)( result.size() / 3 ) );
+            }
+        }
+
+        fanning = next;
+    }
+
+    std::copy( result.begin(), result.end(), indices );
+}
+
+void OptimizeOverdraw( uint32_t*                    indices,
+                       std::size_t                  indexCount,
+                       const void*                  vertices,
+                       std::size_t                  vertexCount,
+                       uint32_t                     vertexStride,
+                       const std::vector<uint32_t>& clusters,
+                       float                        threshold,
+                       uint32_t                     cacheSize )
+{
+    uint32_t triangleCount = (uint32_t)( indexCount / 3 );
+    if ( triangleCount == 0 )
+    {
+        return;
+    }
+
+    std::vector<uint32_t> hard( clusters );
+    if ( hard.empty() || hard[0] != 0 )
+    {
+        hard.insert( hard.begin(), 0 );
+    }
+    hard.push_back( triangleCount );
+
+    // Split each cluster wherever the part before the split already has an
+    // ACMR within threshold of the whole cluster's
+    CacheSimulator       cache( vertexCount, cacheSize );
+    std::vector<Cluster> soft;
+
+    for ( std::size_t h = 0; h + 1 < hard.size(); h++ )
+    {
+        uint32_t start = hard[ h ];
+        uint32_t end   = hard[ h + 1 ];
+
+        std::size_t misses = 0;
+        cache.flush();
+        for ( std::size_t i = start * 3; i < end * 3; i++ )
+        {
+            misses += cache.access( indices[i] );
+        }
+        float target = threshold * (float)misses / (float)( end - start );
+
+        Cluster cluster = { start, start, 0.0f };
+        misses = 0;
+        cache.flush();
+        for ( uint32_t triangle = start; triangle < end; triangle++ )
+        {
+            for ( uint32_t k = 0; k < 3; k++ )
+            {
+                misses += cache.access( indices[ triangle * 3 + k ] );
+            }
+
+            uint32_t size = triangle + 1 - cluster.start;
+            if ( triangle + 1 < end && (float)misses / (float)size <= target )
+            {
+                cluster.end = triangle + 1;
+                soft.push_back( cluster );
+
+                cluster.start = triangle + 1;
+                misses        = 0;
+                cache.flush();
+            }
+        }
+
+        cluster.end = end;
+        soft.push_back( cluster );
+    }
+
+    auto position = [&]( uint32_t vertex ) {
+        float xyz[3];
+        std::memcpy( xyz,
+                     (const uint8_t*)vertices + (std::size_t)vertex * vertexStride,
+                     sizeof(xyz) );
+        return glm::vec3( xyz[0], xyz[1], xyz[2] );
+    };
+
+    // Area weighted centroid of the mesh
+    glm::vec3 meshCentroid( 0.0f );
+    float     meshArea = 0.0f;
+    for ( uint32_t triangle = 0; triangle < triangleCount; triangle++ )
+    {
+        glm::vec3 a = position( indices[ triangle * 3 + 0 ] );
+        glm::vec3 b = position( indices[ triangle * 3 + 1 ] );
+        glm::vec3 c = position( indices[ triangle * 3 + 2 ] );
+        float     area = glm::length( glm::cross( b - a, c - a ) );
+
+        meshCentroid += ( a + b + c ) * ( area / 3.0f );
+        meshArea     += area;
+    }
+    meshCentroid = ( meshArea > 0.0f ) ? meshCentroid / meshArea : meshCentroid;
+
+    // Clusters facing away from the centre are likely to occlude the rest
+    for ( auto& cluster : soft )
+    {
+        glm::vec3 centroid( 0.0f );
+        glm::vec3 normal( 0.0f );
+        float     area = 0.0f;
+
+        for ( uint32_t triangle = cluster.start; triangle < cluster.end; triangle++ )
+        {
+            glm::vec3 a = position( indices[ triangle * 3 + 0 ] );
+            glm::vec3 b = position( indices[ triangle * 3 + 1 ] );
+            glm::vec3 c = position( indices[ triangle * 3 + 2 ] );
+            glm::vec3 n = glm::cross( b - a, c - a );
+            float     triangleArea = glm::length( n );
+
+            centroid += ( a + b + c ) * ( triangleArea / 3.0f );
+            normal   += n;
+            area     += triangleArea;
+        }
+
+        centroid = ( area > 0.0f ) ? centroid / area : centroid;
+
+        float length = glm::length( normal );
+        normal = ( length > 0.0f ) ? normal / length : normal;
+
+        cluster.sortKey = glm::dot( centroid - meshCentroid, normal );
+    }
+
+    std::stable_sort( soft.begin(), soft.end(),
+                      []( const Cluster& lhs, const Cluster& rhs ) {
+                          return lhs.sortKey > rhs.sortKey;
+                      } );
+
+    std::vector<uint32_t> result;
+    result.reserve( triangleCount * 3 );
+    for ( const auto& cluster : soft )
+    {
+        result.insert( result.end(),
+                       indices + cluster.start * 3,
+                       indices + cluster.end * 3 );
+    }
+
+    std::copy( result.begin(), result.end(), indices );
+}
+
+std::size_t OptimizeVertexFetch( void*       vertices,
+                                 std::size_t vertexCount,
+                                 uint32_t    vertexStride,
+                                 uint32_t*   indices,
+                                 std::size_t indexCount )
+{
+    std::vector<uint32_t> remap( vertexCount, NO_VERTEX );
+    uint32_t              next = 0;
+
+    for ( std::size_t i = 0; i < indexCount; i++ )
+    {
+        uint32_t& target = remap[ indices[i] ];
+        if ( target == NO_VERTEX )
+        {
+            target = next++;
+        }
+
+        indices[i] = target;
+    }
+
+    const uint8_t*       source = (const uint8_t*)vertices;
+    std::vector<uint8_t> reordered( (std::size_t)next * vertexStride );
+    for ( std::size_t v = 0; v < vertexCount; v++ )
+    {
+        if ( remap[v] != NO_VERTEX )
+        {
+            std::memcpy( reordered.data() + (std::size_t)remap[v] * vertexStride,
+                         source + v * vertexStride,
+                         vertexStride );
+        }
+    }
+
+    std::memcpy( vertices, reordered.data(), reordered.size() );
+
+    return next;
+}
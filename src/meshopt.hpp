@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Mesh Optimization
+ */
+
+// Size of the simulated post-transform vertex cache. Small enough that the
+// orderings also hold up on hardware with larger or non-FIFO caches.
+const uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStatistics
+{
+    float acmr = 0.0f; // Average cache miss ratio: misses per triangle
+    float atvr = 0.0f; // Average transformed vertex ratio: misses per vertex
+};
+
+// Simulates a FIFO vertex cache over an indexed triangle list.
+VertexCacheStatistics AnalyzeVertexCache( const uint32_t* indices,
+                                          std::size_t     indexCount,
+                                          std::size_t     vertexCount,
+                                          uint32_t        cacheSize = VERTEX_CACHE_SIZE );
+
+// Reorders triangles for vertex cache locality with Tipsify (Sander et al.,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+// If clusters is given it receives the first triangle of each run that
+// starts after a cache reset, for use by OptimizeOverdraw.
+void OptimizeVertexCache( uint32_t*              indices,
+                          std::size_t            indexCount,
+                          std::size_t            vertexCount,
+                          uint32_t               cacheSize = VERTEX_CACHE_SIZE,
+                          std::vector<uint32_t>* clusters  = nullptr );
+
+// Splits the cache optimized clusters further while their ACMR stays within
+// threshold of the original, then orders clusters so outward facing ones,
+// which tend to occlude the rest, are drawn first. Positions are read as
+// three floats at the start of each vertex.
+void OptimizeOverdraw( uint32_t*                    indices,
+                       std::size_t                  indexCount,
+                       const void*                  vertices,
+                       std::size_t                  vertexCount,
+                       uint32_t                     vertexStride,
+                       const std::vector<uint32_t>& clusters,
+                       float                        threshold = 1.05f,
+                       uint32_t                     cacheSize = VERTEX_CACHE_SIZE );
+
+// Moves vertices into the order the index buffer first references them and
+// rewrites the indices to match, so vertex fetch walks memory linearly.
+// Unreferenced vertices are dropped. Returns the new vertex count.
+std::size_t OptimizeVertexFetch( void*       vertices,
+                                 std::size_t vertexCount,
+                                 uint32_t    vertexStride,
+                                 uint32_t*   indices,
+                                 std::size_t indexCount );
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "common.hpp"
+#include "mipmap.hpp"
+#include "threadpool.hpp"
+
+static const uint32_t CHANNELS = 4;
+
+namespace
+{
+    // The source texels covering one destination texel. A reduction by
+    // less than 3x touches at most 4 source texels along an axis.
+    struct FilterTaps
+    {
+        uint32_t first;
+        uint32_t count;
+        float    weights[4];
+    };
+}
+
+static std::vector<FilterTaps> ComputeBoxTaps( uint32_t srcSize, uint32_t dstSize )
+{
+    std::vector<FilterTaps> taps( dstSize );
+    float                   scale = (float)srcSize / (float)dstSize;
+
+    for ( uint32_t i = 0; i < dstSize; i++ )
+    {
+        float begin = (float)i * scale;
+        float end   = (float)( i + 1 ) * scale;
+
+        uint32_t first = (uint32_t)begin;
+        uint32_t last  = std::min( (uint32_t)std::ceil( end ), srcSize );
+
+        FilterTaps& tap = taps[i];
+        tap.first = first;
+        tap.count = std::min( last - first, 4u );
+
+        // Weight each source texel by how much of it the footprint covers
+        for ( uint32_t k = 0; k < tap.count; k++ )
+        {
+            float texelBegin = std::max( (float)( first + k ), begin );
+            float texelEnd   = std::min( (float)( first + k + 1 ), end );
+
+            tap.weights[k] = std::max( texelEnd - texelBegin, 0.0f ) / scale;
+        }
+    }
+
+    return taps;
+}
+
+static void DownsampleLevel( const uint8_t* src,
+                             uint32_t       srcWidth,
+                             uint32_t       srcHeight,
+                             uint8_t*       dst,
+                             uint32_t       dstWidth,
+                             uint32_t       dstHeight,
+                             ThreadPool*    pool )
+{
+    std::vector<FilterTaps> columns = ComputeBoxTaps( srcWidth, dstWidth );
+    std::vector<FilterTaps> rows    = ComputeBoxTaps( srcHeight, dstHeight );
+    std::size_t             srcRowSize = (std::size_t)srcWidth * CHANNELS;
+
+    auto filterRows = [&]( std::size_t begin, std::size_t end ) {
+        std::vector<float> accum( srcRowSize );
+
+        for ( std::size_t y = begin; y < end; y++ )
+        {
+            const FilterTaps& row = rows[y];
+
+            // Vertical pass into a whole row of floats. The inner loop is
+            // a plain multiply add over contiguous data, which vectorizes.
+            std::fill( accum.begin(), accum.end(), 0.0f );
+            for ( uint32_t k = 0; k < row.count; k++ )
+            {
+                const uint8_t* srcRow = src + ( row.first + k ) * srcRowSize;
+                float          weight = row.weights[k];
+
+                for ( std::size_t i = 0; i < srcRowSize; i++ )
+                {
+                    accum[i] += weight * (float)srcRow[i];
+                }
+            }
+
+            // Horizontal pass
+            uint8_t* dstRow = dst + y * dstWidth * CHANNELS;
+            for ( uint32_t x = 0; x < dstWidth; x++ )
+            {
+                const FilterTaps& column = columns[x];
+                float             sum[CHANNELS] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+                for ( uint32_t k = 0; k < column.count; k++ )
+                {
+                    const float* texel  = &accum[ ( column.first + k ) * CHANNELS ];
+                    float        weight = column.weights[k];
+
+                    for ( uint32_t c = 0; c < CHANNELS; c++ )
+                    {
+                        sum[c] += weight * texel[c];
+                    }
+                }
+
+                for ( uint32_t c = 0; c < CHANNELS; c++ )
+                {
+                    float value = std::min( std::max( sum[c] + 0.5f, 0.0f ), 255.0f );
+                    dstRow[ x * CHANNELS + c ] = (uint8_t)value;
+                }
+            }
+        }
+    };
+
+    if ( pool != nullptr )
+    {
+        pool->parallelFor( dstHeight, 16, filterRows );
+    }
+    else
+    {
+        filterRows( 0, dstHeight );
+    }
+}
+
+/*
+ * Mipmaps
+ */
+
+uint32_t GetMipLevelCount( uint32_t width, uint32_t height )
+{
+    uint32_t levels = 1;
+    uint32_t size   = std::max( width, height );
+
+    while ( size > 1 )
+    {
+        size >>= 1;
+        levels++;
+    }
+
+    return levels;
+}
+
+void GenerateMipChain( const uint8_t*        pixels,
+                       uint32_t              width,
+                       uint32_t              height,
+                       uint32_t              levelCount,
+                       std::vector<uint8_t>& chain,
+                       ThreadPool*           pool )
+{
+    assert( levelCount >= 1 );
+
+    std::size_t chainSize = 0;
+    for ( uint32_t level = 0; level < levelCount; level++ )
+    {
+        chainSize += (std::size_t)std::max( width >> level, 1u ) *
+            std::max( height >> level, 1u ) * CHANNELS;
+    }
+
+    chain.resize( chainSize );
+    std::memcpy( chain.data(), pixels, (std::size_t)width * height * CHANNELS );
+
+    std::size_t srcOffset = 0;
+    uint32_t    srcWidth  = width;
+    uint32_t    srcHeight = height;
+
+    for ( uint32_t level = 1; level < levelCount; level++ )
+    {
+        uint32_t    dstWidth  = std::max( srcWidth >> 1, 1u );
+        uint32_t    dstHeight = std::max( srcHeight >> 1, 1u );
+        std::size_t dstOffset = srcOffset + (std::size_t)srcWidth * srcHeight * CHANNELS;
+
+        DownsampleLevel( chain.data() + srcOffset,
+                         srcWidth,
+                         srcHeight,
+                         chain.data() + dstOffset,
+                         dstWidth,
+                         dstHeight,
+                         pool );
+
+        srcOffset = dstOffset;
+        srcWidth  = dstWidth;
+        srcHeight = dstHeight;
+    }
+}
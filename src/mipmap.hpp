@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/*
+ * Mipmaps
+ */
+
+// Levels in a full chain down to 1x1.
+uint32_t GetMipLevelCount( uint32_t width, uint32_t height );
+
+// Builds levelCount levels of an 8 bit RGBA image on the CPU, for formats
+// the device cannot blit with linear filtering. chain receives the levels
+// tightly packed, largest first, starting with a copy of pixels.
+//
+// Each level is filtered from the one above with an area weighted box
+// filter, so odd sized levels are averaged correctly. With a pool, the
+// rows of each level are filtered in parallel.
+void GenerateMipChain( const uint8_t*        pixels,
+                       uint32_t              width,
+                       uint32_t              height,
+                       uint32_t              levelCount,
+                       std::vector<uint8_t>& chain,
+                       ThreadPool*           pool = nullptr );
@@ -1,126 +1,528 @@
-#define TINYOBJLOADER_IMPLEMENTATION
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
 
 #include <vulkan/vulkan.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
+#include "common.hpp"
+#include "meshcache.hpp"
+#include "meshopt.hpp"
 #include "model.hpp"
+#include "objloader.hpp"
+#include "threadpool.hpp"
+#include "weld.hpp"
 
 /*
  * Vertex Methods
  */
 
-VkVertexInputBindingDescription Vertex::getBindingDescription()
+bool Vertex::operator==( const Vertex& other ) const
 {
-    VkVertexInputBindingDescription bindingDescription = {};
-    bindingDescription.binding   = 0;
-    bindingDescription.stride    = sizeof( Vertex );
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    return bindingDescription;
+    return this->pos == other.pos &&
+        this->texCoord == other.texCoord;
 }
 
-std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescriptions()
+/*
+ * Model Methods
+ */
+
+static bool LoadObjMesh( const std::string&     fileName,
+                         ThreadPool*            pool,
+                         std::vector<Vertex>&   vertices,
+                         std::vector<uint32_t>& indices )
 {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+    ObjMesh mesh;
+    if ( !LoadObj( fileName, pool, mesh ) )
+    {
+        return false;
+    }
+
+    // Expand every corner into a full vertex, then weld identical ones
+    std::vector<Vertex> stream( mesh.corners.size() );
+    auto expand = [&]( std::size_t begin, std::size_t end ) {
+        for ( std::size_t i = begin; i < end; i++ )
+        {
+            const ObjCorner& corner = mesh.corners[i];
+            Vertex           vertex = {};
+
+            vertex.pos = mesh.positions[ corner.position ];
+
+            if ( corner.texCoord >= 0 )
+            {
+                vertex.texCoord = {
+                    mesh.texCoords[ corner.texCoord ].x,
+                    1.0f - mesh.texCoords[ corner.texCoord ].y
+                };
+            }
+
+            stream[i] = vertex;
+        }
+    };
 
-    attributeDescriptions[0].binding  = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format   = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset   = offsetof( Vertex, pos );
+    if ( pool != nullptr )
+    {
+        pool->parallelFor( stream.size(), 65536, expand );
+    }
+    else
+    {
+        expand( 0, stream.size() );
+    }
 
-    attributeDescriptions[1].binding  = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format   = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset   = offsetof( Vertex, color );
+    mesh = ObjMesh();
 
-    attributeDescriptions[2].binding  = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format   = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset   = offsetof( Vertex, texCoord );
+    std::vector<uint32_t> firsts;
+    WeldVertices( stream.data(),
+                  sizeof(Vertex),
+                  stream.size(),
+                  indices,
+                  firsts,
+                  pool );
 
-    return attributeDescriptions;
+    vertices.resize( firsts.size() );
+    for ( std::size_t i = 0; i < firsts.size(); i++ )
+    {
+        vertices[i] = stream[ firsts[i] ];
+    }
+
+    return true;
 }
 
-bool Vertex::operator==( const Vertex& other ) const
+static void ComputeBounds( const std::vector<Vertex>& vertices,
+                           glm::vec3&                 boundsMin,
+                           glm::vec3&                 boundsMax )
 {
-    return this->pos == other.pos &&
-        this->color == other.color &&
-        this->texCoord == other.texCoord;
-}
+    boundsMin = glm::vec3( 0.0f );
+    boundsMax = glm::vec3( 0.0f );
 
-/*
- * Model Methods
- */
+    if ( vertices.empty() )
+    {
+        return;
+    }
+
+    boundsMin = vertices[0].pos;
+    boundsMax = vertices[0].pos;
 
-void Model::init( Device*          device,
-                  VkQueue          queue,
-                  CommandPool*     commandPool,
-                  std::string      fileName )
+    for ( const auto& vertex : vertices )
+    {
+        boundsMin = glm::min( boundsMin, vertex.pos );
+        boundsMax = glm::max( boundsMax, vertex.pos );
+    }
+}
+
+static void OptimizeMesh( std::vector<Vertex>&   vertices,
+                          std::vector<uint32_t>& indices )
 {
-    tinyobj::attrib_t                attrib;
-    std::vector<tinyobj::shape_t>    shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string                      err;
+    // OptimizeOverdraw reads positions from the start of each vertex
+    assert( offsetof( Vertex, pos ) == 0 );
+
+    VertexCacheStatistics before = AnalyzeVertexCache( indices.data(),
+                                                       indices.size(),
+                                                       vertices.size() );
+
+    std::vector<uint32_t> clusters;
+    OptimizeVertexCache( indices.data(),
+                         indices.size(),
+                         vertices.size(),
+                         VERTEX_CACHE_SIZE,
+                         &clusters );
+    OptimizeOverdraw( indices.data(),
+                      indices.size(),
+                      vertices.data(),
+                      vertices.size(),
+                      sizeof(Vertex),
+                      clusters );
+    vertices.resize( OptimizeVertexFetch( vertices.data(),
+                                          vertices.size(),
+                                          sizeof(Vertex),
+                                          indices.data(),
+                                          indices.size() ) );
+
+    VertexCacheStatistics after = AnalyzeVertexCache( indices.data(),
+                                                      indices.size(),
+                                                      vertices.size() );
+
+    std::cout << std::fixed << std::setprecision( 3 )
+              << "Optimized mesh: ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr
+              << std::endl;
+}
 
-    assert( tinyobj::LoadObj( &attrib,
-                              &shapes,
-                              &materials,
-                              &err,
-                              fileName.c_str() ) );
+// Converts vertices to the packed layout. Quantized attributes are stored
+// relative to their bounds, which dequantization maps back.
+static std::vector<uint8_t> PackVertices( const std::vector<Vertex>& vertices,
+                                          const VertexLayout&        layout,
+                                          const glm::vec3&           boundsMin,
+                                          const glm::vec3&           boundsMax,
+                                          MeshDequantization&        dequantization )
+{
+    dequantization = MeshDequantization();
 
-    std::vector<Vertex>              vertices;
-    std::unordered_map<Vertex, int>  uniqueVertices = {};
-    std::vector<uint32_t>            indices;
+    glm::vec3 center = ( boundsMin + boundsMax ) * 0.5f;
+    glm::vec3 extent = glm::max( ( boundsMax - boundsMin ) * 0.5f,
+                                 glm::vec3( 1e-20f ) );
+    if ( layout.position != PositionFormat::FLOAT32 )
+    {
+        dequantization.positionScale  = glm::vec4( extent, 1.0f );
+        dequantization.positionOffset = glm::vec4( center, 0.0f );
+    }
 
-    for ( const auto& shape : shapes )
+    glm::vec2 texCoordMin( 0.0f );
+    glm::vec2 texCoordMax( 1.0f );
+    if ( !vertices.empty() )
     {
-        for ( const auto& index : shape.mesh.indices )
+        texCoordMin = texCoordMax = vertices[0].texCoord;
+        for ( const auto& vertex : vertices )
         {
-            Vertex vertex = {};
+            texCoordMin = glm::min( texCoordMin, vertex.texCoord );
+            texCoordMax = glm::max( texCoordMax, vertex.texCoord );
+        }
+    }
+    glm::vec2 texCoordRange = glm::max( texCoordMax - texCoordMin,
+                                        glm::vec2( 1e-20f ) );
+    if ( layout.texCoord == TexCoordFormat::UNORM16 )
+    {
+        dequantization.texCoordScaleOffset = glm::vec4( texCoordRange,
+                                                        texCoordMin );
+    }
 
-            vertex.pos = {
-                attrib.vertices[ 3 * index.vertex_index + 0 ],
-                attrib.vertices[ 3 * index.vertex_index + 1 ],
-                attrib.vertices[ 3 * index.vertex_index + 2 ]
-            };
+    uint32_t             stride = layout.getStride();
+    std::vector<uint8_t> packed( vertices.size() * stride );
 
-            vertex.texCoord = {
-                attrib.texcoords[ 2 * index.texcoord_index + 0 ],
-                1.0f - attrib.texcoords[ 2 * index.texcoord_index + 1 ]
-            };
+    for ( std::size_t i = 0; i < vertices.size(); i++ )
+    {
+        uint8_t*  position = packed.data() + i * stride;
+        uint8_t*  texCoord = position + layout.getPositionSize();
+        glm::vec3 pos      = vertices[i].pos;
+        glm::vec2 uv       = vertices[i].texCoord;
 
-            if ( uniqueVertices.count( vertex ) == 0 )
+        glm::vec3 normalized = glm::clamp( ( pos - center ) / extent,
+                                           glm::vec3( -1.0f ),
+                                           glm::vec3( 1.0f ) );
+        switch ( layout.position )
+        {
+        case PositionFormat::FLOAT32:
+            std::memcpy( position, &pos[0], 3 * sizeof(float) );
+            break;
+        case PositionFormat::SNORM16:
+        {
+            int16_t quantized[4] = { 0, 0, 0, 0 };
+            for ( int k = 0; k < 3; k++ )
             {
-                uniqueVertices[vertex] = vertices.size();
-                vertices.push_back( vertex );
+                quantized[k] = (int16_t)std::lround( normalized[k] * 32767.0f );
             }
+            std::memcpy( position, quantized, sizeof(quantized) );
+            break;
+        }
+        case PositionFormat::HALF:
+        {
+            uint16_t quantized[4] = { 0, 0, 0, 0 };
+            for ( int k = 0; k < 3; k++ )
+            {
+                quantized[k] = FloatToHalf( normalized[k] );
+            }
+            std::memcpy( position, quantized, sizeof(quantized) );
+            break;
+        }
+        }
+
+        switch ( layout.texCoord )
+        {
+        case TexCoordFormat::FLOAT32:
+            std::memcpy( texCoord, &uv[0], 2 * sizeof(float) );
+            break;
+        case TexCoordFormat::UNORM16:
+        {
+            glm::vec2 unit = glm::clamp( ( uv - texCoordMin ) / texCoordRange,
+                                         glm::vec2( 0.0f ),
+                                         glm::vec2( 1.0f ) );
+            uint16_t quantized[2] = {
+                (uint16_t)std::lround( unit.x * 65535.0f ),
+                (uint16_t)std::lround( unit.y * 65535.0f )
+            };
+            std::memcpy( texCoord, quantized, sizeof(quantized) );
+            break;
+        }
+        case TexCoordFormat::HALF:
+        {
+            uint16_t quantized[2] = { FloatToHalf( uv.x ), FloatToHalf( uv.y ) };
+            std::memcpy( texCoord, quantized, sizeof(quantized) );
+            break;
+        }
+        }
+    }
+
+    return packed;
+}
+
+// Narrows indices to indexSize bytes each.
+static std::vector<uint8_t> PackIndices( const std::vector<uint32_t>& indices,
+                                         uint32_t                     indexSize )
+{
+    std::vector<uint8_t> packed( indices.size() * indexSize );
 
-            indices.push_back( uniqueVertices[vertex] );
+    if ( indexSize == sizeof(uint16_t) )
+    {
+        uint16_t* narrow = (uint16_t*)packed.data();
+        for ( std::size_t i = 0; i < indices.size(); i++ )
+        {
+            narrow[i] = (uint16_t)indices[i];
         }
     }
+    else
+    {
+        std::memcpy( packed.data(), indices.data(), packed.size() );
+    }
+
+    return packed;
+}
+
+static uint32_t GetMeshCacheFlags( const ModelOptions& options )
+{
+    return options.optimize ? (uint32_t)MESH_CACHE_OPTIMIZED : 0;
+}
+
+// Parses, welds and optionally optimizes a mesh.
+static bool BuildMesh( const std::string&     fileName,
+                       ThreadPool*            pool,
+                       const ModelOptions&    options,
+                       std::vector<Vertex>&   vertices,
+                       std::vector<uint32_t>& indices,
+                       glm::vec3&             boundsMin,
+                       glm::vec3&             boundsMax )
+{
+    if ( !LoadObjMesh( fileName, pool, vertices, indices ) )
+    {
+        return false;
+    }
+
+    if ( options.optimize )
+    {
+        OptimizeMesh( vertices, indices );
+    }
+
+    ComputeBounds( vertices, boundsMin, boundsMax );
+
+    return true;
+}
+
+// The parts of a mesh cache header that must match for the cache to be used.
+// The index size depends on the mesh, so it is checked by MeshCache itself.
+static MeshCacheHeader GetExpectedHeader( uint64_t            sourceHash,
+                                          const ModelOptions& options )
+{
+    MeshCacheHeader header = {};
+    header.sourceHash   = sourceHash;
+    header.vertexStride = options.layout.getStride();
+    header.vertexFormat = options.layout.getKey();
+    header.flags        = GetMeshCacheFlags( options );
+
+    return header;
+}
+
+static bool WriteMeshCache( const std::string&           fileName,
+                            uint64_t                     sourceHash,
+                            const ModelOptions&          options,
+                            const std::vector<uint8_t>&  packedVertices,
+                            const std::vector<uint8_t>&  packedIndices,
+                            uint32_t                     indexSize,
+                            const glm::vec3&             boundsMin,
+                            const glm::vec3&             boundsMax,
+                            const MeshDequantization&    dequantization )
+{
+    MeshCacheHeader header = GetExpectedHeader( sourceHash, options );
+    header.vertexCount = (uint32_t)( packedVertices.size() / header.vertexStride );
+    header.indexSize   = indexSize;
+    header.indexCount  = (uint32_t)( packedIndices.size() / indexSize );
+
+    for ( int k = 0; k < 3; k++ )
+    {
+        header.boundsMin[k]      = boundsMin[k];
+        header.boundsMax[k]      = boundsMax[k];
+        header.positionScale[k]  = dequantization.positionScale[k];
+        header.positionOffset[k] = dequantization.positionOffset[k];
+    }
+    for ( int k = 0; k < 2; k++ )
+    {
+        header.texCoordScale[k]  = dequantization.texCoordScaleOffset[k];
+        header.texCoordOffset[k] = dequantization.texCoordScaleOffset[k + 2];
+    }
+
+    return MeshCache::Write( GetMeshCachePath( fileName ),
+                             header,
+                             packedVertices.data(),
+                             packedIndices.data() );
+}
+
+bool BuildMeshCache( const std::string&  fileName,
+                     ThreadPool*         pool,
+                     const ModelOptions& options )
+{
+    MappedFile source;
+    if ( !source.init( fileName ) )
+    {
+        std::cerr << "Failed to open " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector<Vertex>   vertices;
+    std::vector<uint32_t> indices;
+    glm::vec3             boundsMin, boundsMax;
+    if ( !BuildMesh( fileName,
+                     pool,
+                     options,
+                     vertices,
+                     indices,
+                     boundsMin,
+                     boundsMax ) )
+    {
+        std::cerr << "Failed to load " << fileName << std::endl;
+        return false;
+    }
+
+    MeshDequantization   dequantization;
+    std::vector<uint8_t> packed = PackVertices( vertices,
+                                                options.layout,
+                                                boundsMin,
+                                                boundsMax,
+                                                dequantization );
+
+    uint32_t indexSize = GetIndexSize( vertices.size() );
+
+    return WriteMeshCache( fileName,
+                           HashBytes( source.getData(), source.getSize() ),
+                           options,
+                           packed,
+                           PackIndices( indices, indexSize ),
+                           indexSize,
+                           boundsMin,
+                           boundsMax,
+                           dequantization );
+}
+
+void Model::init( Device*             device,
+                  UploadContext*      upload,
+                  std::string         fileName,
+                  ThreadPool*         pool,
+                  const ModelOptions& options )
+{
+    const void*           vertexData  = nullptr;
+    uint32_t              vertexCount = 0;
+    const void*           indexData   = nullptr;
+    uint32_t              indexStride = sizeof(uint32_t);
+    std::vector<uint8_t>  packed;
+    std::vector<uint8_t>  packedIndices;
+    MeshCache             cache;
+
+    this->layout = options.layout;
+
+    uint64_t sourceHash = 0;
+    if ( options.useCache )
+    {
+        MappedFile source;
+        if ( source.init( fileName ) )
+        {
+            sourceHash = HashBytes( source.getData(), source.getSize() );
+        }
+    }
+
+    if ( options.useCache &&
+         cache.init( GetMeshCachePath( fileName ),
+                     GetExpectedHeader( sourceHash, options ) ) )
+    {
+        // Upload straight from the mapped cache file
+        const MeshCacheHeader& header = cache.header;
+
+        vertexData       = cache.getVertices();
+        vertexCount      = header.vertexCount;
+        indexData        = cache.getIndices();
+        indexStride      = header.indexSize;
+        this->indexCount = header.indexCount;
+        this->boundsMin  = glm::vec3( header.boundsMin[0],
+                                      header.boundsMin[1],
+                                      header.boundsMin[2] );
+        this->boundsMax  = glm::vec3( header.boundsMax[0],
+                                      header.boundsMax[1],
+                                      header.boundsMax[2] );
+
+        this->dequantization.positionScale       = glm::vec4( header.positionScale[0],
+                                                              header.positionScale[1],
+                                                              header.positionScale[2],
+                                                              1.0f );
+        this->dequantization.positionOffset      = glm::vec4( header.positionOffset[0],
+                                                              header.positionOffset[1],
+                                                              header.positionOffset[2],
+                                                              0.0f );
+        this->dequantization.texCoordScaleOffset = glm::vec4( header.texCoordScale[0],
+                                                              header.texCoordScale[1],
+                                                              header.texCoordOffset[0],
+                                                              header.texCoordOffset[1] );
+    }
+    else
+    {
+        std::vector<Vertex>   vertices;
+        std::vector<uint32_t> indices;
+        if ( !BuildMesh( fileName,
+                         pool,
+                         options,
+                         vertices,
+                         indices,
+                         this->boundsMin,
+                         this->boundsMax ) )
+        {
+            throw std::runtime_error( "Failed to load " + fileName );
+        }
+
+        packed = PackVertices( vertices,
+                               this->layout,
+                               this->boundsMin,
+                               this->boundsMax,
+                               this->dequantization );
+
+        indexStride   = GetIndexSize( vertices.size() );
+        packedIndices = PackIndices( indices, indexStride );
+
+        if ( options.useCache &&
+             !WriteMeshCache( fileName,
+                              sourceHash,
+                              options,
+                              packed,
+                              packedIndices,
+                              indexStride,
+                              this->boundsMin,
+                              this->boundsMax,
+                              this->dequantization ) )
+        {
+            std::cerr << "Failed to write mesh cache for " << fileName
+                      << std::endl;
+        }
+
+        vertexData       = packed.data();
+        vertexCount      = (uint32_t)vertices.size();
+        indexData        = packedIndices.data();
+        this->indexCount = (uint32_t)indices.size();
+    }
 
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    VkDeviceSize bufferSize = (VkDeviceSize)this->layout.getStride() * vertexCount;
     this->vertexBuffer.init( device,
-                             queue,
-                             commandPool,
+                             upload,
                              bufferSize,
                              BufferUsage::VERTEX );
-    this->vertexBuffer.copy( (void*)vertices.data(),
+    this->vertexBuffer.copy( (void*)vertexData,
                              true,
                              bufferSize );
 
-    this->indexSize = sizeof(indices[0]) * indices.size();
+    this->indexType  = ( indexStride == sizeof(uint16_t) ) ? VK_INDEX_TYPE_UINT16
+                                                           : VK_INDEX_TYPE_UINT32;
+    this->indexSize  = (std::size_t)indexStride * this->indexCount;
     this->indexBuffer.init( device,
-                            queue,
-                            commandPool,
+                            upload,
                             this->indexSize,
                             BufferUsage::INDEX );
-    this->indexBuffer.copy( (void*)indices.data(),
+    this->indexBuffer.copy( (void*)indexData,
                             true,
                             this->indexSize );
 }
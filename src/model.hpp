@@ -15,21 +15,22 @@
 
 #include "device.hpp"
 #include "buffer.hpp"
+#include "vertexformat.hpp"
+
+class ThreadPool;
+class UploadContext;
 
 /*
  * Vertex Code
  */
 
+// Full precision vertex used while loading and processing a mesh. Models
+// pack it into their VertexLayout for upload.
 struct Vertex
 {
     glm::vec3 pos;
-    glm::vec3 color;
     glm::vec2 texCoord;
 
-    static VkVertexInputBindingDescription getBindingDescription();
-
-    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
-
     bool operator==( const Vertex& other ) const;
 };
 
@@ -39,8 +40,7 @@ namespace std
     {
         size_t operator()( Vertex const& vertex ) const
         {
-            return ( ( hash<glm::vec3>()( vertex.pos ) ^
-                       ( hash<glm::vec3>()( vertex.color ) << 1 )) >> 1 ) ^
+            return ( hash<glm::vec3>()( vertex.pos ) >> 1 ) ^
                 ( hash<glm::vec2>()( vertex.texCoord ) << 1 );
         }
     };
@@ -50,30 +50,53 @@ namespace std
  * Model Code
  */
 
+struct ModelOptions
+{
+    bool         useCache = true;  // Read and write the binary mesh cache
+    bool         optimize = false; // Reorder for vertex cache, overdraw and fetch
+    VertexLayout layout;           // Packed format of the vertex buffer
+};
+
 class Model
 {
 public:
     
-    Buffer      vertexBuffer;
-    Buffer      indexBuffer;
-    std::size_t indexSize;
-
-    Model( Device*          device,
-           VkQueue          queue,
-           CommandPool*     commandPool,
-           std::string      fileName )
+    Buffer             vertexBuffer;
+    Buffer             indexBuffer;
+    std::size_t        indexSize  = 0; // In bytes
+    uint32_t           indexCount = 0;
+    VkIndexType        indexType  = VK_INDEX_TYPE_UINT32; // UINT16 when every index fits
+    glm::vec3          boundsMin;       // Object space bounding box
+    glm::vec3          boundsMax;
+    VertexLayout       layout;
+    MeshDequantization dequantization;  // Push to the vertex shader when drawing
+
+    Model( Device*             device,
+           UploadContext*      upload,
+           std::string         fileName,
+           ThreadPool*         pool    = nullptr,
+           const ModelOptions& options = ModelOptions() )
     {
-        this->init( device, queue, commandPool, fileName );
+        this->init( device, upload, fileName, pool, options );
     }
 
     Model() {}
 
     ~Model() { this->deinit(); }
 
-    void init( Device*          device,
-               VkQueue          queue,
-               CommandPool*     commandPool,
-               std::string      fileName );
+    // With useCache set, the mesh is read from its cache file when that
+    // matches the source and options, and the cache is (re)built from the
+    // OBJ otherwise. A pool, if given, is used to parse and weld in parallel.
+    void init( Device*             device,
+               UploadContext*      upload,
+               std::string         fileName,
+               ThreadPool*         pool    = nullptr,
+               const ModelOptions& options = ModelOptions() );
 
     void deinit();
 };
+
+// Parses an OBJ file and writes its mesh cache. Returns false on failure.
+bool BuildMeshCache( const std::string&  fileName,
+                     ThreadPool*         pool    = nullptr,
+                     const ModelOptions& options = ModelOptions() );
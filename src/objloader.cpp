@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <cstring>
+
+#include "common.hpp"
+#include "objloader.hpp"
+#include "threadpool.hpp"
+#include "utils.hpp"
+
+// Chunks smaller than this aren't worth handing to another thread.
+static const std::size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+static const double POWERS_OF_TEN[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool IsDigit( char c )
+{
+    return (unsigned)( c - '0' ) < 10u;
+}
+
+static inline const char* SkipSpaces( const char* text, const char* end )
+{
+    while ( text < end && ( *text == ' ' || *text == '\t' ) )
+    {
+        text++;
+    }
+
+    return text;
+}
+
+static const char* ParseInt( const char* text, const char* end, int32_t* value )
+{
+    bool negative = false;
+    if ( text < end && ( *text == '-' || *text == '+' ) )
+    {
+        negative = ( *text == '-' );
+        text++;
+    }
+
+    int32_t result = 0;
+    while ( text < end && IsDigit( *text ) )
+    {
+        result = result * 10 + ( *text - '0' );
+        text++;
+    }
+
+    *value = negative ? -result : result;
+    return text;
+}
+
+const char* ParseFloat( const char* text, const char* end, float* value )
+{
+    bool negative = false;
+    if ( text < end && ( *text == '-' || *text == '+' ) )
+    {
+        negative = ( *text == '-' );
+        text++;
+    }
+
+    // Up to 19 significant digits fit in the mantissa, far beyond float precision
+    uint64_t mantissa = 0;
+    int32_t  exponent = 0;
+    int32_t  digits   = 0;
+
+    while ( text < end && IsDigit( *text ) )
+    {
+        if ( digits < 19 )
+        {
+            mantissa = mantissa * 10 + ( *text - '0' );
+            digits  += ( mantissa != 0 ) ? 1 : 0;
+        }
+        else
+        {
+            exponent++;
+        }
+        text++;
+    }
+
+    if ( text < end && *text == '.' )
+    {
+        text++;
+        while ( text < end && IsDigit( *text ) )
+        {
+            if ( digits < 19 )
+            {
+                mantissa = mantissa * 10 + ( *text - '0' );
+                digits  += ( mantissa != 0 ) ? 1 : 0;
+                exponent--;
+            }
+            text++;
+        }
+    }
+
+    if ( text < end && ( *text == 'e' || *text == 'E' ) )
+    {
+        int32_t power = 0;
+        text = ParseInt( text + 1, end, &power );
+        exponent += power;
+    }
+
+    double result = (double)mantissa;
+    while ( exponent < -22 )
+    {
+        result   /= POWERS_OF_TEN[22];
+        exponent += 22;
+    }
+    while ( exponent > 22 )
+    {
+        result   *= POWERS_OF_TEN[22];
+        exponent -= 22;
+    }
+    result = ( exponent < 0 )
+        ? result / POWERS_OF_TEN[ -exponent ]
+        : result * POWERS_OF_TEN[ exponent ];
+
+    *value = (float)( negative ? -result : result );
+    return text;
+}
+
+/*
+ * OBJ Loading
+ */
+
+namespace
+{
+    // Everything parsed from one line aligned range of the file. Relative
+    // (negative) face indices can point into earlier chunks, so they are
+    // stored relative to the chunk's first element and listed for fixing
+    // once every chunk's size is known.
+    struct ObjChunk
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<ObjCorner> corners;
+        std::vector<uint32_t>  relativePositions; // Indices into corners
+        std::vector<uint32_t>  relativeTexCoords;
+    };
+
+    int32_t ResolveIndex( int32_t                raw,
+                          std::size_t            localCount,
+                          uint32_t               corner,
+                          std::vector<uint32_t>& relative )
+    {
+        if ( raw > 0 )
+        {
+            return raw - 1;
+        }
+        if ( raw < 0 )
+        {
+            relative.push_back( corner );
+            return (int32_t)localCount + raw;
+        }
+
+        return INT32_MIN; // 0 is never valid and fails validation
+    }
+
+    void ParseChunk( const char* text, const char* end, ObjChunk& chunk )
+    {
+        std::vector<int32_t> facePositions;
+        std::vector<int32_t> faceTexCoords;
+
+        while ( text < end )
+        {
+            const char* lineEnd = (const char*)std::memchr( text, '\n', end - text );
+            lineEnd = ( lineEnd == nullptr ) ? end : lineEnd;
+
+            const char* p = SkipSpaces( text, lineEnd );
+            text = lineEnd + 1;
+
+            if ( lineEnd - p < 2 )
+            {
+                continue;
+            }
+
+            if ( p[0] == 'v' && ( p[1] == ' ' || p[1] == '\t' ) )
+            {
+                glm::vec3 position;
+                p = ParseFloat( SkipSpaces( p + 2, lineEnd ), lineEnd, &position.x );
+                p = ParseFloat( SkipSpaces( p, lineEnd ), lineEnd, &position.y );
+                p = ParseFloat( SkipSpaces( p, lineEnd ), lineEnd, &position.z );
+                chunk.positions.push_back( position );
+            }
+            else if ( p[0] == 'v' && p[1] == 't' )
+            {
+                glm::vec2 texCoord;
+                p = ParseFloat( SkipSpaces( p + 2, lineEnd ), lineEnd, &texCoord.x );
+                p = ParseFloat( SkipSpaces( p, lineEnd ), lineEnd, &texCoord.y );
+                chunk.texCoords.push_back( texCoord );
+            }
+            else if ( p[0] == 'f' && ( p[1] == ' ' || p[1] == '\t' ) )
+            {
+                facePositions.clear();
+                faceTexCoords.clear();
+
+                p = SkipSpaces( p + 2, lineEnd );
+                while ( p < lineEnd && ( IsDigit( *p ) || *p == '-' ) )
+                {
+                    int32_t position = 0;
+                    int32_t texCoord = 0;
+                    int32_t normal   = 0;
+
+                    // v, v/vt, v//vn or v/vt/vn
+                    p = ParseInt( p, lineEnd, &position );
+                    if ( p < lineEnd && *p == '/' )
+                    {
+                        p = ParseInt( p + 1, lineEnd, &texCoord );
+                        if ( p < lineEnd && *p == '/' )
+                        {
+                            p = ParseInt( p + 1, lineEnd, &normal );
+                        }
+                    }
+
+                    facePositions.push_back( position );
+                    faceTexCoords.push_back( texCoord );
+                    p = SkipSpaces( p, lineEnd );
+                }
+
+                // Triangulate as a fan around the first corner
+                for ( std::size_t i = 2; i < facePositions.size(); i++ )
+                {
+                    std::size_t triangle[3] = { 0, i - 1, i };
+
+                    for ( std::size_t k : triangle )
+                    {
+                        uint32_t  corner = (uint32_t)chunk.corners.size();
+                        ObjCorner objCorner;
+
+                        objCorner.position = ResolveIndex( facePositions[k],
+                                                           chunk.positions.size(),
+                                                           corner,
+                                                           chunk.relativePositions );
+                        objCorner.texCoord = ( faceTexCoords[k] == 0 )
+                            ? -1
+                            : ResolveIndex( faceTexCoords[k],
+                                            chunk.texCoords.size(),
+                                            corner,
+                                            chunk.relativeTexCoords );
+
+                        chunk.corners.push_back( objCorner );
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool LoadObj( const std::string& fileName,
+              ThreadPool*        pool,
+              ObjMesh&           mesh )
+{
+    MappedFile file;
+    if ( !file.init( fileName ) )
+    {
+        return false;
+    }
+
+    const char* text = (const char*)file.getData();
+    std::size_t size = file.getSize();
+
+    // Split the file into chunks that start at the beginning of a line
+    std::size_t chunkCount = ( pool != nullptr ) ? pool->getThreadCount() * 4 : 1;
+    std::size_t maxChunks  = size / MIN_CHUNK_SIZE;
+    chunkCount = ( chunkCount > maxChunks ) ? maxChunks : chunkCount;
+    chunkCount = ( chunkCount < 1 ) ? 1 : chunkCount;
+
+    std::vector<std::size_t> boundaries( chunkCount + 1, size );
+    boundaries[0] = 0;
+    for ( std::size_t i = 1; i < chunkCount; i++ )
+    {
+        std::size_t boundary = size / chunkCount * i;
+        boundary = ( boundary < boundaries[i - 1] ) ? boundaries[i - 1] : boundary;
+
+        const char* newline = (const char*)std::memchr( text + boundary,
+                                                        '\n',
+                                                        size - boundary );
+        boundaries[i] = ( newline == nullptr ) ? size : newline - text + 1;
+    }
+
+    std::vector<ObjChunk> chunks( chunkCount );
+    auto parse = [&]( std::size_t begin, std::size_t end ) {
+        for ( std::size_t i = begin; i < end; i++ )
+        {
+            ParseChunk( text + boundaries[i], text + boundaries[i + 1], chunks[i] );
+        }
+    };
+
+    if ( pool != nullptr )
+    {
+        pool->parallelFor( chunkCount, 1, parse );
+    }
+    else
+    {
+        parse( 0, chunkCount );
+    }
+
+    // Each chunk's data lands after everything parsed before it
+    std::vector<std::size_t> positionBase( chunkCount + 1, 0 );
+    std::vector<std::size_t> texCoordBase( chunkCount + 1, 0 );
+    std::vector<std::size_t> cornerBase( chunkCount + 1, 0 );
+    for ( std::size_t i = 0; i < chunkCount; i++ )
+    {
+        positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+        texCoordBase[i + 1] = texCoordBase[i] + chunks[i].texCoords.size();
+        cornerBase[i + 1]   = cornerBase[i]   + chunks[i].corners.size();
+    }
+
+    mesh.positions.resize( positionBase[ chunkCount ] );
+    mesh.texCoords.resize( texCoordBase[ chunkCount ] );
+    mesh.corners.resize( cornerBase[ chunkCount ] );
+
+    int32_t positionCount = (int32_t)mesh.positions.size();
+    int32_t texCoordCount = (int32_t)mesh.texCoords.size();
+
+    std::vector<uint8_t> valid( chunkCount, 1 );
+    auto stitch = [&]( std::size_t begin, std::size_t end ) {
+        for ( std::size_t i = begin; i < end; i++ )
+        {
+            ObjChunk& chunk = chunks[i];
+
+            std::copy( chunk.positions.begin(),
+                       chunk.positions.end(),
+                       mesh.positions.begin() + positionBase[i] );
+            std::copy( chunk.texCoords.begin(),
+                       chunk.texCoords.end(),
+                       mesh.texCoords.begin() + texCoordBase[i] );
+
+            for ( uint32_t corner : chunk.relativePositions )
+            {
+                chunk.corners[ corner ].position += (int32_t)positionBase[i];
+            }
+            for ( uint32_t corner : chunk.relativeTexCoords )
+            {
+                chunk.corners[ corner ].texCoord += (int32_t)texCoordBase[i];
+
+                // -1 would read as "no texture coordinates" below
+                if ( chunk.corners[ corner ].texCoord < 0 )
+                {
+                    valid[i] = 0;
+                }
+            }
+
+            for ( const auto& corner : chunk.corners )
+            {
+                if ( corner.position < 0 || corner.position >= positionCount ||
+                     corner.texCoord < -1 || corner.texCoord >= texCoordCount )
+                {
+                    valid[i] = 0;
+                }
+            }
+
+            std::copy( chunk.corners.begin(),
+                       chunk.corners.end(),
+                       mesh.corners.begin() + cornerBase[i] );
+
+            // Release each chunk as soon as it is merged to keep peak memory down
+            chunk = ObjChunk();
+        }
+    };
+
+    if ( pool != nullptr )
+    {
+        pool->parallelFor( chunkCount, 1, stitch );
+    }
+    else
+    {
+        stitch( 0, chunkCount );
+    }
+
+    for ( uint8_t chunkValid : valid )
+    {
+        if ( !chunkValid )
+        {
+            std::cerr << fileName << ": face references a missing vertex"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+/*
+ * OBJ Loading
+ */
+
+// One corner of a triangle, as 0 based indices into ObjMesh's arrays.
+struct ObjCorner
+{
+    int32_t position = -1;
+    int32_t texCoord = -1; // -1 when the face has no texture coordinates
+};
+
+// Positions and texture coordinates of every object in an OBJ file, with
+// all faces triangulated as fans. Normals, groups and materials are ignored.
+struct ObjMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<ObjCorner> corners; // Three per triangle
+};
+
+// Maps the file and parses line aligned chunks of it in parallel when a
+// pool is given. Returns false if the file cannot be read or a face
+// references a vertex that does not exist.
+bool LoadObj( const std::string& fileName,
+              ThreadPool*        pool,
+              ObjMesh&           mesh );
+
+// Parses a decimal floating point number such as -1.25e-3 starting at
+// text, without locale lookups. Returns a pointer past the number.
+const char* ParseFloat( const char* text, const char* end, float* value );
@@ -0,0 +1,65 @@
+#include "common.hpp"
+
+#include "offscreen.hpp"
+
+void OffscreenTarget::init( Device*        device,
+                            UploadContext* upload,
+                            uint32_t       width,
+                            uint32_t       height,
+                            VkFormat       format )
+{
+    this->device      = device;
+    this->imageFormat = format;
+    this->extent      = { width, height };
+
+    this->color.init( device,
+                      upload,
+                      width,
+                      height,
+                      format,
+                      ImageType::RENDER_TARGET );
+}
+
+void OffscreenTarget::deinit()
+{
+    for ( auto fb : this->framebuffers )
+    {
+        this->device->destroyFramebuffer( fb );
+    }
+    this->framebuffers.clear();
+
+    this->color.deinit();
+}
+
+void OffscreenTarget::createFramebuffers( VkRenderPass renderPass,
+                                          Image*       images,
+                                          std::size_t  numImages )
+{
+    for ( auto fb : this->framebuffers )
+    {
+        this->device->destroyFramebuffer( fb );
+    }
+    this->framebuffers.resize( 1 );
+
+    // Create attachments vector for VkImageViews.
+    std::vector<VkImageView> attachments( numImages + 1 );
+    attachments[0] = this->color.view;
+    for ( std::size_t i = 0; i < numImages; i++ )
+    {
+        attachments[i+1] = images[i].view;
+    }
+
+    VkFramebufferCreateInfo framebufferCreateInfo = {};
+    framebufferCreateInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferCreateInfo.renderPass      = renderPass;
+    framebufferCreateInfo.attachmentCount = attachments.size();
+    framebufferCreateInfo.pAttachments    = attachments.data();
+    framebufferCreateInfo.width           = this->extent.width;
+    framebufferCreateInfo.height          = this->extent.height;
+    framebufferCreateInfo.layers          = 1;
+
+    VK_CHECK_RESULT( this->device->createFramebuffer(
+                         &framebufferCreateInfo,
+                         &this->framebuffers[0]
+                         ) );
+}
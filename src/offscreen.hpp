@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "device.hpp"
+#include "image.hpp"
+
+class Image;
+class UploadContext;
+
+// Color target used in place of a SwapChain when rendering without a window.
+class OffscreenTarget
+{
+public:
+
+    VkFormat                   imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    VkExtent2D                 extent;
+    Image                      color;
+    std::vector<VkFramebuffer> framebuffers;
+
+    OffscreenTarget( Device*        device,
+                     UploadContext* upload,
+                     uint32_t       width,
+                     uint32_t       height,
+                     VkFormat       format = VK_FORMAT_R8G8B8A8_UNORM )
+    {
+        this->init( device, upload, width, height, format );
+    }
+
+    OffscreenTarget() {}
+
+    ~OffscreenTarget() { this->deinit(); }
+
+    void init( Device*        device,
+               UploadContext* upload,
+               uint32_t       width,
+               uint32_t       height,
+               VkFormat       format = VK_FORMAT_R8G8B8A8_UNORM );
+
+    void deinit();
+
+    void createFramebuffers( VkRenderPass renderPass,
+                             Image*       images,
+                             std::size_t  numImages );
+
+private:
+
+    Device* device = nullptr;
+};
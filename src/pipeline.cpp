@@ -1,64 +1,93 @@
+#include "commandbuffer.hpp"
 #include "common.hpp"
 #include "device.hpp"
 #include "model.hpp"
 #include "pipeline.hpp"
+#include "utils.hpp"
 
-void GraphicsPipeline::init(
-        Device*                                        device,
-        RenderPass*                                    renderPass,
-        GraphicsShader*                                shader,
-        PipelineLayout*                                layout,
-        SwapChain*                                     swapchain,
-        VkVertexInputBindingDescription                vertexInfo,
-        std::vector<VkVertexInputAttributeDescription> attributeInfo
-        )
+/*
+ * Pipeline Description
+ */
+
+std::vector<uint8_t> PipelineDescription::getKey() const
 {
+    std::vector<uint8_t> key;
+
+    AppendKey( key, this->shader->getHash() );
+    AppendKey( key, this->layout->id );
+    AppendKey( key, this->renderPass->getCompatibilityHash() );
+    AppendKey( key, this->subpass );
+    AppendKey( key, (uint32_t)this->vertexInfo.size() );
+    for ( const auto& binding : this->vertexInfo )
+    {
+        AppendKey( key, binding );
+    }
+    AppendKey( key, (uint32_t)this->attributeInfo.size() );
+    for ( const auto& attribute : this->attributeInfo )
+    {
+        AppendKey( key, attribute );
+    }
+    AppendKey( key, this->state );
+    this->specialization.appendKey( key );
+
+    return key;
+}
+
+/*
+ * Graphics Pipeline
+ */
+
+void GraphicsPipeline::init( Device*                    device,
+                             const PipelineDescription& description,
+                             PipelineCache*             cache )
+{
+    this->deinit();
+
     this->device = device;
 
+    const PipelineState& state = description.state;
+
     VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
     vertexInputCreateInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputCreateInfo.vertexBindingDescriptionCount   = 1;
-    vertexInputCreateInfo.pVertexBindingDescriptions      = &vertexInfo;
-    vertexInputCreateInfo.vertexAttributeDescriptionCount = attributeInfo.size();
-    vertexInputCreateInfo.pVertexAttributeDescriptions    = attributeInfo.data();
+    vertexInputCreateInfo.vertexBindingDescriptionCount   = description.vertexInfo.size();
+    vertexInputCreateInfo.pVertexBindingDescriptions      = description.vertexInfo.data();
+    vertexInputCreateInfo.vertexAttributeDescriptionCount = description.attributeInfo.size();
+    vertexInputCreateInfo.pVertexAttributeDescriptions    = description.attributeInfo.data();
 
     // Specify topology of input vertices
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
     inputAssemblyCreateInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyCreateInfo.topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyCreateInfo.topology               = state.topology;
     inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-    // Create Viewport
-    VkViewport viewport = {};
-    viewport.x        = 0.0f;
-    viewport.y        = 0.0f;
-    viewport.width    = (float) swapchain->extent.width;
-    viewport.height   = (float) swapchain->extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    // Create Scissor Rectangle
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = swapchain->extent;
-
-    // Combine Viewport and Scissor Rectangle into Viewport State
+    // Viewport and scissor are set while recording, only their count is
+    // fixed here
     VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
     viewportStateCreateInfo.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports    = &viewport;
+    viewportStateCreateInfo.pViewports    = nullptr;
     viewportStateCreateInfo.scissorCount  = 1;
-    viewportStateCreateInfo.pScissors     = &scissor;
+    viewportStateCreateInfo.pScissors     = nullptr;
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+    dynamicStateCreateInfo.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.dynamicStateCount = 2;
+    dynamicStateCreateInfo.pDynamicStates    = dynamicStates;
 
     // Create Rasterizer
     VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
     rasterizerCreateInfo.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizerCreateInfo.depthClampEnable        = VK_FALSE;
     rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterizerCreateInfo.polygonMode             = VK_POLYGON_MODE_FILL;
+    rasterizerCreateInfo.polygonMode             = state.polygonMode;
     rasterizerCreateInfo.lineWidth               = 1.0f;
-    rasterizerCreateInfo.cullMode                = VK_CULL_MODE_BACK_BIT;
-    rasterizerCreateInfo.frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizerCreateInfo.cullMode                = state.cullMode;
+    rasterizerCreateInfo.frontFace               = state.frontFace;
     rasterizerCreateInfo.depthBiasEnable         = VK_FALSE;
     rasterizerCreateInfo.depthBiasConstantFactor = 0.0f;
     rasterizerCreateInfo.depthBiasClamp          = 0.0f;
@@ -67,9 +96,9 @@ void GraphicsPipeline::init(
     // Create Depth Testing
     VkPipelineDepthStencilStateCreateInfo depthStencil = {};
     depthStencil.sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable       = VK_TRUE;
-    depthStencil.depthWriteEnable      = VK_TRUE;
-    depthStencil.depthCompareOp        = VK_COMPARE_OP_LESS;
+    depthStencil.depthTestEnable       = state.depthTest;
+    depthStencil.depthWriteEnable      = state.depthWrite;
+    depthStencil.depthCompareOp        = state.depthCompareOp;
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.minDepthBounds        = 0.0f;
     depthStencil.maxDepthBounds        = 1.0f;
@@ -81,7 +110,7 @@ void GraphicsPipeline::init(
     VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
     multisamplingCreateInfo.sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisamplingCreateInfo.sampleShadingEnable   = VK_FALSE;
-    multisamplingCreateInfo.rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT;
+    multisamplingCreateInfo.rasterizationSamples  = state.samples;
     multisamplingCreateInfo.minSampleShading      = 1.0f;
     multisamplingCreateInfo.pSampleMask           = nullptr;
     multisamplingCreateInfo.alphaToCoverageEnable = VK_FALSE;
@@ -90,13 +119,13 @@ void GraphicsPipeline::init(
     // Configure Color Blending
     VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
     colorBlendAttachment.colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable         = VK_FALSE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.colorBlendOp        = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD;
+    colorBlendAttachment.blendEnable         = state.blendEnable;
+    colorBlendAttachment.srcColorBlendFactor = state.srcColorBlend;
+    colorBlendAttachment.dstColorBlendFactor = state.dstColorBlend;
+    colorBlendAttachment.colorBlendOp        = state.colorBlendOp;
+    colorBlendAttachment.srcAlphaBlendFactor = state.srcAlphaBlend;
+    colorBlendAttachment.dstAlphaBlendFactor = state.dstAlphaBlend;
+    colorBlendAttachment.alphaBlendOp        = state.alphaBlendOp;
 
     // Create Color Blending for all framebuffers
     VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
@@ -110,11 +139,25 @@ void GraphicsPipeline::init(
     colorBlendCreateInfo.blendConstants[2] = 0.0f;
     colorBlendCreateInfo.blendConstants[3] = 0.0f;
 
+    // Apply specialization constants to the shader stages
+    std::array<VkPipelineShaderStageCreateInfo, 5> stages;
+    std::array<VkSpecializationInfo, 5>            specializationInfo;
+    for ( uint32_t i = 0; i < description.shader->getNumModules(); i++ )
+    {
+        stages[i]             = description.shader->pipelineInfo[i];
+        specializationInfo[i] = description.specialization.getInfo( stages[i].stage );
+
+        if ( specializationInfo[i].mapEntryCount > 0 )
+        {
+            stages[i].pSpecializationInfo = &specializationInfo[i];
+        }
+    }
+
     // Create Graphics Pipeline
     VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
     pipelineCreateInfo.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.stageCount          = shader->getNumModules();
-    pipelineCreateInfo.pStages             = shader->pipelineInfo.data();
+    pipelineCreateInfo.stageCount          = description.shader->getNumModules();
+    pipelineCreateInfo.pStages             = stages.data();
     pipelineCreateInfo.pVertexInputState   = &vertexInputCreateInfo;
     pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
     pipelineCreateInfo.pViewportState      = &viewportStateCreateInfo;
@@ -122,14 +165,17 @@ void GraphicsPipeline::init(
     pipelineCreateInfo.pMultisampleState   = &multisamplingCreateInfo;
     pipelineCreateInfo.pDepthStencilState  = &depthStencil;
     pipelineCreateInfo.pColorBlendState    = &colorBlendCreateInfo;
-    pipelineCreateInfo.pDynamicState       = nullptr;
-    pipelineCreateInfo.layout              = layout->id;
-    pipelineCreateInfo.renderPass          = renderPass->getRenderPass();
-    pipelineCreateInfo.subpass             = 0;
+    pipelineCreateInfo.pDynamicState       = &dynamicStateCreateInfo;
+    pipelineCreateInfo.layout              = description.layout->id;
+    pipelineCreateInfo.renderPass          = description.renderPass->getRenderPass();
+    pipelineCreateInfo.subpass             = description.subpass;
     pipelineCreateInfo.basePipelineHandle  = VK_NULL_HANDLE;
     pipelineCreateInfo.basePipelineIndex   = -1;
 
-    VK_CHECK_RESULT( this->device->createGraphicsPipelines( VK_NULL_HANDLE,
+    VkPipelineCache pipelineCache = ( cache != nullptr ) ? cache->getCache()
+                                                         : VK_NULL_HANDLE;
+
+    VK_CHECK_RESULT( this->device->createGraphicsPipelines( pipelineCache,
                                                             1,
                                                             &pipelineCreateInfo,
                                                             &this->pipeline ) );
@@ -140,6 +186,7 @@ void GraphicsPipeline::deinit()
     if ( this->pipeline != VK_NULL_HANDLE )
     {
         this->device->destroyPipeline( this->pipeline );
+        this->pipeline = VK_NULL_HANDLE;
     }
 }
 
@@ -147,3 +194,219 @@ VkPipeline GraphicsPipeline::getPipeline() const
 {
     return this->pipeline;
 }
+
+/*
+ * Compute Pipeline
+ */
+
+void ComputePipeline::init( Device*                        device,
+                            ComputeShader*                 shader,
+                            PipelineLayout*                layout,
+                            const SpecializationConstants& specialization,
+                            PipelineCache*                 cache )
+{
+    this->deinit();
+
+    this->device = device;
+    this->layout = layout;
+
+    const ShaderReflection& reflection = shader->getReflection();
+    for ( uint32_t axis = 0; axis < 3; axis++ )
+    {
+        this->localSize[ axis ] = reflection.localSize[ axis ];
+    }
+
+    VkSpecializationInfo specializationInfo = specialization.getInfo(
+        VK_SHADER_STAGE_COMPUTE_BIT
+        );
+
+    VkComputePipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType        = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = shader->module;
+    pipelineCreateInfo.stage.pName  = "main";
+    pipelineCreateInfo.layout       = layout->id;
+
+    if ( specializationInfo.mapEntryCount > 0 )
+    {
+        pipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+    }
+
+    VkPipelineCache pipelineCache = ( cache != nullptr ) ? cache->getCache()
+                                                         : VK_NULL_HANDLE;
+
+    VK_CHECK_RESULT( this->device->createComputePipelines( pipelineCache,
+                                                           1,
+                                                           &pipelineCreateInfo,
+                                                           &this->pipeline ) );
+}
+
+void ComputePipeline::deinit()
+{
+    if ( this->pipeline != VK_NULL_HANDLE )
+    {
+        this->device->destroyPipeline( this->pipeline );
+        this->pipeline = VK_NULL_HANDLE;
+    }
+}
+
+VkPipeline ComputePipeline::getPipeline() const
+{
+    return this->pipeline;
+}
+
+PipelineLayout* ComputePipeline::getLayout() const
+{
+    return this->layout;
+}
+
+VkExtent3D ComputePipeline::getGroupCount( uint32_t x,
+                                           uint32_t y,
+                                           uint32_t z ) const
+{
+    VkExtent3D groups;
+    groups.width  = ( x + this->localSize[0] - 1 ) / this->localSize[0];
+    groups.height = ( y + this->localSize[1] - 1 ) / this->localSize[1];
+    groups.depth  = ( z + this->localSize[2] - 1 ) / this->localSize[2];
+
+    return groups;
+}
+
+void ComputePipeline::dispatch( CommandBuffer& commandBuffer,
+                                uint32_t       x,
+                                uint32_t       y,
+                                uint32_t       z ) const
+{
+    VkExtent3D groups = this->getGroupCount( x, y, z );
+
+    if ( groups.width > 0 && groups.height > 0 && groups.depth > 0 )
+    {
+        commandBuffer.dispatch( groups.width, groups.height, groups.depth );
+    }
+}
+
+/*
+ * Pipeline Variant Cache
+ */
+
+void PipelineVariantCache::init( Device* device, PipelineCache* cache )
+{
+    this->deinit();
+
+    this->device = device;
+    this->cache  = cache;
+}
+
+void PipelineVariantCache::deinit()
+{
+    this->variants.clear();
+}
+
+GraphicsPipeline* PipelineVariantCache::get( const PipelineDescription& description )
+{
+    std::vector<uint8_t> key  = description.getKey();
+    uint64_t             hash = HashBytes( key.data(), key.size() );
+
+    std::lock_guard<std::mutex> lock( this->mutex );
+
+    GraphicsPipeline* pipeline = this->find( hash, key );
+    if ( pipeline == nullptr )
+    {
+        Variant variant;
+        variant.key      = std::move( key );
+        variant.pipeline = std::unique_ptr<GraphicsPipeline>(
+            new GraphicsPipeline( this->device, description, this->cache )
+            );
+
+        pipeline = variant.pipeline.get();
+        this->variants.emplace( hash, std::move( variant ) );
+    }
+
+    return pipeline;
+}
+
+void PipelineVariantCache::compile(
+    const std::vector<PipelineDescription>& descriptions,
+    ThreadPool*                             pool
+    )
+{
+    std::vector<std::vector<uint8_t>> keys;
+    std::vector<uint64_t>             hashes;
+    std::vector<std::size_t>          missing;
+
+    {
+        std::lock_guard<std::mutex> lock( this->mutex );
+
+        for ( std::size_t i = 0; i < descriptions.size(); i++ )
+        {
+            std::vector<uint8_t> key  = descriptions[i].getKey();
+            uint64_t             hash = HashBytes( key.data(), key.size() );
+
+            // Skip variants already compiled and duplicates within the batch
+            bool duplicate = this->find( hash, key ) != nullptr;
+            for ( std::size_t j = 0; j < keys.size() && !duplicate; j++ )
+            {
+                duplicate = hashes[j] == hash && keys[j] == key;
+            }
+
+            if ( !duplicate )
+            {
+                keys.push_back( std::move( key ) );
+                hashes.push_back( hash );
+                missing.push_back( i );
+            }
+        }
+    }
+
+    // Pipeline caches are internally synchronized, so every worker can
+    // compile through the same one
+    std::vector<std::unique_ptr<GraphicsPipeline>> compiled( missing.size() );
+    pool->parallelFor( missing.size(), 1, [&]( std::size_t begin, std::size_t end ) {
+        for ( std::size_t i = begin; i < end; i++ )
+        {
+            compiled[i] = std::unique_ptr<GraphicsPipeline>(
+                new GraphicsPipeline( this->device,
+                                      descriptions[ missing[i] ],
+                                      this->cache )
+                );
+        }
+    } );
+
+    std::lock_guard<std::mutex> lock( this->mutex );
+
+    for ( std::size_t i = 0; i < compiled.size(); i++ )
+    {
+        // Another thread may have compiled the same variant through get()
+        if ( this->find( hashes[i], keys[i] ) != nullptr )
+        {
+            continue;
+        }
+
+        Variant variant;
+        variant.key      = std::move( keys[i] );
+        variant.pipeline = std::move( compiled[i] );
+
+        this->variants.emplace( hashes[i], std::move( variant ) );
+    }
+}
+
+std::size_t PipelineVariantCache::getCount() const
+{
+    return this->variants.size();
+}
+
+GraphicsPipeline* PipelineVariantCache::find( uint64_t                    hash,
+                                              const std::vector<uint8_t>& key )
+{
+    auto range = this->variants.equal_range( hash );
+    for ( auto it = range.first; it != range.second; ++it )
+    {
+        if ( it->second.key == key )
+        {
+            return it->second.pipeline.get();
+        }
+    }
+
+    return nullptr;
+}
@@ -1,19 +1,60 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "common.hpp"
 #include "descriptor.hpp"
 #include "device.hpp"
+#include "pipelinecache.hpp"
 #include "renderpass.hpp"
 #include "shader.hpp"
 #include "swapchain.hpp"
+#include "threadpool.hpp"
 
+class  CommandBuffer;
 class  SwapChain;
 struct PipelineLayout;
 
-struct ScreenDimensions
+// Fixed function state of a graphics pipeline. Every member is 32 bits
+// wide so the struct can be hashed as raw bytes.
+struct PipelineState
 {
-    uint32_t width;
-    uint32_t height;
+    VkPrimitiveTopology   topology       = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode         polygonMode    = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags       cullMode       = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace           frontFace      = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkSampleCountFlagBits samples        = VK_SAMPLE_COUNT_1_BIT;
+    VkBool32              depthTest      = VK_TRUE;
+    VkBool32              depthWrite     = VK_TRUE;
+    VkCompareOp           depthCompareOp = VK_COMPARE_OP_LESS;
+    VkBool32              blendEnable    = VK_FALSE;
+    VkBlendFactor         srcColorBlend  = VK_BLEND_FACTOR_SRC_ALPHA;
+    VkBlendFactor         dstColorBlend  = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    VkBlendOp             colorBlendOp   = VK_BLEND_OP_ADD;
+    VkBlendFactor         srcAlphaBlend  = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor         dstAlphaBlend  = VK_BLEND_FACTOR_ZERO;
+    VkBlendOp             alphaBlendOp   = VK_BLEND_OP_ADD;
+};
+
+// Everything a graphics pipeline is built from. The shader, layout and
+// render pass must outlive any pipeline compiled from the description.
+struct PipelineDescription
+{
+    GraphicsShader*                                shader     = nullptr;
+    PipelineLayout*                                layout     = nullptr;
+    RenderPass*                                    renderPass = nullptr;
+    uint32_t                                       subpass    = 0;
+    std::vector<VkVertexInputBindingDescription>   vertexInfo;
+    std::vector<VkVertexInputAttributeDescription> attributeInfo;
+    PipelineState                                  state;
+    SpecializationConstants                        specialization;
+
+    // Descriptions that would build interchangeable pipelines get the same
+    // key. Shaders are identified by their code and render passes by their
+    // compatibility, so recreating either does not invalidate a key.
+    std::vector<uint8_t> getKey() const;
 };
 
 class GraphicsPipeline
@@ -24,36 +65,25 @@ public:
 
     GraphicsPipeline() {}
 
-    GraphicsPipeline(
-        Device*                                        device,
-        RenderPass*                                    renderPass,
-        GraphicsShader*                                shader,
-        PipelineLayout*                                layout,
-        SwapChain*                                     swapchain,
-        VkVertexInputBindingDescription                vertexInfo,
-        std::vector<VkVertexInputAttributeDescription> attributeInfo
-        )
+    GraphicsPipeline( Device*                    device,
+                      const PipelineDescription& description,
+                      PipelineCache*             cache = nullptr )
     {
-        this->init( device,
-                    renderPass,
-                    shader,
-                    layout,
-                    swapchain,
-                    vertexInfo,
-                    attributeInfo );
+        this->init( device, description, cache );
     }
 
+    GraphicsPipeline( const GraphicsPipeline& ) = delete;
+    GraphicsPipeline& operator=( const GraphicsPipeline& ) = delete;
+
     ~GraphicsPipeline() { this->deinit(); }
 
-    void init(
-        Device*                                        device,
-        RenderPass*                                    renderPass,
-        GraphicsShader*                                shader,
-        PipelineLayout*                                layout,
-        SwapChain*                                     swapchain,
-        VkVertexInputBindingDescription                vertexInfo,
-        std::vector<VkVertexInputAttributeDescription> attributeInfo
-        );
+    // Viewport and scissor are dynamic state, so the pipeline does not
+    // depend on the size of its render target and survives a resize. They
+    // must be set before drawing. Pipelines are created through cache when
+    // one is given.
+    void init( Device*                    device,
+               const PipelineDescription& description,
+               PipelineCache*             cache = nullptr );
 
     void deinit();
 
@@ -64,3 +94,112 @@ private:
     Device*    device     = nullptr;
     VkPipeline pipeline   = VK_NULL_HANDLE;
 };
+
+class ComputePipeline
+{
+    friend class CommandBuffer;
+
+public:
+
+    ComputePipeline() {}
+
+    ComputePipeline( Device*                        device,
+                     ComputeShader*                 shader,
+                     PipelineLayout*                layout,
+                     const SpecializationConstants& specialization =
+                         SpecializationConstants(),
+                     PipelineCache*                 cache = nullptr )
+    {
+        this->init( device, shader, layout, specialization, cache );
+    }
+
+    ComputePipeline( const ComputePipeline& ) = delete;
+    ComputePipeline& operator=( const ComputePipeline& ) = delete;
+
+    ~ComputePipeline() { this->deinit(); }
+
+    // The shader may be destroyed once the pipeline is built. The layout
+    // must outlive the pipeline. Pipelines are created through cache when
+    // one is given.
+    void init( Device*                        device,
+               ComputeShader*                 shader,
+               PipelineLayout*                layout,
+               const SpecializationConstants& specialization =
+                   SpecializationConstants(),
+               PipelineCache*                 cache = nullptr );
+
+    void deinit();
+
+    VkPipeline getPipeline() const;
+
+    PipelineLayout* getLayout() const;
+
+    // Workgroups needed along each axis to cover x by y by z invocations.
+    VkExtent3D getGroupCount( uint32_t x, uint32_t y = 1, uint32_t z = 1 ) const;
+
+    // Records a dispatch covering x by y by z invocations, rounded up to
+    // whole workgroups. Shaders must ignore invocations past the end. The
+    // pipeline must be bound.
+    void dispatch( CommandBuffer& commandBuffer,
+                   uint32_t       x,
+                   uint32_t       y = 1,
+                   uint32_t       z = 1 ) const;
+
+private:
+
+    Device*         device       = nullptr;
+    VkPipeline      pipeline     = VK_NULL_HANDLE;
+    PipelineLayout* layout       = nullptr;
+    uint32_t        localSize[3] = { 1, 1, 1 };
+};
+
+// Compiled pipelines keyed by their description, so each variant is built
+// once and drawing never waits on pipeline compilation after load.
+class PipelineVariantCache
+{
+public:
+
+    PipelineVariantCache() {}
+
+    PipelineVariantCache( Device* device, PipelineCache* cache = nullptr )
+    {
+        this->init( device, cache );
+    }
+
+    PipelineVariantCache( const PipelineVariantCache& ) = delete;
+    PipelineVariantCache& operator=( const PipelineVariantCache& ) = delete;
+
+    ~PipelineVariantCache() { this->deinit(); }
+
+    // Variants are compiled through cache when one is given.
+    void init( Device* device, PipelineCache* cache = nullptr );
+
+    // Destroys every variant. The device must be idle.
+    void deinit();
+
+    // Returns the variant for description, compiling it first if needed.
+    GraphicsPipeline* get( const PipelineDescription& description );
+
+    // Compiles every description that is not cached yet, spread across the
+    // pool's workers. Must not be called from a pool thread.
+    void compile( const std::vector<PipelineDescription>& descriptions,
+                  ThreadPool*                             pool );
+
+    std::size_t getCount() const;
+
+private:
+
+    struct Variant
+    {
+        std::vector<uint8_t>              key;
+        std::unique_ptr<GraphicsPipeline> pipeline;
+    };
+
+    Device*                                    device = nullptr;
+    PipelineCache*                             cache  = nullptr;
+    std::unordered_multimap<uint64_t, Variant> variants;
+    std::mutex                                 mutex;
+
+    // Returns nullptr if the key has not been compiled. Expects mutex held.
+    GraphicsPipeline* find( uint64_t hash, const std::vector<uint8_t>& key );
+};
@@ -0,0 +1,101 @@
+#include <cstring>
+#include <vector>
+
+#include "common.hpp"
+#include "pipelinecache.hpp"
+#include "utils.hpp"
+
+// Size of the VK_PIPELINE_CACHE_HEADER_VERSION_ONE header: header size,
+// header version, vendor ID, device ID and the pipeline cache UUID.
+static const std::size_t PIPELINE_CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+/*
+ * Pipeline Cache
+ */
+
+void PipelineCache::init( Device* device, const std::string& fileName )
+{
+    this->deinit();
+
+    this->device   = device;
+    this->fileName = fileName;
+
+    vkGetPhysicalDeviceProperties( this->device->physicalDevice,
+                                   &this->properties );
+
+    // Data from another driver or device is rejected by some implementations
+    // and silently ignored by others, so only compatible data is passed on
+    MappedFile file;
+    bool       loaded = !this->fileName.empty() &&
+                        file.init( this->fileName ) &&
+                        this->isCompatible( file.getData(), file.getSize() );
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = loaded ? file.getSize() : 0;
+    cacheInfo.pInitialData    = loaded ? file.getData() : nullptr;
+
+    VK_CHECK_RESULT( this->device->createPipelineCache( &cacheInfo,
+                                                        &this->id ) );
+
+    if ( !this->fileName.empty() && !loaded )
+    {
+        std::cout << "Pipeline cache " << this->fileName
+                  << " is missing or stale, starting empty" << std::endl;
+    }
+}
+
+void PipelineCache::deinit()
+{
+    if ( this->id != VK_NULL_HANDLE )
+    {
+        if ( !this->fileName.empty() && !this->save() )
+        {
+            std::cerr << "Failed to write pipeline cache "
+                      << this->fileName << std::endl;
+        }
+
+        this->device->destroyPipelineCache( this->id );
+        this->id = VK_NULL_HANDLE;
+    }
+}
+
+bool PipelineCache::save()
+{
+    std::size_t dataSize = 0;
+    VK_CHECK_RESULT( this->device->getPipelineCacheData( this->id,
+                                                         &dataSize,
+                                                         nullptr ) );
+
+    std::vector<uint8_t> data( dataSize );
+    VK_CHECK_RESULT( this->device->getPipelineCacheData( this->id,
+                                                         &dataSize,
+                                                         data.data() ) );
+
+    return WriteFileAtomic( this->fileName, data.data(), dataSize );
+}
+
+VkPipelineCache PipelineCache::getCache() const
+{
+    return this->id;
+}
+
+bool PipelineCache::isCompatible( const uint8_t* data, std::size_t size ) const
+{
+    if ( size < PIPELINE_CACHE_HEADER_SIZE )
+    {
+        return false;
+    }
+
+    uint32_t header[4];
+    std::memcpy( header, data, sizeof(header) );
+
+    return header[0] >= PIPELINE_CACHE_HEADER_SIZE &&
+           header[0] <= size &&
+           header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header[2] == this->properties.vendorID &&
+           header[3] == this->properties.deviceID &&
+           std::memcmp( data + sizeof(header),
+                        this->properties.pipelineCacheUUID,
+                        VK_UUID_SIZE ) == 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vulkan/vulkan.h>
+
+#include "device.hpp"
+
+/*
+ * Pipeline Cache
+ */
+
+// A VkPipelineCache kept on disk between runs, so pipelines compiled once
+// are not recompiled on every launch.
+class PipelineCache
+{
+public:
+
+    PipelineCache() {}
+
+    PipelineCache( const PipelineCache& ) = delete;
+    PipelineCache& operator=( const PipelineCache& ) = delete;
+
+    ~PipelineCache() { this->deinit(); }
+
+    // Creates the cache, seeded from fileName when that file was written by
+    // the same driver and device. Anything else, including a missing file,
+    // starts an empty cache. An empty fileName keeps the cache in memory.
+    void init( Device* device, const std::string& fileName );
+
+    // Writes the cache back to its file and destroys it.
+    void deinit();
+
+    // Writes the cache data to a temporary file and renames it over the
+    // destination, so an interrupted write never leaves a truncated cache.
+    bool save();
+
+    VkPipelineCache getCache() const;
+
+private:
+
+    Device*                    device     = nullptr;
+    VkPipelineCache            id         = VK_NULL_HANDLE;
+    std::string                fileName;
+    VkPhysicalDeviceProperties properties = {};
+
+    bool isCompatible( const uint8_t* data, std::size_t size ) const;
+};
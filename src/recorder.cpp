@@ -0,0 +1,112 @@
+#include "common.hpp"
+#include "recorder.hpp"
+
+/*
+ * Parallel Recorder
+ */
+
+void ParallelRecorder::init( Device*     device,
+                             VkQueue     queue,
+                             uint32_t    queueIdx,
+                             ThreadPool* pool,
+                             uint32_t    frames,
+                             uint32_t    slotCount )
+{
+    this->deinit();
+
+    this->threads   = pool;
+    this->slotCount = ( slotCount > 0 ) ? slotCount : pool->getThreadCount() + 1;
+
+    for ( uint32_t i = 0; i < frames * this->slotCount; i++ )
+    {
+        std::unique_ptr<Slot> slot( new Slot() );
+        slot->pool.init( device, queue, queueIdx );
+        slot->commandBuffer.init( device,
+                                  queue,
+                                  &slot->pool,
+                                  CommandBufferLevel::SECONDARY );
+
+        this->slots.push_back( std::move( slot ) );
+    }
+}
+
+void ParallelRecorder::deinit()
+{
+    // Destroying a pool frees the command buffers allocated from it
+    for ( auto& slot : this->slots )
+    {
+        slot->commandBuffer.deinit();
+        slot->pool.deinit();
+    }
+    this->slots.clear();
+    this->slotCount = 0;
+}
+
+uint32_t ParallelRecorder::getSlotCount() const
+{
+    return this->slotCount;
+}
+
+void ParallelRecorder::record(
+    uint32_t                                                     frame,
+    RenderPass&                                                  renderPass,
+    uint32_t                                                     subpass,
+    VkFramebuffer                                                framebuffer,
+    std::size_t                                                  count,
+    const std::function<void(CommandBuffer&, std::size_t, std::size_t)>& fn
+    )
+{
+    assert( ( frame + 1 ) * this->slotCount <= this->slots.size() );
+
+    std::size_t first = frame * this->slotCount;
+
+    for ( uint32_t i = 0; i < this->slotCount; i++ )
+    {
+        this->slots[ first + i ]->recorded = false;
+    }
+
+    // Ranges of a single slot each, so every slot, and with it its pool,
+    // is only touched by the thread that runs its range
+    this->threads->parallelFor(
+        this->slotCount,
+        1,
+        [&]( std::size_t beginSlot, std::size_t endSlot ) {
+            for ( std::size_t i = beginSlot; i < endSlot; i++ )
+            {
+                std::size_t begin = i * count / this->slotCount;
+                std::size_t end   = ( i + 1 ) * count / this->slotCount;
+                if ( begin == end )
+                {
+                    continue;
+                }
+
+                Slot& slot = *this->slots[ first + i ];
+
+                slot.commandBuffer.reset();
+                slot.commandBuffer.begin( renderPass, subpass, framebuffer );
+
+                fn( slot.commandBuffer, begin, end );
+
+                slot.commandBuffer.end();
+                slot.recorded = true;
+            }
+        } );
+}
+
+void ParallelRecorder::execute( CommandBuffer& primary, uint32_t frame )
+{
+    assert( ( frame + 1 ) * this->slotCount <= this->slots.size() );
+
+    std::vector<CommandBuffer*> recorded;
+
+    for ( uint32_t i = 0; i < this->slotCount; i++ )
+    {
+        Slot& slot = *this->slots[ frame * this->slotCount + i ];
+        if ( slot.recorded )
+        {
+            recorded.push_back( &slot.commandBuffer );
+        }
+    }
+
+    primary.executeCommands( recorded );
+}
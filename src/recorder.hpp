@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "commandbuffer.hpp"
+#include "device.hpp"
+#include "renderpass.hpp"
+#include "threadpool.hpp"
+
+/*
+ * Parallel Recording
+ */
+
+// Records one subpass from several threads into secondary command buffers,
+// which a primary command buffer then executes in order. Each recording
+// slot has its own command pool per frame in flight, since a pool may only
+// be used by one thread at a time. With one slot per thread that records,
+// no two threads ever share a pool.
+class ParallelRecorder
+{
+public:
+
+    ParallelRecorder() {}
+
+    ParallelRecorder( const ParallelRecorder& ) = delete;
+    ParallelRecorder& operator=( const ParallelRecorder& ) = delete;
+
+    ~ParallelRecorder() { this->deinit(); }
+
+    // Pools are created for queueIdx. A slotCount of 0 gives one slot per
+    // thread of pool plus the calling thread.
+    void init( Device*     device,
+               VkQueue     queue,
+               uint32_t    queueIdx,
+               ThreadPool* pool,
+               uint32_t    frames,
+               uint32_t    slotCount = 0 );
+
+    void deinit();
+
+    uint32_t getSlotCount() const;
+
+    // Splits [0, count) into one contiguous range per slot and, across the
+    // thread pool, calls fn( commandBuffer, begin, end ) for each range
+    // with a secondary command buffer begun in subpass of renderPass. The
+    // frame's previous GPU use must have completed. Must not be called from
+    // a pool thread.
+    void record(
+        uint32_t                                                     frame,
+        RenderPass&                                                  renderPass,
+        uint32_t                                                     subpass,
+        VkFramebuffer                                                framebuffer,
+        std::size_t                                                  count,
+        const std::function<void(CommandBuffer&, std::size_t, std::size_t)>& fn
+        );
+
+    // Executes the frame's recorded buffers in range order. primary must be
+    // in a subpass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    void execute( CommandBuffer& primary, uint32_t frame );
+
+private:
+
+    struct Slot
+    {
+        CommandPool   pool;
+        CommandBuffer commandBuffer;
+        bool          recorded = false;
+    };
+
+    ThreadPool*                        threads   = nullptr;
+    uint32_t                           slotCount = 0;
+    std::vector<std::unique_ptr<Slot>> slots;    // slotCount per frame
+};
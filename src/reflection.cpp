@@ -0,0 +1,619 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "descriptor.hpp"
+#include "reflection.hpp"
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// The subset of the SPIR-V specification needed to find a module's
+// interface
+namespace
+{
+    enum Op : uint32_t
+    {
+        OP_EXECUTION_MODE     = 16,
+        OP_TYPE_BOOL          = 20,
+        OP_TYPE_INT           = 21,
+        OP_TYPE_FLOAT         = 22,
+        OP_TYPE_VECTOR        = 23,
+        OP_TYPE_MATRIX        = 24,
+        OP_TYPE_IMAGE         = 25,
+        OP_TYPE_SAMPLER       = 26,
+        OP_TYPE_SAMPLED_IMAGE = 27,
+        OP_TYPE_ARRAY         = 28,
+        OP_TYPE_RUNTIME_ARRAY = 29,
+        OP_TYPE_STRUCT        = 30,
+        OP_TYPE_POINTER       = 32,
+        OP_CONSTANT           = 43,
+        OP_VARIABLE           = 59,
+        OP_DECORATE           = 71,
+        OP_MEMBER_DECORATE    = 72
+    };
+
+    enum Decoration : uint32_t
+    {
+        DECORATION_BLOCK          = 2,
+        DECORATION_BUFFER_BLOCK   = 3,
+        DECORATION_ARRAY_STRIDE   = 6,
+        DECORATION_MATRIX_STRIDE  = 7,
+        DECORATION_BUILT_IN       = 11,
+        DECORATION_LOCATION       = 30,
+        DECORATION_BINDING        = 33,
+        DECORATION_DESCRIPTOR_SET = 34,
+        DECORATION_OFFSET         = 35
+    };
+
+    enum StorageClass : uint32_t
+    {
+        STORAGE_UNIFORM_CONSTANT = 0,
+        STORAGE_INPUT            = 1,
+        STORAGE_UNIFORM          = 2,
+        STORAGE_PUSH_CONSTANT    = 9,
+        STORAGE_STORAGE_BUFFER   = 12
+    };
+
+    const uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+
+    const uint32_t DIM_BUFFER       = 5;
+    const uint32_t DIM_SUBPASS_DATA = 6;
+
+    const uint32_t NOT_SET = UINT32_MAX;
+
+    // Everything recorded about one result id
+    struct Id
+    {
+        uint32_t              op          = 0;
+        std::vector<uint32_t> operands;   // Operands other than the result id
+        uint32_t              set         = NOT_SET;
+        uint32_t              binding     = NOT_SET;
+        uint32_t              location    = NOT_SET;
+        uint32_t              arrayStride = 0;
+        bool                  builtIn     = false;
+        bool                  block       = false;
+        bool                  bufferBlock = false;
+        std::vector<uint32_t> memberOffsets;
+        std::vector<uint32_t> memberMatrixStrides;
+    };
+
+    class Module
+    {
+    public:
+
+        std::unordered_map<uint32_t, Id> ids;
+
+        const Id* find( uint32_t id ) const
+        {
+            auto it = this->ids.find( id );
+            return ( it != this->ids.end() ) ? &it->second : nullptr;
+        }
+
+        // Strips arrays off type, multiplying their lengths into count.
+        // Runtime arrays count as one descriptor.
+        const Id* elementType( uint32_t type, uint32_t* count ) const
+        {
+            const Id* id = this->find( type );
+
+            while ( id != nullptr && ( id->op == OP_TYPE_ARRAY ||
+                                       id->op == OP_TYPE_RUNTIME_ARRAY ) )
+            {
+                if ( id->op == OP_TYPE_ARRAY )
+                {
+                    *count *= this->constant( id->operands[1] );
+                }
+                id = this->find( id->operands[0] );
+            }
+
+            return id;
+        }
+
+        uint32_t constant( uint32_t id ) const
+        {
+            const Id* value = this->find( id );
+            return ( value != nullptr && value->op == OP_CONSTANT &&
+                     value->operands.size() >= 2 ) ? value->operands[1] : 1;
+        }
+
+        // Size in bytes of a type laid out with explicit offsets and strides.
+        uint32_t size( uint32_t type, uint32_t matrixStride = 0 ) const
+        {
+            const Id* id = this->find( type );
+            if ( id == nullptr )
+            {
+                return 0;
+            }
+
+            switch ( id->op )
+            {
+            case OP_TYPE_BOOL:
+                return 4;
+            case OP_TYPE_INT:
+            case OP_TYPE_FLOAT:
+                return id->operands[0] / 8;
+            case OP_TYPE_VECTOR:
+                return this->size( id->operands[0] ) * id->operands[1];
+            case OP_TYPE_MATRIX:
+                return ( matrixStride != 0 )
+                    ? matrixStride * id->operands[1]
+                    : this->size( id->operands[0] ) * id->operands[1];
+            case OP_TYPE_ARRAY:
+                return id->arrayStride * this->constant( id->operands[1] );
+            case OP_TYPE_STRUCT:
+            {
+                uint32_t end = 0;
+                for ( std::size_t m = 0; m < id->operands.size(); m++ )
+                {
+                    uint32_t offset = ( m < id->memberOffsets.size() )
+                        ? id->memberOffsets[m] : 0;
+                    uint32_t stride = ( m < id->memberMatrixStrides.size() )
+                        ? id->memberMatrixStrides[m] : 0;
+
+                    end = std::max( end, offset + this->size( id->operands[m], stride ) );
+                }
+                return end;
+            }
+            default:
+                return 0;
+            }
+        }
+
+        // Offset of the first member of a struct, where push constants start.
+        uint32_t firstOffset( uint32_t type ) const
+        {
+            const Id* id = this->find( type );
+            if ( id == nullptr || id->memberOffsets.empty() )
+            {
+                return 0;
+            }
+
+            return *std::min_element( id->memberOffsets.begin(),
+                                      id->memberOffsets.end() );
+        }
+
+        VkFormat format( uint32_t type ) const
+        {
+            const Id* id         = this->find( type );
+            uint32_t  components = 1;
+
+            if ( id != nullptr && id->op == OP_TYPE_VECTOR )
+            {
+                components = id->operands[1];
+                id         = this->find( id->operands[0] );
+            }
+            if ( id == nullptr || components < 1 || components > 4 ||
+                 ( id->op != OP_TYPE_FLOAT && id->op != OP_TYPE_INT ) ||
+                 id->operands[0] != 32 )
+            {
+                return VK_FORMAT_UNDEFINED;
+            }
+
+            static const VkFormat floats[] = {
+                VK_FORMAT_R32_SFLOAT,
+                VK_FORMAT_R32G32_SFLOAT,
+                VK_FORMAT_R32G32B32_SFLOAT,
+                VK_FORMAT_R32G32B32A32_SFLOAT
+            };
+            static const VkFormat sints[] = {
+                VK_FORMAT_R32_SINT,
+                VK_FORMAT_R32G32_SINT,
+                VK_FORMAT_R32G32B32_SINT,
+                VK_FORMAT_R32G32B32A32_SINT
+            };
+            static const VkFormat uints[] = {
+                VK_FORMAT_R32_UINT,
+                VK_FORMAT_R32G32_UINT,
+                VK_FORMAT_R32G32B32_UINT,
+                VK_FORMAT_R32G32B32A32_UINT
+            };
+
+            if ( id->op == OP_TYPE_FLOAT )
+            {
+                return floats[ components - 1 ];
+            }
+            return ( id->operands[1] != 0 ) ? sints[ components - 1 ]
+                                            : uints[ components - 1 ];
+        }
+    };
+
+    void SetMember( std::vector<uint32_t>& members, uint32_t member, uint32_t value )
+    {
+        if ( members.size() <= member )
+        {
+            members.resize( member + 1, 0 );
+        }
+        members[ member ] = value;
+    }
+
+    bool CompareResources( const ShaderResource& lhs, const ShaderResource& rhs )
+    {
+        return ( lhs.set != rhs.set ) ? lhs.set < rhs.set
+                                      : lhs.binding < rhs.binding;
+    }
+
+    bool GetDescriptorType( const Module&   module,
+                            uint32_t        storage,
+                            const Id&       type,
+                            DescriptorType* descriptorType )
+    {
+        if ( storage == STORAGE_UNIFORM && type.op == OP_TYPE_STRUCT )
+        {
+            // Before SPIR-V 1.3 storage buffers are BufferBlock uniforms
+            *descriptorType = type.bufferBlock ? DescriptorType::STORAGE_BUFFER
+                                               : DescriptorType::UNIFORM_BUFFER;
+            return true;
+        }
+        if ( storage == STORAGE_STORAGE_BUFFER )
+        {
+            *descriptorType = DescriptorType::STORAGE_BUFFER;
+            return true;
+        }
+        if ( storage != STORAGE_UNIFORM_CONSTANT )
+        {
+            return false;
+        }
+
+        switch ( type.op )
+        {
+        case OP_TYPE_SAMPLER:
+            *descriptorType = DescriptorType::SAMPLER;
+            return true;
+        case OP_TYPE_SAMPLED_IMAGE:
+        {
+            const Id* image = module.find( type.operands[0] );
+            *descriptorType = ( image != nullptr && image->operands[1] == DIM_BUFFER )
+                ? DescriptorType::UNIFORM_TEXEL_BUFFER
+                : DescriptorType::COMBINED_IMAGE_SAMPLER;
+            return true;
+        }
+        case OP_TYPE_IMAGE:
+        {
+            uint32_t dim     = type.operands[1];
+            bool     storage = type.operands[5] == 2;
+
+            if ( dim == DIM_SUBPASS_DATA )
+            {
+                *descriptorType = DescriptorType::INPUT_ATTACHMENT;
+            }
+            else if ( dim == DIM_BUFFER )
+            {
+                *descriptorType = storage ? DescriptorType::STORAGE_TEXEL_BUFFER
+                                          : DescriptorType::UNIFORM_TEXEL_BUFFER;
+            }
+            else
+            {
+                *descriptorType = storage ? DescriptorType::STORAGE_IMAGE
+                                          : DescriptorType::SAMPLED_IMAGE;
+            }
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+}
+
+/*
+ * Shader Reflection
+ */
+
+uint32_t ShaderReflection::getSetCount() const
+{
+    uint32_t count = 0;
+    for ( const auto& resource : this->resources )
+    {
+        count = std::max( count, resource.set + 1 );
+    }
+
+    return count;
+}
+
+std::vector<DescriptorBinding> ShaderReflection::getBindings(
+    uint32_t                     set,
+    const std::vector<uint32_t>& dynamicBindings
+    ) const
+{
+    std::vector<DescriptorBinding> bindings;
+
+    for ( const auto& resource : this->resources )
+    {
+        if ( resource.set != set )
+        {
+            continue;
+        }
+
+        DescriptorType type    = resource.type;
+        bool           dynamic = std::find( dynamicBindings.begin(),
+                                            dynamicBindings.end(),
+                                            resource.binding ) != dynamicBindings.end();
+        if ( dynamic && type == DescriptorType::UNIFORM_BUFFER )
+        {
+            type = DescriptorType::UNIFORM_BUFFER_DYNAMIC;
+        }
+        else if ( dynamic && type == DescriptorType::STORAGE_BUFFER )
+        {
+            type = DescriptorType::STORAGE_BUFFER_DYNAMIC;
+        }
+
+        bindings.emplace_back( resource.binding,
+                               type,
+                               resource.count,
+                               resource.stages );
+    }
+
+    return bindings;
+}
+
+void ShaderReflection::merge( const ShaderReflection& other )
+{
+    for ( const auto& resource : other.resources )
+    {
+        auto it = std::find_if( this->resources.begin(),
+                                this->resources.end(),
+                                [&]( const ShaderResource& r ) {
+                                    return r.set == resource.set &&
+                                           r.binding == resource.binding;
+                                } );
+
+        if ( it != this->resources.end() )
+        {
+            // Stages must agree, or the set layout would not fit one of them
+            if ( it->type != resource.type || it->count != resource.count )
+            {
+                throw std::runtime_error( "Shader stages disagree on set " +
+                                          std::to_string( resource.set ) +
+                                          " binding " +
+                                          std::to_string( resource.binding ) );
+            }
+            it->stages |= resource.stages;
+        }
+        else
+        {
+            this->resources.push_back( resource );
+        }
+    }
+
+    std::sort( this->resources.begin(),
+               this->resources.end(),
+               CompareResources );
+
+    // Stages sharing a push constant block share its range
+    for ( const auto& range : other.pushConstants )
+    {
+        auto it = std::find_if( this->pushConstants.begin(),
+                                this->pushConstants.end(),
+                                [&]( const VkPushConstantRange& r ) {
+                                    return r.offset == range.offset &&
+                                           r.size == range.size;
+                                } );
+
+        if ( it != this->pushConstants.end() )
+        {
+            it->stageFlags |= range.stageFlags;
+        }
+        else
+        {
+            this->pushConstants.push_back( range );
+        }
+    }
+
+    this->inputs.insert( this->inputs.end(),
+                         other.inputs.begin(),
+                         other.inputs.end() );
+
+    // Only a compute stage has a workgroup size other than one
+    for ( uint32_t axis = 0; axis < 3; axis++ )
+    {
+        this->localSize[ axis ] = std::max( this->localSize[ axis ],
+                                            other.localSize[ axis ] );
+    }
+}
+
+bool ReflectShader( const uint8_t*        code,
+                    std::size_t           size,
+                    VkShaderStageFlagBits stage,
+                    ShaderReflection*     reflection )
+{
+    *reflection = ShaderReflection();
+
+    // Five word header: magic, version, generator, id bound and schema
+    if ( size % 4 != 0 || size < 20 )
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> words( size / 4 );
+    std::memcpy( words.data(), code, size );
+
+    if ( words[0] != SPIRV_MAGIC )
+    {
+        return false;
+    }
+
+    Module                module;
+    std::vector<uint32_t> variables;
+
+    for ( std::size_t i = 5; i < words.size(); )
+    {
+        uint32_t op    = words[i] & 0xFFFF;
+        uint32_t count = words[i] >> 16;
+
+        if ( count == 0 || i + count > words.size() )
+        {
+            return false;
+        }
+
+        const uint32_t* operands = &words[ i + 1 ];
+        uint32_t        length   = count - 1;
+
+        switch ( op )
+        {
+        case OP_EXECUTION_MODE:
+            // Entry point, mode, then the x, y and z sizes
+            if ( length >= 5 && operands[1] == EXECUTION_MODE_LOCAL_SIZE )
+            {
+                reflection->localSize[0] = operands[2];
+                reflection->localSize[1] = operands[3];
+                reflection->localSize[2] = operands[4];
+            }
+            break;
+        case OP_TYPE_BOOL:
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+        case OP_TYPE_VECTOR:
+        case OP_TYPE_MATRIX:
+        case OP_TYPE_IMAGE:
+        case OP_TYPE_SAMPLER:
+        case OP_TYPE_SAMPLED_IMAGE:
+        case OP_TYPE_ARRAY:
+        case OP_TYPE_RUNTIME_ARRAY:
+        case OP_TYPE_STRUCT:
+        case OP_TYPE_POINTER:
+            if ( length >= 1 )
+            {
+                Id& id = module.ids[ operands[0] ];
+                id.op = op;
+                id.operands.assign( operands + 1, operands + length );
+            }
+            break;
+        case OP_CONSTANT:
+        case OP_VARIABLE:
+            // Result type comes before the result id
+            if ( length >= 2 )
+            {
+                Id& id = module.ids[ operands[1] ];
+                id.op = op;
+                id.operands.assign( operands, operands + length );
+                id.operands.erase( id.operands.begin() + 1 );
+
+                if ( op == OP_VARIABLE )
+                {
+                    variables.push_back( operands[1] );
+                }
+            }
+            break;
+        case OP_DECORATE:
+            if ( length >= 2 )
+            {
+                Id&      id    = module.ids[ operands[0] ];
+                uint32_t value = ( length >= 3 ) ? operands[2] : 0;
+
+                switch ( operands[1] )
+                {
+                case DECORATION_BLOCK:          id.block       = true;  break;
+                case DECORATION_BUFFER_BLOCK:   id.bufferBlock = true;  break;
+                case DECORATION_ARRAY_STRIDE:   id.arrayStride = value; break;
+                case DECORATION_BUILT_IN:       id.builtIn     = true;  break;
+                case DECORATION_LOCATION:       id.location    = value; break;
+                case DECORATION_BINDING:        id.binding     = value; break;
+                case DECORATION_DESCRIPTOR_SET: id.set         = value; break;
+                default:                                                break;
+                }
+            }
+            break;
+        case OP_MEMBER_DECORATE:
+            if ( length >= 4 )
+            {
+                Id& id = module.ids[ operands[0] ];
+
+                if ( operands[2] == DECORATION_OFFSET )
+                {
+                    SetMember( id.memberOffsets, operands[1], operands[3] );
+                }
+                else if ( operands[2] == DECORATION_MATRIX_STRIDE )
+                {
+                    SetMember( id.memberMatrixStrides, operands[1], operands[3] );
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        i += count;
+    }
+
+    for ( uint32_t variableId : variables )
+    {
+        const Id& variable = module.ids[ variableId ];
+        const Id* pointer  = module.find( variable.operands[0] );
+        uint32_t  storage  = variable.operands[1];
+
+        if ( pointer == nullptr || pointer->op != OP_TYPE_POINTER )
+        {
+            return false;
+        }
+
+        uint32_t  descriptorCount = 1;
+        const Id* type            = module.elementType( pointer->operands[1],
+                                                        &descriptorCount );
+        if ( type == nullptr )
+        {
+            return false;
+        }
+
+        DescriptorType descriptorType;
+
+        if ( storage == STORAGE_PUSH_CONSTANT )
+        {
+            VkPushConstantRange range = {};
+            range.stageFlags = stage;
+            range.offset     = module.firstOffset( pointer->operands[1] );
+            range.size       = module.size( pointer->operands[1] ) - range.offset;
+
+            reflection->pushConstants.push_back( range );
+        }
+        else if ( storage == STORAGE_INPUT )
+        {
+            // Built in inputs are not fed from vertex buffers
+            if ( stage == VK_SHADER_STAGE_VERTEX_BIT &&
+                 !variable.builtIn && variable.location != NOT_SET )
+            {
+                // A matrix input takes one location per column
+                const Id* inputType = module.find( pointer->operands[1] );
+                uint32_t  columns   = 1;
+                uint32_t  column    = pointer->operands[1];
+                if ( inputType != nullptr && inputType->op == OP_TYPE_MATRIX )
+                {
+                    columns = inputType->operands[1];
+                    column  = inputType->operands[0];
+                }
+
+                for ( uint32_t c = 0; c < columns; c++ )
+                {
+                    ShaderInput input;
+                    input.location = variable.location + c;
+                    input.format   = module.format( column );
+
+                    reflection->inputs.push_back( input );
+                }
+            }
+        }
+        else if ( GetDescriptorType( module, storage, *type, &descriptorType ) )
+        {
+            ShaderResource resource;
+            resource.set     = ( variable.set != NOT_SET ) ? variable.set : 0;
+            resource.binding = ( variable.binding != NOT_SET ) ? variable.binding : 0;
+            resource.type    = descriptorType;
+            resource.count   = descriptorCount;
+            resource.stages  = stage;
+
+            reflection->resources.push_back( resource );
+        }
+    }
+
+    std::sort( reflection->resources.begin(),
+               reflection->resources.end(),
+               CompareResources );
+
+    std::sort( reflection->inputs.begin(),
+               reflection->inputs.end(),
+               []( const ShaderInput& lhs, const ShaderInput& rhs ) {
+                   return lhs.location < rhs.location;
+               } );
+
+    return true;
+}
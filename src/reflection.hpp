@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "common.hpp"
+
+struct DescriptorBinding;
+
+/*
+ * Shader Reflection
+ */
+
+// A descriptor declared by a shader.
+struct ShaderResource
+{
+    uint32_t           set     = 0;
+    uint32_t           binding = 0;
+    DescriptorType     type    = DescriptorType::SAMPLER;
+    uint32_t           count   = 1;
+    VkShaderStageFlags stages  = 0;
+};
+
+// A vertex shader input, with the format of the variable in the shader.
+struct ShaderInput
+{
+    uint32_t location = 0;
+    VkFormat format   = VK_FORMAT_UNDEFINED;
+};
+
+// The interface of one or more shader stages, as declared in their SPIR-V.
+struct ShaderReflection
+{
+    std::vector<ShaderResource>      resources;     // Sorted by set, then binding
+    std::vector<VkPushConstantRange> pushConstants;
+    std::vector<ShaderInput>         inputs;        // Vertex stage only, sorted by location
+    uint32_t                         localSize[3] = { 1, 1, 1 }; // Compute stage workgroup size
+
+    // Number of descriptor set layouts needed, including any unused sets
+    // below the highest one.
+    uint32_t getSetCount() const;
+
+    // Bindings of one set. SPIR-V does not say whether a buffer is bound
+    // with a dynamic offset, so buffers whose binding numbers are listed in
+    // dynamicBindings are given the dynamic descriptor type.
+    std::vector<DescriptorBinding> getBindings(
+        uint32_t                     set,
+        const std::vector<uint32_t>& dynamicBindings = std::vector<uint32_t>()
+        ) const;
+
+    // Adds the interface of another stage. Resources used by both stages
+    // must be declared the same way in each.
+    void merge( const ShaderReflection& other );
+};
+
+// Reads the descriptors, push constant block, vertex inputs and workgroup
+// size of a SPIR-V module. A workgroup size given by specialization
+// constants reads as its default. Returns false if code is not valid SPIR-V.
+bool ReflectShader( const uint8_t*        code,
+                    std::size_t           size,
+                    VkShaderStageFlagBits stage,
+                    ShaderReflection*     reflection );
@@ -3,8 +3,9 @@
 #include "renderpass.hpp"
 #include "utils.hpp"
 
-void RenderPass::init( Device*  device,
-                       VkFormat imageFormat)
+void RenderPass::init( Device*       device,
+                       VkFormat      imageFormat,
+                       VkImageLayout finalLayout )
 {
     this->device = device;
     
@@ -17,7 +18,7 @@ void RenderPass::init( Device*  device,
     colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout    = finalLayout;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment = 0;
@@ -70,6 +71,17 @@ void RenderPass::init( Device*  device,
 
     VK_CHECK_RESULT( this->device->createRenderPass( &renderPassCreateInfo,
                                                      &this->renderPass ) );
+
+    this->compatibilityHash = HASH_SEED;
+    for ( const auto& attachment : attachments )
+    {
+        this->compatibilityHash = HashBytes( &attachment.format,
+                                             sizeof(attachment.format),
+                                             this->compatibilityHash );
+        this->compatibilityHash = HashBytes( &attachment.samples,
+                                             sizeof(attachment.samples),
+                                             this->compatibilityHash );
+    }
 }
 
 void RenderPass::deinit()
@@ -77,6 +89,7 @@ void RenderPass::deinit()
     if ( this->renderPass != VK_NULL_HANDLE )
     {
         this->device->destroyRenderPass( this->renderPass );
+        this->renderPass = VK_NULL_HANDLE;
     }
 }
 
@@ -84,3 +97,8 @@ VkRenderPass RenderPass::getRenderPass() const
 {
     return this->renderPass;
 }
+
+uint64_t RenderPass::getCompatibilityHash() const
+{
+    return this->compatibilityHash;
+}
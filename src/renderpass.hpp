@@ -11,21 +11,30 @@ public:
     
     RenderPass() {} 
 
-    RenderPass( Device* device, VkFormat imageFormat )
+    RenderPass( Device*       device,
+                VkFormat      imageFormat,
+                VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR )
     {
-        this->init( device, imageFormat );
+        this->init( device, imageFormat, finalLayout );
     }
 
     ~RenderPass() { this->deinit(); }
 
-    void init( Device* device, VkFormat imageFormat );
+    void init( Device*       device,
+               VkFormat      imageFormat,
+               VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR );
 
     void deinit();
 
     VkRenderPass getRenderPass() const;
 
+    // Equal for render passes whose attachments have the same formats and
+    // sample counts, which Vulkan treats as compatible for pipelines.
+    uint64_t getCompatibilityHash() const;
+
 private:
 
-    Device*      device;
-    VkRenderPass renderPass;
+    Device*      device            = nullptr;
+    VkRenderPass renderPass        = VK_NULL_HANDLE;
+    uint64_t     compatibilityHash = 0;
 };
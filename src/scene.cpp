@@ -0,0 +1,164 @@
+#include <cstddef>
+#include <cstring>
+
+#include "common.hpp"
+#include "scene.hpp"
+
+static const uint32_t NO_SLOT = UINT32_MAX;
+
+// Smallest instance buffer allocated, so small scenes do not reallocate as
+// their first few instances are added.
+static const uint32_t MIN_INSTANCE_CAPACITY = 64;
+
+/*
+ * Scene
+ */
+
+void Scene::init( Device* device, UploadContext* upload, uint32_t frames )
+{
+    this->deinit();
+
+    this->device = device;
+    this->upload = upload;
+    this->frames.resize( frames );
+}
+
+void Scene::deinit()
+{
+    this->frames.clear();
+    this->instances.clear();
+    this->instanceIds.clear();
+    this->slots.clear();
+    this->freeIds.clear();
+    this->version = 1;
+}
+
+InstanceId Scene::addInstance( const glm::mat4& transform )
+{
+    InstanceId id;
+    if ( !this->freeIds.empty() )
+    {
+        id = this->freeIds.back();
+        this->freeIds.pop_back();
+    }
+    else
+    {
+        id = (InstanceId)this->slots.size();
+        this->slots.push_back( NO_SLOT );
+    }
+
+    InstanceData data;
+    data.transform = transform;
+
+    this->slots[ id ] = (uint32_t)this->instances.size();
+    this->instances.push_back( data );
+    this->instanceIds.push_back( id );
+    this->version++;
+
+    return id;
+}
+
+void Scene::removeInstance( InstanceId id )
+{
+    assert( id < this->slots.size() && this->slots[ id ] != NO_SLOT );
+
+    // Move the last instance into the hole to keep the array dense
+    uint32_t slot = this->slots[ id ];
+    uint32_t last = (uint32_t)this->instances.size() - 1;
+
+    this->instances[ slot ]   = this->instances[ last ];
+    this->instanceIds[ slot ] = this->instanceIds[ last ];
+    this->slots[ this->instanceIds[ slot ] ] = slot;
+
+    this->instances.pop_back();
+    this->instanceIds.pop_back();
+    this->slots[ id ] = NO_SLOT;
+    this->freeIds.push_back( id );
+    this->version++;
+}
+
+void Scene::setTransform( InstanceId id, const glm::mat4& transform )
+{
+    assert( id < this->slots.size() && this->slots[ id ] != NO_SLOT );
+
+    this->instances[ this->slots[ id ] ].transform = transform;
+    this->version++;
+}
+
+uint32_t Scene::getInstanceCount() const
+{
+    return (uint32_t)this->instances.size();
+}
+
+void Scene::update( uint32_t frame )
+{
+    assert( frame < this->frames.size() );
+
+    FrameBuffer& target = this->frames[ frame ];
+    uint32_t     count  = this->getInstanceCount();
+
+    if ( target.buffer && target.version == this->version )
+    {
+        return;
+    }
+
+    // Only this frame's buffer is replaced, and the GPU is done with it,
+    // so growing never has to wait for the other frames in flight
+    if ( !target.buffer || count > target.capacity )
+    {
+        uint32_t capacity = ( target.capacity > 0 )
+            ? target.capacity
+            : MIN_INSTANCE_CAPACITY;
+        while ( capacity < count )
+        {
+            capacity *= 2;
+        }
+
+        target.buffer.reset( new Buffer( this->device,
+                                         this->upload,
+                                         capacity * sizeof(InstanceData),
+                                         BufferUsage::STORAGE,
+                                         MemoryLocation::HOST ) );
+        target.capacity = capacity;
+    }
+
+    std::memcpy( target.buffer->memory.mapped,
+                 this->instances.data(),
+                 count * sizeof(InstanceData) );
+    target.version = this->version;
+}
+
+Buffer& Scene::getInstanceBuffer( uint32_t frame )
+{
+    assert( frame < this->frames.size() && this->frames[ frame ].buffer );
+
+    return *this->frames[ frame ].buffer;
+}
+
+VkVertexInputBindingDescription Scene::GetBindingDescription( uint32_t binding )
+{
+    VkVertexInputBindingDescription description = {};
+    description.binding   = binding;
+    description.stride    = sizeof(InstanceData);
+    description.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return description;
+}
+
+std::vector<VkVertexInputAttributeDescription> Scene::GetAttributeDescriptions(
+    uint32_t binding,
+    uint32_t location )
+{
+    std::vector<VkVertexInputAttributeDescription> attributes( 4 );
+
+    for ( uint32_t column = 0; column < 4; column++ )
+    {
+        attributes[ column ].binding  = binding;
+        attributes[ column ].location = location + column;
+        attributes[ column ].format   = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributes[ column ].offset   = offsetof( InstanceData, transform ) +
+                                        column * sizeof(glm::vec4);
+    }
+
+    return attributes;
+}
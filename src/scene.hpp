@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+class UploadContext;
+
+/*
+ * Scene
+ */
+
+// Identifies an instance for as long as it is in the scene. Ids of removed
+// instances are reused.
+typedef uint32_t InstanceId;
+
+// Per instance vertex data, read by the vertex shader at the locations
+// given by Scene::GetAttributeDescriptions.
+struct InstanceData
+{
+    glm::mat4 transform;
+};
+
+// Many copies of one model, drawn with a single instanced draw. Instance
+// data is kept densely packed, so removing an instance moves the last one
+// into its place, and is copied into a host visible buffer per frame in
+// flight whenever it has changed since that frame last drew. The buffer can
+// be bound as a vertex buffer or read as a storage buffer by culling.
+class Scene
+{
+public:
+
+    Scene() {}
+
+    Scene( const Scene& ) = delete;
+    Scene& operator=( const Scene& ) = delete;
+
+    ~Scene() { this->deinit(); }
+
+    void init( Device* device, UploadContext* upload, uint32_t frames );
+
+    void deinit();
+
+    InstanceId addInstance( const glm::mat4& transform );
+
+    void removeInstance( InstanceId id );
+
+    void setTransform( InstanceId id, const glm::mat4& transform );
+
+    uint32_t getInstanceCount() const;
+
+    // Brings a frame's instance buffer up to date, growing it if the scene
+    // no longer fits. The frame's previous GPU use must have completed.
+    void update( uint32_t frame );
+
+    // Bind at the instance binding before drawing getInstanceCount()
+    // instances. Only valid after update( frame ).
+    Buffer& getInstanceBuffer( uint32_t frame );
+
+    static VkVertexInputBindingDescription GetBindingDescription( uint32_t binding );
+
+    // One vec4 attribute per column of the transform, starting at location.
+    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(
+        uint32_t binding,
+        uint32_t location
+        );
+
+private:
+
+    struct FrameBuffer
+    {
+        std::unique_ptr<Buffer> buffer;
+        uint32_t                capacity = 0; // In instances
+        uint64_t                version  = 0; // Scene version last written
+    };
+
+    Device*                   device  = nullptr;
+    UploadContext*            upload  = nullptr;
+    std::vector<InstanceData> instances;      // Dense, in draw order
+    std::vector<InstanceId>   instanceIds;    // Id of each dense slot
+    std::vector<uint32_t>     slots;          // Dense slot of each id
+    std::vector<InstanceId>   freeIds;
+    uint64_t                  version = 1;    // Bumped on every change
+    std::vector<FrameBuffer>  frames;
+};
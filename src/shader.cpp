@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <vulkan/vulkan.h>
@@ -8,6 +12,142 @@
 #include "shader.hpp"
 #include "utils.hpp"
 
+static const VkShaderStageFlagBits SHADER_STAGES[] = {
+    VK_SHADER_STAGE_VERTEX_BIT,
+    VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+    VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+    VK_SHADER_STAGE_GEOMETRY_BIT,
+    VK_SHADER_STAGE_FRAGMENT_BIT,
+    VK_SHADER_STAGE_COMPUTE_BIT
+};
+
+/*
+ * Specialization Constants
+ */
+
+void SpecializationConstants::set( VkShaderStageFlags stages,
+                                   uint32_t           constantId,
+                                   bool               value )
+{
+    this->setBits( stages, constantId, value ? VK_TRUE : VK_FALSE );
+}
+
+void SpecializationConstants::set( VkShaderStageFlags stages,
+                                   uint32_t           constantId,
+                                   int32_t            value )
+{
+    this->setBits( stages, constantId, (uint32_t)value );
+}
+
+void SpecializationConstants::set( VkShaderStageFlags stages,
+                                   uint32_t           constantId,
+                                   uint32_t           value )
+{
+    this->setBits( stages, constantId, value );
+}
+
+void SpecializationConstants::set( VkShaderStageFlags stages,
+                                   uint32_t           constantId,
+                                   float              value )
+{
+    uint32_t bits;
+    std::memcpy( &bits, &value, sizeof(bits) );
+
+    this->setBits( stages, constantId, bits );
+}
+
+VkSpecializationInfo SpecializationConstants::getInfo( VkShaderStageFlagBits stage ) const
+{
+    VkSpecializationInfo info = {};
+
+    for ( const auto& entry : this->stages )
+    {
+        if ( entry.stage == stage )
+        {
+            info.mapEntryCount = entry.entries.size();
+            info.pMapEntries   = entry.entries.data();
+            info.dataSize      = entry.data.size() * sizeof(uint32_t);
+            info.pData         = entry.data.data();
+        }
+    }
+
+    return info;
+}
+
+void SpecializationConstants::appendKey( std::vector<uint8_t>& key ) const
+{
+    // Counts keep differently shaped sets of constants from sharing a key
+    AppendKey( key, (uint32_t)this->stages.size() );
+
+    for ( const auto& entry : this->stages )
+    {
+        AppendKey( key, entry.stage );
+        AppendKey( key, (uint32_t)entry.entries.size() );
+
+        for ( std::size_t i = 0; i < entry.entries.size(); i++ )
+        {
+            AppendKey( key, entry.entries[i].constantID );
+            AppendKey( key, entry.data[i] );
+        }
+    }
+}
+
+void SpecializationConstants::setBits( VkShaderStageFlags stages,
+                                       uint32_t           constantId,
+                                       uint32_t           bits )
+{
+    for ( VkShaderStageFlagBits stageBit : SHADER_STAGES )
+    {
+        if ( ( stages & stageBit ) == 0 )
+        {
+            continue;
+        }
+
+        // Stages are kept in pipeline order so keys do not depend on the
+        // order constants were set in
+        auto stage = std::find_if( this->stages.begin(),
+                                   this->stages.end(),
+                                   [&]( const Stage& s ) { return s.stage >= stageBit; } );
+        if ( stage == this->stages.end() || stage->stage != stageBit )
+        {
+            Stage added;
+            added.stage = stageBit;
+            stage = this->stages.insert( stage, added );
+        }
+
+        // Each value is 4 bytes, so entry i is at offset 4 * i
+        auto entry = std::lower_bound( stage->entries.begin(),
+                                       stage->entries.end(),
+                                       constantId,
+                                       []( const VkSpecializationMapEntry& e, uint32_t id ) {
+                                           return e.constantID < id;
+                                       } );
+        std::size_t index = entry - stage->entries.begin();
+
+        if ( entry != stage->entries.end() && entry->constantID == constantId )
+        {
+            stage->data[ index ] = bits;
+            continue;
+        }
+
+        VkSpecializationMapEntry added = {};
+        added.constantID = constantId;
+        added.size       = sizeof(uint32_t);
+
+        stage->entries.insert( entry, added );
+        stage->data.insert( stage->data.begin() + index, bits );
+
+        for ( std::size_t i = 0; i < stage->entries.size(); i++ )
+        {
+            stage->entries[i].offset = (uint32_t)( i * sizeof(uint32_t) );
+        }
+    }
+}
+
+/*
+ * Graphics Shader
+ */
+
 void GraphicsShader::init( Device*              device,
                            std::vector<uint8_t> vertexCode,
                            std::vector<uint8_t> fragmentCode,
@@ -17,6 +157,8 @@ void GraphicsShader::init( Device*              device,
 {
     this->numModules = 0;
     this->device     = device;
+    this->hash       = HASH_SEED;
+    this->reflection = ShaderReflection();
 
     this->createShaderModule( VK_SHADER_STAGE_VERTEX_BIT,
                               vertexCode );
@@ -37,8 +179,10 @@ void GraphicsShader::deinit()
         if ( this->modules[ i ] != VK_NULL_HANDLE )
         {
             this->device->destroyShaderModule( this->modules[ i ] );
+            this->modules[ i ] = VK_NULL_HANDLE;
         }
     }
+    this->numModules = 0;
 }
 
 uint32_t GraphicsShader::getNumModules() const
@@ -46,6 +190,16 @@ uint32_t GraphicsShader::getNumModules() const
     return this->numModules;
 }
 
+uint64_t GraphicsShader::getHash() const
+{
+    return this->hash;
+}
+
+const ShaderReflection& GraphicsShader::getReflection() const
+{
+    return this->reflection;
+}
+
 void GraphicsShader::createShaderModule(
     VkShaderStageFlagBits stage,
     std::vector<uint8_t>  code 
@@ -53,6 +207,15 @@ void GraphicsShader::createShaderModule(
 {
     if ( code.size() > 0 ) // Only create a shader if the user specified code
     {
+        // Layouts are built from the reflection, so never go on without one
+        ShaderReflection stageReflection;
+        if ( !ReflectShader( code.data(), code.size(), stage, &stageReflection ) )
+        {
+            throw std::runtime_error( "Invalid SPIR-V in shader stage " +
+                                      std::to_string( stage ) );
+        }
+        this->reflection.merge( stageReflection );
+
         VkShaderModuleCreateInfo info = {};
         info.sType     = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         info.codeSize = code.size();
@@ -69,7 +232,51 @@ void GraphicsShader::createShaderModule(
         ps_info.stage  = stage;
         ps_info.module = this->modules[ this->numModules ];
         ps_info.pName  = "main";
-        
+
+        this->hash = HashBytes( &stage, sizeof(stage), this->hash );
+        this->hash = HashBytes( code.data(), code.size(), this->hash );
+
         this->numModules++;
     }
 }
+
+/*
+ * Compute Shader
+ */
+
+void ComputeShader::init( Device* device, const std::vector<uint8_t>& code )
+{
+    this->deinit();
+
+    this->device = device;
+
+    if ( !ReflectShader( code.data(),
+                         code.size(),
+                         VK_SHADER_STAGE_COMPUTE_BIT,
+                         &this->reflection ) )
+    {
+        throw std::runtime_error( "Invalid SPIR-V in compute shader" );
+    }
+
+    VkShaderModuleCreateInfo info = {};
+    info.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = code.size();
+    info.pCode    = (const uint32_t*)code.data();
+
+    VK_CHECK_RESULT( this->device->createShaderModule( &info,
+                                                       &this->module ) );
+}
+
+void ComputeShader::deinit()
+{
+    if ( this->module != VK_NULL_HANDLE )
+    {
+        this->device->destroyShaderModule( this->module );
+        this->module = VK_NULL_HANDLE;
+    }
+}
+
+const ShaderReflection& ComputeShader::getReflection() const
+{
+    return this->reflection;
+}
@@ -8,6 +8,43 @@
 #include <vulkan/vulkan.h>
 
 #include "device.hpp"
+#include "reflection.hpp"
+#include "utils.hpp"
+
+// Values of specialization constants, by constant_id, for each shader
+// stage. A stage without values uses the defaults compiled into it.
+class SpecializationConstants
+{
+public:
+
+    // Sets a constant in every stage in stages, replacing an earlier value
+    // for the same id. Booleans are stored as VkBool32, as SPIR-V expects.
+    void set( VkShaderStageFlags stages, uint32_t constantId, bool value );
+    void set( VkShaderStageFlags stages, uint32_t constantId, int32_t value );
+    void set( VkShaderStageFlags stages, uint32_t constantId, uint32_t value );
+    void set( VkShaderStageFlags stages, uint32_t constantId, float value );
+
+    // Points into this object, so it is only valid until the next set().
+    // Has no map entries for stages without values.
+    VkSpecializationInfo getInfo( VkShaderStageFlagBits stage ) const;
+
+    // Appends the stages, ids and values, so equal constants produce equal
+    // pipeline keys.
+    void appendKey( std::vector<uint8_t>& key ) const;
+
+private:
+
+    struct Stage
+    {
+        VkShaderStageFlagBits                 stage;
+        std::vector<VkSpecializationMapEntry> entries; // Sorted by constantID
+        std::vector<uint32_t>                 data;
+    };
+
+    std::vector<Stage> stages;
+
+    void setBits( VkShaderStageFlags stages, uint32_t constantId, uint32_t bits );
+};
 
 class GraphicsShader
 {
@@ -41,10 +78,20 @@ public:
 
     uint32_t getNumModules() const;
 
+    // Identifies the stages and their SPIR-V, so shaders built from the
+    // same code hash equally.
+    uint64_t getHash() const;
+
+    // Descriptors, push constants and vertex inputs of all stages, read
+    // from their SPIR-V.
+    const ShaderReflection& getReflection() const;
+
 private:
 
     Device*                                        device     = nullptr;
     uint32_t                                       numModules = 0;
+    uint64_t                                       hash       = HASH_SEED;
+    ShaderReflection                               reflection;
 
     std::array<VkShaderModule, 5>                  modules;
     std::array<VkPipelineShaderStageCreateInfo, 5> pipelineInfo;
@@ -52,3 +99,35 @@ private:
     void createShaderModule( VkShaderStageFlagBits stage,
                              std::vector<uint8_t>  code );
 };
+
+class ComputeShader
+{
+    friend class ComputePipeline;
+
+public:
+
+    ComputeShader() {}
+
+    ComputeShader( Device* device, const std::vector<uint8_t>& code )
+    {
+        this->init( device, code );
+    }
+
+    ComputeShader( const ComputeShader& ) = delete;
+    ComputeShader& operator=( const ComputeShader& ) = delete;
+
+    ~ComputeShader() { this->deinit(); }
+
+    void init( Device* device, const std::vector<uint8_t>& code );
+
+    void deinit();
+
+    // Descriptors, push constants and workgroup size, read from the SPIR-V.
+    const ShaderReflection& getReflection() const;
+
+private:
+
+    Device*          device = nullptr;
+    VkShaderModule   module = VK_NULL_HANDLE;
+    ShaderReflection reflection;
+};
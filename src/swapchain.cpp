@@ -91,13 +91,16 @@ void SwapChain::deinit( bool destroySwapchain )
     {
         this->device->destroyFramebuffer( fb );
     }
+    this->framebuffers.clear();
     for ( auto imgview : this->imageViews )
     {
         this->device->destroyImageView( imgview );
     }
+    this->imageViews.clear();
     if ( destroySwapchain && this->id != VK_NULL_HANDLE )
     {
         this->device->destroySwapchain( this->id );
+        this->id = VK_NULL_HANDLE;
     }
 
     this->initialized = ( this->id == VK_NULL_HANDLE ) ? false : true;
@@ -1,15 +1,77 @@
+#include <stdexcept>
+
 #include "common.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "mipmap.hpp"
 #include "texture.hpp"
+#include "threadpool.hpp"
+#include "texturefile.hpp"
+
+// A KTX2 or DDS file is used directly. For anything else a compressed file
+// with the same base name is preferred, e.g. chalet.ktx2 for chalet.jpg.
+static std::vector<std::string> GetCompressedCandidates( const std::string& fileName )
+{
+    if ( IsCompressedTexturePath( fileName ) )
+    {
+        return { fileName };
+    }
+
+    std::size_t dot   = fileName.find_last_of( '.' );
+    std::size_t slash = fileName.find_last_of( "/\\" );
+    std::string base  = fileName;
+    if ( dot != std::string::npos && ( slash == std::string::npos || dot > slash ) )
+    {
+        base = fileName.substr( 0, dot );
+    }
+
+    return { base + ".ktx2", base + ".dds" };
+}
 
-void Texture::init( Device*      device,
-                    VkQueue      queue,
-                    CommandPool* commandPool,
-                    std::string  fileName )
+void Texture::init( Device*        device,
+                    UploadContext* upload,
+                    std::string    fileName,
+                    ThreadPool*    pool )
 {
+    this->init( device, upload, Texture::Decode( device, fileName, pool ) );
+}
+
+void Texture::init( Device*            device,
+                    UploadContext*     upload,
+                    const TextureData& data )
+{
+    this->image.init( device,
+                      upload,
+                      data.width,
+                      data.height,
+                      data.format,
+                      ImageType::COLOR,
+                      (void*)data.data.data(),
+                      data.data.size(),
+                      data.mipLevels,
+                      data.dataLevels );
+
+    this->sampler.init( device, this->image.getMipLevels() );
+}
+
+TextureData Texture::Decode( Device*            device,
+                             const std::string& fileName,
+                             ThreadPool*        pool )
+{
+    TextureData data;
+
+    if ( Texture::DecodeCompressed( device, fileName, data ) )
+    {
+        return data;
+    }
+
+    if ( IsCompressedTexturePath( fileName ) )
+    {
+        throw std::runtime_error( "Failed to load compressed texture " + fileName );
+    }
+
     // Load image from file.
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load( fileName.c_str(),
@@ -17,23 +79,75 @@ void Texture::init( Device*      device,
                                  &texHeight,
                                  &texChannels,
                                  STBI_rgb_alpha );
-    assert( pixels );
+    if ( pixels == nullptr )
+    {
+        throw std::runtime_error( "Failed to load texture " + fileName );
+    }
     std::size_t imageSize = texWidth * texHeight * 4;
 
-    // Create texture.
-    this->image.init( device,
-                      queue,
-                      commandPool,
-                      texWidth,
-                      texHeight,
-                      VK_FORMAT_R8G8B8A8_UNORM,
-                      ImageType::COLOR,
-                      (void*)pixels,
-                      imageSize );
+    data.format    = VK_FORMAT_R8G8B8A8_UNORM;
+    data.width     = texWidth;
+    data.height    = texHeight;
+    data.mipLevels = GetMipLevelCount( texWidth, texHeight );
+
+    if ( Image::SupportsMipmapBlits( device, data.format ) )
+    {
+        data.dataLevels = 1;
+        data.data.assign( pixels, pixels + imageSize );
+    }
+    else
+    {
+        data.dataLevels = data.mipLevels;
+        GenerateMipChain( pixels,
+                          texWidth,
+                          texHeight,
+                          data.mipLevels,
+                          data.data,
+                          pool );
+    }
 
     stbi_image_free( pixels );  // Free file data.
 
-    this->sampler.init( device );
+    return data;
+}
+
+bool Texture::DecodeCompressed( Device*            device,
+                                const std::string& fileName,
+                                TextureData&       data )
+{
+    for ( const auto& candidate : GetCompressedCandidates( fileName ) )
+    {
+        TextureFile file;
+        if ( !file.init( candidate ) )
+        {
+            continue;
+        }
+
+        VkFormat format = FindSupportedFormat( device->physicalDevice,
+                                               { file.format },
+                                               VK_IMAGE_TILING_OPTIMAL,
+                                               VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                               VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT );
+        if ( format == VK_FORMAT_UNDEFINED )
+        {
+            std::cerr << "Compressed format of " << candidate
+                      << " is not supported, skipping it" << std::endl;
+            continue;
+        }
+
+        // Block compressed levels cannot be blitted, so only the levels in
+        // the file are used
+        data.format     = format;
+        data.width      = file.width;
+        data.height     = file.height;
+        data.mipLevels  = file.mipLevels;
+        data.dataLevels = file.mipLevels;
+        data.data       = file.getPackedLevels();
+
+        return true;
+    }
+
+    return false;
 }
 
 void Texture::deinit()
@@ -51,3 +165,40 @@ Sampler& Texture::getSampler()
 {
     return this->sampler;
 }
+
+/*
+ * Texture Loader
+ */
+
+void TextureLoader::init( Device* device, ThreadPool* pool )
+{
+    this->device = device;
+    this->pool   = pool;
+}
+
+std::future<TextureData> TextureLoader::load( const std::string& fileName )
+{
+    Device* device = this->device;
+
+    // Each texture is decoded on one worker. The pool is not passed on, as
+    // parallelFor must not be called from a pool thread, and many textures
+    // in flight keep the workers busy anyway.
+    return this->pool->submit( [device, fileName]() {
+        return Texture::Decode( device, fileName, nullptr );
+    } );
+}
+
+std::vector<std::future<TextureData>> TextureLoader::load(
+    const std::vector<std::string>& fileNames
+    )
+{
+    std::vector<std::future<TextureData>> pending;
+    pending.reserve( fileNames.size() );
+
+    for ( const auto& fileName : fileNames )
+    {
+        pending.push_back( this->load( fileName ) );
+    }
+
+    return pending;
+}
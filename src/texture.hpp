@@ -1,32 +1,54 @@
 #pragma once
 
+#include <future>
 #include <string>
+#include <vector>
 
 #include <vulkan/vulkan.h>
 
 #include "device.hpp"
 #include "image.hpp"
 
+class ThreadPool;
+class UploadContext;
+
+// A texture read from disk and ready to upload, produced by Texture::Decode.
+struct TextureData
+{
+    VkFormat             format     = VK_FORMAT_UNDEFINED;
+    uint32_t             width      = 0;
+    uint32_t             height     = 0;
+    uint32_t             mipLevels  = 1;
+    uint32_t             dataLevels = 1; // Levels in data, the rest are blitted
+    std::vector<uint8_t> data;           // Tightly packed levels, largest first
+};
+
 class Texture
 {
 public:
 
-    Texture( Device*      device,
-             VkQueue      queue,
-             CommandPool* commandPool,
-             std::string  fileName )
+    Texture( Device*        device,
+             UploadContext* upload,
+             std::string    fileName,
+             ThreadPool*    pool = nullptr )
     {
-        this->init( device, queue, commandPool, fileName );
+        this->init( device, upload, fileName, pool );
     }
 
     Texture() {}
 
     ~Texture() { this->deinit(); }
 
-    void init( Device*      device,
-               VkQueue      queue,
-               CommandPool* commandPool,
-               std::string  fileName );
+    // Decodes and uploads a texture, see Decode.
+    void init( Device*        device,
+               UploadContext* upload,
+               std::string    fileName,
+               ThreadPool*    pool = nullptr );
+
+    // Uploads a texture decoded earlier, e.g. by a TextureLoader.
+    void init( Device*            device,
+               UploadContext*     upload,
+               const TextureData& data );
 
     void deinit();
 
@@ -34,8 +56,56 @@ public:
 
     Sampler& getSampler();
 
+    // Uses a pre-compressed KTX2 or DDS texture and the mip levels stored
+    // in it when one is found and the device supports its format, see
+    // GetCompressedCandidates. Otherwise decodes the image and leaves the
+    // mip chain to be blitted on the GPU when the format allows it, or
+    // builds it on the CPU. A pool, if given, is used for the CPU filtering.
+    //
+    // Only queries format support from the device, so it is safe to call
+    // from any thread.
+    static TextureData Decode( Device*            device,
+                               const std::string& fileName,
+                               ThreadPool*        pool = nullptr );
+
 private:
     
     Image   image;
     Sampler sampler;
+
+    // Returns false if no usable compressed file exists.
+    static bool DecodeCompressed( Device*            device,
+                                  const std::string& fileName,
+                                  TextureData&       data );
+};
+
+// Decodes textures on worker threads so that many files load at once. The
+// decoded data is then uploaded with Texture::init on the thread that owns
+// the UploadContext:
+//
+//     auto pending = loader.load( "textures/a.jpg" );
+//     ...
+//     texture.init( device, upload, pending.get() );
+class TextureLoader
+{
+public:
+
+    TextureLoader() {}
+
+    TextureLoader( Device* device, ThreadPool* pool )
+    {
+        this->init( device, pool );
+    }
+
+    void init( Device* device, ThreadPool* pool );
+
+    // Queues the file for decoding and returns immediately.
+    std::future<TextureData> load( const std::string& fileName );
+
+    std::vector<std::future<TextureData>> load( const std::vector<std::string>& fileNames );
+
+private:
+
+    Device*     device = nullptr;
+    ThreadPool* pool   = nullptr;
 };
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cstring>
+
+#include "common.hpp"
+#include "mipmap.hpp"
+#include "texturefile.hpp"
+
+static const uint8_t KTX2_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+namespace
+{
+    struct Ktx2Header
+    {
+        uint8_t  identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct Ktx2Level
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    struct DdsPixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t bitMasks[4];
+    };
+
+    struct DdsHeader
+    {
+        uint32_t       magic;
+        uint32_t       size;
+        uint32_t       flags;
+        uint32_t       height;
+        uint32_t       width;
+        uint32_t       pitchOrLinearSize;
+        uint32_t       depth;
+        uint32_t       mipMapCount;
+        uint32_t       reserved1[11];
+        DdsPixelFormat pixelFormat;
+        uint32_t       caps[4];
+        uint32_t       reserved2;
+    };
+
+    struct DdsHeaderDx10
+    {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+}
+
+static const uint32_t DDS_FOURCC_FLAG = 0x4;
+
+static uint32_t MakeFourCC( char a, char b, char c, char d )
+{
+    return (uint32_t)a | ( (uint32_t)b << 8 ) | ( (uint32_t)c << 16 ) | ( (uint32_t)d << 24 );
+}
+
+static VkFormat FromDxgiFormat( uint32_t dxgiFormat )
+{
+    switch ( dxgiFormat )
+    {
+    case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+    case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+    default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static VkFormat FromFourCC( uint32_t fourCC )
+{
+    if ( fourCC == MakeFourCC( 'D', 'X', 'T', '1' ) )
+    {
+        return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    }
+    else if ( fourCC == MakeFourCC( 'D', 'X', 'T', '5' ) )
+    {
+        return VK_FORMAT_BC3_UNORM_BLOCK;
+    }
+    else if ( fourCC == MakeFourCC( 'A', 'T', 'I', '2' ) ||
+              fourCC == MakeFourCC( 'B', 'C', '5', 'U' ) )
+    {
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+/*
+ * Texture Files
+ */
+
+bool TextureFile::init( const std::string& fileName )
+{
+    this->deinit();
+
+    if ( !this->file.init( fileName ) )
+    {
+        return false;
+    }
+
+    bool valid = false;
+    if ( this->file.getSize() >= sizeof(KTX2_IDENTIFIER) &&
+         std::memcmp( this->file.getData(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER) ) == 0 )
+    {
+        valid = this->initKtx2();
+    }
+    else if ( this->file.getSize() >= sizeof(uint32_t) &&
+              std::memcmp( this->file.getData(), "DDS ", 4 ) == 0 )
+    {
+        valid = this->initDds();
+    }
+
+    if ( !valid )
+    {
+        this->deinit();
+        return false;
+    }
+
+    return true;
+}
+
+void TextureFile::deinit()
+{
+    this->file.deinit();
+    this->levelOffsets.clear();
+    this->format    = VK_FORMAT_UNDEFINED;
+    this->width     = 0;
+    this->height    = 0;
+    this->mipLevels = 0;
+}
+
+const uint8_t* TextureFile::getLevelData( uint32_t level ) const
+{
+    return this->file.getData() + this->levelOffsets[ level ];
+}
+
+VkDeviceSize TextureFile::getLevelSize( uint32_t level ) const
+{
+    return GetImageLevelSize( this->format,
+                              std::max( this->width >> level, 1u ),
+                              std::max( this->height >> level, 1u ) );
+}
+
+std::vector<uint8_t> TextureFile::getPackedLevels() const
+{
+    VkDeviceSize totalSize = 0;
+    for ( uint32_t level = 0; level < this->mipLevels; level++ )
+    {
+        totalSize += this->getLevelSize( level );
+    }
+
+    std::vector<uint8_t> packed( totalSize );
+    uint8_t*             dst = packed.data();
+    for ( uint32_t level = 0; level < this->mipLevels; level++ )
+    {
+        VkDeviceSize size = this->getLevelSize( level );
+        std::memcpy( dst, this->getLevelData( level ), size );
+        dst += size;
+    }
+
+    return packed;
+}
+
+bool TextureFile::initKtx2()
+{
+    const uint8_t* data = this->file.getData();
+    uint64_t       size = this->file.getSize();
+
+    Ktx2Header header;
+    if ( size < sizeof(header) )
+    {
+        return false;
+    }
+    std::memcpy( &header, data, sizeof(header) );
+
+    // 2D, single layer and face, not supercompressed
+    if ( header.pixelWidth == 0 || header.pixelHeight == 0 ||
+         header.pixelDepth != 0 || header.layerCount > 1 ||
+         header.faceCount != 1 || header.supercompressionScheme != 0 )
+    {
+        return false;
+    }
+
+    this->format    = (VkFormat)header.vkFormat;
+    this->width     = header.pixelWidth;
+    this->height    = header.pixelHeight;
+    this->mipLevels = std::max( header.levelCount, 1u );
+
+    // No more levels than the chain down to 1x1 has
+    if ( this->mipLevels > GetMipLevelCount( this->width, this->height ) ||
+         GetFormatBlockSize( this->format ) == 0 ||
+         size < sizeof(header) + (uint64_t)this->mipLevels * sizeof(Ktx2Level) )
+    {
+        return false;
+    }
+
+    for ( uint32_t level = 0; level < this->mipLevels; level++ )
+    {
+        Ktx2Level index;
+        std::memcpy( &index,
+                     data + sizeof(header) + level * sizeof(Ktx2Level),
+                     sizeof(index) );
+
+        if ( index.byteLength < this->getLevelSize( level ) ||
+             index.byteOffset > size ||
+             index.byteLength > size - index.byteOffset )
+        {
+            return false;
+        }
+
+        this->levelOffsets.push_back( index.byteOffset );
+    }
+
+    return true;
+}
+
+bool TextureFile::initDds()
+{
+    const uint8_t* data = this->file.getData();
+    uint64_t       size = this->file.getSize();
+
+    DdsHeader header;
+    if ( size < sizeof(header) )
+    {
+        return false;
+    }
+    std::memcpy( &header, data, sizeof(header) );
+
+    if ( header.size != 124 || !( header.pixelFormat.flags & DDS_FOURCC_FLAG ) )
+    {
+        return false;
+    }
+
+    uint64_t offset = sizeof(header);
+    if ( header.pixelFormat.fourCC == MakeFourCC( 'D', 'X', '1', '0' ) )
+    {
+        DdsHeaderDx10 dx10;
+        if ( size < offset + sizeof(dx10) )
+        {
+            return false;
+        }
+        std::memcpy( &dx10, data + offset, sizeof(dx10) );
+        offset += sizeof(dx10);
+
+        // Only single 2D textures
+        if ( dx10.resourceDimension != 3 || dx10.arraySize > 1 )
+        {
+            return false;
+        }
+
+        this->format = FromDxgiFormat( dx10.dxgiFormat );
+    }
+    else
+    {
+        this->format = FromFourCC( header.pixelFormat.fourCC );
+    }
+
+    this->width     = header.width;
+    this->height    = header.height;
+    this->mipLevels = std::max( header.mipMapCount, 1u );
+
+    if ( this->format == VK_FORMAT_UNDEFINED || this->width == 0 ||
+         this->height == 0 ||
+         this->mipLevels > GetMipLevelCount( this->width, this->height ) )
+    {
+        return false;
+    }
+
+    // Levels follow the header back to back, largest first
+    for ( uint32_t level = 0; level < this->mipLevels; level++ )
+    {
+        this->levelOffsets.push_back( offset );
+        offset += this->getLevelSize( level );
+    }
+
+    return offset <= size;
+}
+
+bool IsCompressedTexturePath( const std::string& fileName )
+{
+    auto endsWith = [&]( const std::string& suffix ) {
+        return fileName.size() >= suffix.size() &&
+            fileName.compare( fileName.size() - suffix.size(),
+                              suffix.size(),
+                              suffix ) == 0;
+    };
+
+    return endsWith( ".ktx2" ) || endsWith( ".dds" );
+}
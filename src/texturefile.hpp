@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "utils.hpp"
+
+/*
+ * Texture Files
+ */
+
+// A pre-compressed 2D texture and its mip levels, mapped from a KTX2 or DDS
+// file. Only BC1, BC3, BC5 and BC7 without supercompression are accepted.
+class TextureFile
+{
+public:
+
+    VkFormat format    = VK_FORMAT_UNDEFINED;
+    uint32_t width     = 0;
+    uint32_t height    = 0;
+    uint32_t mipLevels = 0;
+
+    TextureFile() {}
+
+    ~TextureFile() { this->deinit(); }
+
+    // Returns false if the file is missing, malformed or in an unsupported
+    // format.
+    bool init( const std::string& fileName );
+
+    void deinit();
+
+    const uint8_t* getLevelData( uint32_t level ) const;
+
+    VkDeviceSize getLevelSize( uint32_t level ) const;
+
+    // Copies every level into one buffer, largest first, as Image expects.
+    std::vector<uint8_t> getPackedLevels() const;
+
+private:
+
+    MappedFile                file;
+    std::vector<VkDeviceSize> levelOffsets;
+
+    bool initKtx2();
+
+    bool initDds();
+};
+
+// True for file names ending in .ktx2 or .dds.
+bool IsCompressedTexturePath( const std::string& fileName );
@@ -0,0 +1,123 @@
+#include "common.hpp"
+#include "threadpool.hpp"
+
+void ThreadPool::init( uint32_t threadCount )
+{
+    this->deinit();
+
+    if ( threadCount == 0 )
+    {
+        threadCount = std::thread::hardware_concurrency();
+        threadCount = ( threadCount == 0 ) ? 1 : threadCount;
+    }
+
+    this->stopping = false;
+    for ( uint32_t i = 0; i < threadCount; i++ )
+    {
+        this->threads.emplace_back( &ThreadPool::work, this );
+    }
+}
+
+void ThreadPool::deinit()
+{
+    if ( this->threads.empty() )
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( this->mutex );
+        this->stopping = true;
+    }
+    this->condition.notify_all();
+
+    for ( auto& thread : this->threads )
+    {
+        thread.join();
+    }
+
+    this->threads.clear();
+}
+
+uint32_t ThreadPool::getThreadCount() const
+{
+    return (uint32_t)this->threads.size();
+}
+
+void ThreadPool::parallelFor(
+    std::size_t                                          count,
+    std::size_t                                          minRange,
+    const std::function<void(std::size_t, std::size_t)>& fn
+    )
+{
+    if ( count == 0 )
+    {
+        return;
+    }
+
+    minRange = ( minRange < 1 ) ? 1 : minRange;
+
+    std::size_t ranges = this->threads.size() + 1;
+    if ( ranges > ( count + minRange - 1 ) / minRange )
+    {
+        ranges = ( count + minRange - 1 ) / minRange;
+    }
+
+    std::size_t rangeSize = ( count + ranges - 1 ) / ranges;
+
+    std::vector<std::future<void>> pending;
+    for ( std::size_t begin = rangeSize; begin < count; begin += rangeSize )
+    {
+        std::size_t end = ( begin + rangeSize < count ) ? begin + rangeSize : count;
+
+        pending.emplace_back( this->submit( [&fn, begin, end]() { fn( begin, end ); } ) );
+    }
+
+    fn( 0, ( rangeSize < count ) ? rangeSize : count );
+
+    for ( auto& result : pending )
+    {
+        result.get();
+    }
+}
+
+void ThreadPool::enqueue( std::function<void()> task )
+{
+    // Without workers the task runs on the caller.
+    if ( this->threads.empty() )
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( this->mutex );
+        this->tasks.push( std::move( task ) );
+    }
+    this->condition.notify_one();
+}
+
+void ThreadPool::work()
+{
+    for ( ;; )
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock( this->mutex );
+            this->condition.wait( lock, [this]() {
+                    return this->stopping || !this->tasks.empty();
+                } );
+
+            if ( this->tasks.empty() )
+            {
+                return; // Stopping with nothing left to run
+            }
+
+            task = std::move( this->tasks.front() );
+            this->tasks.pop();
+        }
+
+        task();
+    }
+}
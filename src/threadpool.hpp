@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed set of worker threads pulling tasks from a shared queue.
+class ThreadPool
+{
+public:
+
+    ThreadPool() {}
+
+    ThreadPool( uint32_t threadCount )
+    {
+        this->init( threadCount );
+    }
+
+    ThreadPool( const ThreadPool& ) = delete;
+    ThreadPool& operator=( const ThreadPool& ) = delete;
+
+    ~ThreadPool() { this->deinit(); }
+
+    // A threadCount of 0 starts one worker per hardware thread.
+    void init( uint32_t threadCount = 0 );
+
+    // Finishes every queued task, then joins the workers.
+    void deinit();
+
+    uint32_t getThreadCount() const;
+
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submit( F task )
+    {
+        typedef typename std::result_of<F()>::type Result;
+
+        auto packaged = std::make_shared<std::packaged_task<Result()>>( task );
+        std::future<Result> result = packaged->get_future();
+
+        this->enqueue( [packaged]() { (*packaged)(); } );
+
+        return result;
+    }
+
+    // Splits [0, count) into contiguous ranges of at least minRange items,
+    // runs fn( begin, end ) for each and waits for all of them. The calling
+    // thread runs one range itself. Must not be called from a pool thread.
+    void parallelFor(
+        std::size_t                                          count,
+        std::size_t                                          minRange,
+        const std::function<void(std::size_t, std::size_t)>& fn
+        );
+
+private:
+
+    std::vector<std::thread>          threads;
+    std::queue<std::function<void()>> tasks;
+    std::mutex                        mutex;
+    std::condition_variable           condition;
+    bool                              stopping = false;
+
+    void enqueue( std::function<void()> task );
+
+    void work();
+};
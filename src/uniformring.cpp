@@ -0,0 +1,55 @@
+#include <cstring>
+
+#include "common.hpp"
+#include "uniformring.hpp"
+
+void UniformRing::init( Device*        device,
+                        UploadContext* upload,
+                        VkDeviceSize   blockSize,
+                        uint32_t       blocksPerFrame,
+                        uint32_t       frames )
+{
+    VkDeviceSize alignment = device->limits.minUniformBufferOffsetAlignment;
+    alignment = ( alignment > 0 ) ? alignment : 1;
+
+    this->blockSize      = blockSize;
+    this->stride         = ( blockSize + alignment - 1 ) / alignment * alignment;
+    this->blocksPerFrame = blocksPerFrame;
+    this->frames         = frames;
+
+    this->buffer.init( device,
+                       upload,
+                       this->stride * blocksPerFrame * frames,
+                       BufferUsage::UNIFORM,
+                       MemoryLocation::HOST );
+}
+
+void UniformRing::deinit()
+{
+    this->buffer.deinit();
+}
+
+uint32_t UniformRing::write( uint32_t    frame,
+                             uint32_t    block,
+                             const void* data,
+                             std::size_t size )
+{
+    assert( size <= this->blockSize );
+
+    uint32_t offset = this->getOffset( frame, block );
+    std::memcpy( (uint8_t*)this->buffer.memory.mapped + offset, data, size );
+
+    return offset;
+}
+
+uint32_t UniformRing::getOffset( uint32_t frame, uint32_t block ) const
+{
+    assert( frame < this->frames && block < this->blocksPerFrame );
+
+    return (uint32_t)( ( frame * this->blocksPerFrame + block ) * this->stride );
+}
+
+VkDeviceSize UniformRing::getBlockSize() const
+{
+    return this->blockSize;
+}
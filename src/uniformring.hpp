@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+class UploadContext;
+
+// A persistently mapped uniform buffer holding one slice per frame in
+// flight. Each slice has room for a number of uniform blocks, spaced by
+// minUniformBufferOffsetAlignment so every block can be bound as a
+// UNIFORM_BUFFER_DYNAMIC descriptor with its own dynamic offset.
+class UniformRing
+{
+public:
+
+    Buffer buffer;
+
+    UniformRing() {}
+
+    UniformRing( Device*        device,
+                 UploadContext* upload,
+                 VkDeviceSize   blockSize,
+                 uint32_t       blocksPerFrame,
+                 uint32_t       frames )
+    {
+        this->init( device, upload, blockSize, blocksPerFrame, frames );
+    }
+
+    ~UniformRing() { this->deinit(); }
+
+    void init( Device*        device,
+               UploadContext* upload,
+               VkDeviceSize   blockSize,
+               uint32_t       blocksPerFrame,
+               uint32_t       frames );
+
+    void deinit();
+
+    // Copies a uniform block into a frame's slice and returns its dynamic
+    // offset. The frame's previous GPU use must have completed.
+    uint32_t write( uint32_t    frame,
+                    uint32_t    block,
+                    const void* data,
+                    std::size_t size );
+
+    uint32_t getOffset( uint32_t frame, uint32_t block ) const;
+
+    // Range to use for the dynamic descriptor.
+    VkDeviceSize getBlockSize() const;
+
+private:
+
+    VkDeviceSize blockSize      = 0;
+    VkDeviceSize stride         = 0; // blockSize rounded up to the alignment
+    uint32_t     blocksPerFrame = 0;
+    uint32_t     frames         = 0;
+};
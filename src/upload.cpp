@@ -0,0 +1,443 @@
+#include <limits>
+#include <utility>
+
+#include "common.hpp"
+#include "upload.hpp"
+
+void UploadContext::init( Device*  device,
+                          VkQueue  transferQueue,
+                          uint32_t transferQueueIdx,
+                          VkQueue  graphicsQueue,
+                          uint32_t graphicsQueueIdx )
+{
+    this->device           = device;
+    this->queue            = transferQueue;
+    this->queueIdx         = transferQueueIdx;
+    this->graphicsQueue    = graphicsQueue;
+    this->graphicsQueueIdx = graphicsQueueIdx;
+
+    this->commandPool.init( device, transferQueue, transferQueueIdx );
+    if ( this->isDedicated() )
+    {
+        this->graphicsCommandPool.init( device, graphicsQueue, graphicsQueueIdx );
+    }
+
+    this->isRecording = false;
+    this->nextTicket  = 1;
+    this->completed   = 0;
+}
+
+void UploadContext::deinit()
+{
+    if ( this->device == nullptr )
+    {
+        return;
+    }
+
+    this->waitIdle();
+
+    for ( auto& batch : this->available )
+    {
+        this->device->destroyFence( batch.fence );
+        if ( batch.semaphore != VK_NULL_HANDLE )
+        {
+            this->device->destroySemaphore( batch.semaphore );
+        }
+    }
+    this->available.clear();
+
+    this->graphicsCommandPool.deinit();
+    this->commandPool.deinit();
+    this->device = nullptr;
+}
+
+CommandBuffer& UploadContext::getCommandBuffer()
+{
+    if ( this->isRecording )
+    {
+        return this->recording.commandBuffer;
+    }
+
+    this->retire();
+
+    // Reuse a completed batch's fence and command buffer when possible.
+    if ( !this->available.empty() )
+    {
+        this->recording = std::move( this->available.back() );
+        this->available.pop_back();
+
+        VK_CHECK_RESULT( this->device->resetFences( 1, &this->recording.fence ) );
+        this->recording.commandBuffer.reset();
+        if ( this->isDedicated() )
+        {
+            this->recording.acquireCommandBuffer.reset();
+        }
+    }
+    else
+    {
+        this->recording = Batch();
+
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VK_CHECK_RESULT( this->device->createFence( &fenceCreateInfo,
+                                                    &this->recording.fence ) );
+
+        this->recording.commandBuffer.init( this->device,
+                                            this->queue,
+                                            &this->commandPool );
+
+        if ( this->isDedicated() )
+        {
+            VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+            semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+            VK_CHECK_RESULT( this->device->createSemaphore(
+                                 &semaphoreCreateInfo,
+                                 &this->recording.semaphore
+                                 ) );
+
+            this->recording.acquireCommandBuffer.init( this->device,
+                                                       this->graphicsQueue,
+                                                       &this->graphicsCommandPool );
+        }
+    }
+
+    this->recording.ticket = this->nextTicket;
+    this->recording.commandBuffer.begin( CommandBufferUsage::ONE_TIME );
+    if ( this->isDedicated() )
+    {
+        this->recording.acquireCommandBuffer.begin( CommandBufferUsage::ONE_TIME );
+    }
+    this->isRecording = true;
+
+    return this->recording.commandBuffer;
+}
+
+CommandBuffer& UploadContext::getGraphicsCommandBuffer()
+{
+    CommandBuffer& commandBuffer = this->getCommandBuffer();
+
+    return this->isDedicated()
+        ? this->recording.acquireCommandBuffer
+        : commandBuffer;
+}
+
+void UploadContext::transferOwnership( VkBuffer             buffer,
+                                       VkAccessFlags        dstAccess,
+                                       VkPipelineStageFlags dstStage )
+{
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask       = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer              = buffer;
+    barrier.offset              = 0;
+    barrier.size                = VK_WHOLE_SIZE;
+
+    CommandBuffer& commandBuffer = this->getCommandBuffer();
+
+    if ( !this->isDedicated() )
+    {
+        commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       dstStage,
+                                       0,
+                                       0,
+                                       nullptr,
+                                       1,
+                                       &barrier,
+                                       0,
+                                       nullptr );
+        return;
+    }
+
+    barrier.srcQueueFamilyIndex = this->queueIdx;
+    barrier.dstQueueFamilyIndex = this->graphicsQueueIdx;
+
+    // Release on the transfer queue, destination access is ignored there
+    VkBufferMemoryBarrier release = barrier;
+    release.dstAccessMask = 0;
+
+    commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                   0,
+                                   0,
+                                   nullptr,
+                                   1,
+                                   &release,
+                                   0,
+                                   nullptr );
+
+    // Acquire on the graphics queue, source access is ignored there
+    VkBufferMemoryBarrier acquire = barrier;
+    acquire.srcAccessMask = 0;
+
+    this->recording.acquireCommandBuffer.pipelineBarrier(
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        dstStage,
+        0,
+        0,
+        nullptr,
+        1,
+        &acquire,
+        0,
+        nullptr
+        );
+}
+
+void UploadContext::transferOwnership( VkImage                        image,
+                                       const VkImageSubresourceRange& range,
+                                       VkImageLayout                  oldLayout,
+                                       VkImageLayout                  newLayout,
+                                       VkAccessFlags                  dstAccess,
+                                       VkPipelineStageFlags           dstStage )
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask       = dstAccess;
+    barrier.oldLayout           = oldLayout;
+    barrier.newLayout           = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image               = image;
+    barrier.subresourceRange    = range;
+
+    CommandBuffer& commandBuffer = this->getCommandBuffer();
+
+    if ( !this->isDedicated() )
+    {
+        commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       dstStage,
+                                       0,
+                                       0,
+                                       nullptr,
+                                       0,
+                                       nullptr,
+                                       1,
+                                       &barrier );
+        return;
+    }
+
+    // Both halves carry the same layout change, it is performed once
+    barrier.srcQueueFamilyIndex = this->queueIdx;
+    barrier.dstQueueFamilyIndex = this->graphicsQueueIdx;
+
+    VkImageMemoryBarrier release = barrier;
+    release.dstAccessMask = 0;
+
+    commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                   0,
+                                   0,
+                                   nullptr,
+                                   0,
+                                   nullptr,
+                                   1,
+                                   &release );
+
+    VkImageMemoryBarrier acquire = barrier;
+    acquire.srcAccessMask = 0;
+
+    this->recording.acquireCommandBuffer.pipelineBarrier(
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        dstStage,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &acquire
+        );
+}
+
+UploadTicket UploadContext::getTicket() const
+{
+    return this->nextTicket;
+}
+
+UploadTicket UploadContext::flush()
+{
+    if ( !this->isRecording )
+    {
+        this->retire();
+        return this->nextTicket - 1;
+    }
+
+    this->recording.commandBuffer.end();
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = this->recording.commandBuffer.getHandle();
+
+    if ( !this->isDedicated() )
+    {
+        VK_CHECK_RESULT( this->device->queueSubmit( this->queue,
+                                                    1,
+                                                    &submitInfo,
+                                                    this->recording.fence ) );
+    }
+    else
+    {
+        // The graphics half acquires ownership once the transfers are done,
+        // and its fence marks the whole batch complete.
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = &this->recording.semaphore;
+
+        VK_CHECK_RESULT( this->device->queueSubmit( this->queue,
+                                                    1,
+                                                    &submitInfo,
+                                                    VK_NULL_HANDLE ) );
+
+        this->recording.acquireCommandBuffer.end();
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkSubmitInfo acquireInfo = {};
+        acquireInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireInfo.waitSemaphoreCount = 1;
+        acquireInfo.pWaitSemaphores    = &this->recording.semaphore;
+        acquireInfo.pWaitDstStageMask  = &waitStage;
+        acquireInfo.commandBufferCount = 1;
+        acquireInfo.pCommandBuffers    = this->recording.acquireCommandBuffer.getHandle();
+
+        VK_CHECK_RESULT( this->device->queueSubmit( this->graphicsQueue,
+                                                    1,
+                                                    &acquireInfo,
+                                                    this->recording.fence ) );
+    }
+
+    UploadTicket ticket = this->recording.ticket;
+
+    this->pending.push_back( std::move( this->recording ) );
+    this->recording   = Batch();
+    this->isRecording = false;
+    this->nextTicket++;
+
+    this->retire();
+
+    return ticket;
+}
+
+bool UploadContext::isComplete( UploadTicket ticket )
+{
+    if ( ticket > this->completed )
+    {
+        this->retire();
+    }
+
+    return ticket <= this->completed;
+}
+
+void UploadContext::wait( UploadTicket ticket )
+{
+    if ( ticket <= this->completed )
+    {
+        return;
+    }
+
+    if ( this->isRecording && ticket >= this->recording.ticket )
+    {
+        this->flush();
+    }
+
+    while ( !this->pending.empty() && this->pending.front().ticket <= ticket )
+    {
+        Batch& batch = this->pending.front();
+
+        VK_CHECK_RESULT( this->device->waitForFences(
+                             1,
+                             &batch.fence,
+                             VK_TRUE,
+                             std::numeric_limits<uint64_t>::max()
+                             ) );
+
+        this->completed = batch.ticket;
+        this->release( batch );
+        this->available.push_back( std::move( batch ) );
+        this->pending.pop_front();
+    }
+}
+
+void UploadContext::waitIdle()
+{
+    this->flush();
+    this->wait( this->nextTicket - 1 );
+}
+
+void UploadContext::deferRelease( VkBuffer buffer, Allocation allocation )
+{
+    Release release;
+    release.buffer     = buffer;
+    release.allocation = allocation;
+
+    this->deferRelease( release );
+}
+
+void UploadContext::deferRelease( VkImage image, Allocation allocation )
+{
+    Release release;
+    release.image      = image;
+    release.allocation = allocation;
+
+    this->deferRelease( release );
+}
+
+bool UploadContext::isDedicated() const
+{
+    return this->queueIdx != this->graphicsQueueIdx;
+}
+
+void UploadContext::retire()
+{
+    while ( !this->pending.empty() &&
+            this->device->getFenceStatus( this->pending.front().fence ) == VK_SUCCESS )
+    {
+        Batch& batch = this->pending.front();
+
+        this->completed = batch.ticket;
+        this->release( batch );
+        this->available.push_back( std::move( batch ) );
+        this->pending.pop_front();
+    }
+}
+
+void UploadContext::deferRelease( const Release& release )
+{
+    if ( this->isRecording )
+    {
+        this->recording.releases.push_back( release );
+    }
+    else if ( !this->pending.empty() )
+    {
+        this->pending.back().releases.push_back( release );
+    }
+    else
+    {
+        // Nothing in flight can read it, so it can go right away.
+        Batch batch;
+        batch.releases.push_back( release );
+        this->release( batch );
+    }
+}
+
+void UploadContext::release( Batch& batch )
+{
+    for ( auto& release : batch.releases )
+    {
+        if ( release.buffer != VK_NULL_HANDLE )
+        {
+            this->device->destroyBuffer( release.buffer );
+        }
+        if ( release.image != VK_NULL_HANDLE )
+        {
+            this->device->destroyImage( release.image );
+        }
+        this->device->allocator.free( release.allocation );
+    }
+    batch.releases.clear();
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "allocator.hpp"
+#include "commandbuffer.hpp"
+#include "common.hpp"
+#include "device.hpp"
+
+// Records buffer and image uploads from many resources into one command
+// buffer and submits them together, tracking completion with a fence per
+// batch instead of idling the queue around every copy. Tickets increase
+// monotonically and batches complete in the order they were submitted.
+//
+// Copies run on the transfer queue. When that belongs to a different family
+// than the graphics queue, each batch also records a graphics command buffer
+// that acquires ownership of the uploaded resources, submitted after the
+// transfer work completes.
+class UploadContext
+{
+public:
+
+    UploadContext() {}
+
+    UploadContext( Device*  device,
+                   VkQueue  transferQueue,
+                   uint32_t transferQueueIdx,
+                   VkQueue  graphicsQueue,
+                   uint32_t graphicsQueueIdx )
+    {
+        this->init( device,
+                    transferQueue,
+                    transferQueueIdx,
+                    graphicsQueue,
+                    graphicsQueueIdx );
+    }
+
+    ~UploadContext() { this->deinit(); }
+
+    void init( Device*  device,
+               VkQueue  transferQueue,
+               uint32_t transferQueueIdx,
+               VkQueue  graphicsQueue,
+               uint32_t graphicsQueueIdx );
+
+    void deinit();
+
+    // Returns the transfer command buffer of the batch being recorded,
+    // starting a new batch if none is open.
+    CommandBuffer& getCommandBuffer();
+
+    // Returns the command buffer of the batch that executes on the graphics
+    // queue after the batch's transfers. Used for work the transfer queue
+    // cannot do, such as transitions into attachment layouts.
+    CommandBuffer& getGraphicsCommandBuffer();
+
+    // Makes transfer writes to a resource visible to the given graphics
+    // stage, moving it to the graphics queue family if needed.
+    void transferOwnership( VkBuffer             buffer,
+                            VkAccessFlags        dstAccess,
+                            VkPipelineStageFlags dstStage );
+    void transferOwnership( VkImage                        image,
+                            const VkImageSubresourceRange& range,
+                            VkImageLayout                  oldLayout,
+                            VkImageLayout                  newLayout,
+                            VkAccessFlags                  dstAccess,
+                            VkPipelineStageFlags           dstStage );
+
+    // Returns the ticket of the batch currently being recorded.
+    UploadTicket getTicket() const;
+
+    // Submits the batch being recorded and returns its ticket.
+    UploadTicket flush();
+
+    bool isComplete( UploadTicket ticket );
+
+    // Blocks until the batch with the given ticket has executed, submitting
+    // it first if it is still being recorded.
+    void wait( UploadTicket ticket );
+
+    void waitIdle();
+
+    // Destroys a staging resource once the batch reading it has completed.
+    void deferRelease( VkBuffer buffer, Allocation allocation );
+    void deferRelease( VkImage image, Allocation allocation );
+
+    // True when uploads run on a queue family other than graphics.
+    bool isDedicated() const;
+
+private:
+
+    struct Release
+    {
+        VkBuffer   buffer = VK_NULL_HANDLE;
+        VkImage    image  = VK_NULL_HANDLE;
+        Allocation allocation;
+    };
+
+    struct Batch
+    {
+        UploadTicket         ticket    = 0;
+        VkFence              fence     = VK_NULL_HANDLE;
+        VkSemaphore          semaphore = VK_NULL_HANDLE; // Dedicated only
+        CommandBuffer        commandBuffer;
+        CommandBuffer        acquireCommandBuffer;       // Dedicated only
+        std::vector<Release> releases;
+    };
+
+    Device*            device           = nullptr;
+    VkQueue            queue            = VK_NULL_HANDLE;
+    uint32_t           queueIdx         = 0;
+    VkQueue            graphicsQueue    = VK_NULL_HANDLE;
+    uint32_t           graphicsQueueIdx = 0;
+    CommandPool        commandPool;
+    CommandPool        graphicsCommandPool;
+    Batch              recording;
+    bool               isRecording = false;
+    std::deque<Batch>  pending;   // Submitted, oldest first
+    std::vector<Batch> available; // Completed, ready for reuse
+    UploadTicket       nextTicket = 1;
+    UploadTicket       completed  = 0;
+
+    // Reclaims every pending batch whose fence has signalled.
+    void retire();
+
+    void deferRelease( const Release& release );
+
+    void release( Batch& batch );
+};
@@ -1,5 +1,14 @@
+#include <cstdio>
 #include <cstring>
 #include <fstream>
+
+#if !defined( WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "common.hpp"
 #include "utils.hpp"
 
@@ -24,10 +33,175 @@ std::vector<uint8_t> ReadFile( const std::string& filename )
 
 }
 
+bool WriteFileAtomic( const std::string&            filename,
+                      const std::vector<FilePiece>& pieces )
+{
+    std::string tmpName = filename + ".tmp";
+    {
+        std::ofstream file( tmpName, std::ios::binary | std::ios::trunc );
+
+        if ( !file.is_open() )
+        {
+            return false;
+        }
+
+        for ( const auto& piece : pieces )
+        {
+            file.write( (const char*)piece.data, piece.size );
+        }
+
+        if ( !file.good() )
+        {
+            file.close();
+            std::remove( tmpName.c_str() );
+            return false;
+        }
+    }
+
+#if defined( WIN32 )
+    // rename() will not replace an existing file on Windows
+    std::remove( filename.c_str() );
+#endif
+
+    if ( std::rename( tmpName.c_str(), filename.c_str() ) != 0 )
+    {
+        std::remove( tmpName.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+bool WriteFileAtomic( const std::string& filename,
+                      const void*        data,
+                      std::size_t        size )
+{
+    return WriteFileAtomic( filename, { { data, size } } );
+}
+
+bool MappedFile::init( const std::string& filename )
+{
+    this->deinit();
+
+#if defined( WIN32 )
+    std::ifstream file( filename, std::ios::ate | std::ios::binary );
+
+    if ( !file.is_open() )
+    {
+        return false;
+    }
+
+    this->contents.resize( (std::size_t) file.tellg() );
+    file.seekg( 0 );
+    file.read( reinterpret_cast<char*>(this->contents.data()),
+               this->contents.size() );
+
+    this->data = this->contents.data();
+    this->size = this->contents.size();
+#else
+    int fd = open( filename.c_str(), O_RDONLY );
+
+    if ( fd < 0 )
+    {
+        return false;
+    }
+
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 )
+    {
+        close( fd );
+        return false;
+    }
+
+    this->size = (std::size_t)info.st_size;
+
+    if ( this->size > 0 )
+    {
+        void* mapped = mmap( nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+        if ( mapped == MAP_FAILED )
+        {
+            close( fd );
+            this->size = 0;
+            return false;
+        }
+
+        this->data = (const uint8_t*)mapped;
+    }
+
+    // The mapping keeps the file referenced on its own
+    close( fd );
+#endif
+
+    return true;
+}
+
+void MappedFile::deinit()
+{
+#if defined( WIN32 )
+    this->contents.clear();
+#else
+    if ( this->data != nullptr )
+    {
+        munmap( (void*)this->data, this->size );
+    }
+#endif
+
+    this->data = nullptr;
+    this->size = 0;
+}
+
+const uint8_t* MappedFile::getData() const
+{
+    return this->data;
+}
+
+std::size_t MappedFile::getSize() const
+{
+    return this->size;
+}
+
+/*
+ * Hashing
+ */
+
+uint64_t HashBytes( const void* data, std::size_t size, uint64_t hash )
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    for ( std::size_t i = 0; i < size; i++ )
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
 /*
  * Formats
  */
 
+bool IsFormatSupported( VkPhysicalDevice     physical,
+                        VkFormat             format,
+                        VkImageTiling        tiling,
+                        VkFormatFeatureFlags features )
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties( physical, format, &props );
+
+    if ( tiling == VK_IMAGE_TILING_LINEAR )
+    {
+        return ( props.linearTilingFeatures & features ) == features;
+    }
+    else if ( tiling == VK_IMAGE_TILING_OPTIMAL )
+    {
+        return ( props.optimalTilingFeatures & features ) == features;
+    }
+
+    return false;
+}
+
 VkFormat FindSupportedFormat( VkPhysicalDevice             physical,
                               const std::vector<VkFormat>& candidates,
                               VkImageTiling                tiling,
@@ -35,34 +209,92 @@ VkFormat FindSupportedFormat( VkPhysicalDevice             physical,
 {
     for ( VkFormat format : candidates )
     {
-        VkFormatProperties props;
-        vkGetPhysicalDeviceFormatProperties( physical, format, &props );
-
-        if ( tiling == VK_IMAGE_TILING_LINEAR &&
-             ( props.linearTilingFeatures & features ) == features )
-        {
-            return format;
-        }
-        else if ( tiling == VK_IMAGE_TILING_OPTIMAL &&
-                  ( props.optimalTilingFeatures & features ) == features )
+        if ( IsFormatSupported( physical, format, tiling, features ) )
         {
             return format;
         }
     }
 
-    std::cerr << __FILE__ << " " << __func__ << " " << __LINE__ << ": Failed to find supported format" << std::endl;
-    assert( 0 );
-    return (VkFormat)VK_NULL_HANDLE;
+    return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t GetFormatTexelSize( VkFormat format )
+{
+    switch ( format )
+    {
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SRGB:
+        return 1;
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R8G8_SRGB:
+        return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        std::cerr << __FILE__ << " " << __func__ << " " << __LINE__ << ": Unsupported texel format!" << std::endl;
+        assert( 0 );
+        return 0;
+    }
+}
+
+uint32_t GetFormatBlockSize( VkFormat format )
+{
+    switch ( format )
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+VkDeviceSize GetImageLevelSize( VkFormat format,
+                                uint32_t width,
+                                uint32_t height )
+{
+    uint32_t blockSize = GetFormatBlockSize( format );
+
+    if ( blockSize != 0 )
+    {
+        return (VkDeviceSize)( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * blockSize;
+    }
+
+    return (VkDeviceSize)width * height * GetFormatTexelSize( format );
 }
 
 VkFormat FindDepthFormat( VkPhysicalDevice physical )
 {
-    return FindSupportedFormat(
+    VkFormat format = FindSupportedFormat(
         physical,
         { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
         VK_IMAGE_TILING_OPTIMAL,
         VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
         );
+
+    if ( format == VK_FORMAT_UNDEFINED )
+    {
+        std::cerr << __FILE__ << " " << __func__ << " " << __LINE__ << ": Failed to find supported format" << std::endl;
+        assert( 0 );
+    }
+
+    return format;
 }
 
 /*
@@ -92,7 +324,14 @@ QueueFamilyIndices FindQueueFamilies( VkPhysicalDevice device, VkSurfaceKHR surf
         }
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR( device, i, surface, &presentSupport );
+        if ( surface != VK_NULL_HANDLE )
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR( device, i, surface, &presentSupport );
+        }
+        else
+        {
+            presentSupport = indices.graphicsFamily == i;
+        }
         if ( qfamily.queueCount > 0 && presentSupport )
         {
             indices.presentFamily = i;
@@ -106,6 +345,31 @@ QueueFamilyIndices FindQueueFamilies( VkPhysicalDevice device, VkSurfaceKHR surf
         i++;
     }
 
+    // Prefer a transfer only family (usually a DMA engine), then any other
+    // family without graphics, before falling back to the graphics family.
+    indices.transferFamily = indices.graphicsFamily;
+
+    i = 0;
+    for ( const auto& qfamily : qfamilies )
+    {
+        if ( qfamily.queueCount > 0 &&
+             ( qfamily.queueFlags & VK_QUEUE_TRANSFER_BIT ) &&
+             !( qfamily.queueFlags & VK_QUEUE_GRAPHICS_BIT ) )
+        {
+            if ( !( qfamily.queueFlags & VK_QUEUE_COMPUTE_BIT ) )
+            {
+                indices.transferFamily = i;
+                break;
+            }
+            if ( indices.transferFamily == indices.graphicsFamily )
+            {
+                indices.transferFamily = i;
+            }
+        }
+
+        i++;
+    }
+
     return indices;
 }
 
@@ -113,17 +377,22 @@ QueueFamilyIndices FindQueueFamilies( VkPhysicalDevice device, VkSurfaceKHR surf
  * Extensions
  */
 
-std::vector<const char*> GetRequiredExtensions( bool validate )
+std::vector<const char*> GetRequiredExtensions( bool validate,
+                                                bool headless )
 {
     std::vector<const char*> extensions;
 
-    unsigned int glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions( &glfwExtensionCount );
-
-    for ( auto i = 0; i < glfwExtensionCount; i++ )
+    // Surface extensions are only needed when presenting to a window.
+    if ( !headless )
     {
-        extensions.push_back( glfwExtensions[ i ] );
+        unsigned int glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions( &glfwExtensionCount );
+
+        for ( auto i = 0; i < glfwExtensionCount; i++ )
+        {
+            extensions.push_back( glfwExtensions[ i ] );
+        }
     }
 
     if ( validate )
@@ -232,8 +501,9 @@ bool IsDeviceSuitable(
         requiredExtensions
         );
 
-    bool adequateSwapChain = false;
-    if ( requiredExtensionsSupported )
+    // Headless rendering has no surface and therefore needs no swapchain.
+    bool adequateSwapChain = ( surface == VK_NULL_HANDLE );
+    if ( requiredExtensionsSupported && surface != VK_NULL_HANDLE )
     {
         auto swapchainSupport = QuerySwapChainSupport( physical, surface );
         adequateSwapChain = !swapchainSupport.formats.empty() &&
@@ -13,15 +13,102 @@
 
 std::vector<uint8_t> ReadFile( const std::string& filename );
 
+// A piece of a file written by WriteFileAtomic.
+struct FilePiece
+{
+    const void* data;
+    std::size_t size;
+};
+
+// Writes pieces back to back to a temporary file next to filename and
+// renames it into place, so readers never see a partly written file. On
+// WIN32 the existing file is removed before the rename, so that path is
+// not atomic. Returns false, leaving no temporary file behind, if any step
+// fails.
+bool WriteFileAtomic( const std::string&            filename,
+                      const std::vector<FilePiece>& pieces );
+
+bool WriteFileAtomic( const std::string& filename,
+                      const void*        data,
+                      std::size_t        size );
+
+// Read-only view of a whole file, memory mapped where the platform allows.
+class MappedFile
+{
+public:
+
+    MappedFile() {}
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    ~MappedFile() { this->deinit(); }
+
+    // Returns false if the file cannot be opened.
+    bool init( const std::string& filename );
+
+    void deinit();
+
+    const uint8_t* getData() const;
+
+    std::size_t getSize() const;
+
+private:
+
+    const uint8_t* data = nullptr;
+    std::size_t    size = 0;
+#if defined( WIN32 )
+    std::vector<uint8_t> contents;
+#endif
+};
+
+/*
+ * Hashing
+ */
+
+const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+// 64 bit FNV-1a. Passing a previous result as hash extends it, so several
+// pieces of data can be hashed as if they were contiguous.
+uint64_t HashBytes( const void* data,
+                    std::size_t size,
+                    uint64_t    hash = HASH_SEED );
+
+// Appends the bytes of value to key, for cache keys compared byte for byte.
+template<typename T>
+void AppendKey( std::vector<uint8_t>& key, const T& value )
+{
+    const uint8_t* bytes = (const uint8_t*)&value;
+    key.insert( key.end(), bytes, bytes + sizeof(T) );
+}
+
 /*
  * Formats
  */
 
+bool IsFormatSupported( VkPhysicalDevice     physical,
+                        VkFormat             format,
+                        VkImageTiling        tiling,
+                        VkFormatFeatureFlags features );
+
+// Returns the first candidate with the features, or VK_FORMAT_UNDEFINED.
 VkFormat FindSupportedFormat( VkPhysicalDevice             physical,
                               const std::vector<VkFormat>& candidates,
                               VkImageTiling                tiling,
                               VkFormatFeatureFlags         features );
 
+// Bytes per texel of an uncompressed color format.
+uint32_t GetFormatTexelSize( VkFormat format );
+
+// Bytes per 4x4 block of a block compressed format, 0 for other formats.
+uint32_t GetFormatBlockSize( VkFormat format );
+
+// Bytes used by one tightly packed width x height image level. Block
+// compressed levels are rounded up to whole blocks.
+VkDeviceSize GetImageLevelSize( VkFormat format,
+                                uint32_t width,
+                                uint32_t height );
+
 VkFormat FindDepthFormat( VkPhysicalDevice physical );
 
 /*
@@ -32,10 +119,12 @@ struct QueueFamilyIndices
 {
     int graphicsFamily = -1;
     int presentFamily  = -1;
+    int transferFamily = -1; // Equals graphicsFamily when no separate family exists
 
     bool isComplete(  );
 };
 
+// Passing VK_NULL_HANDLE for surface selects the graphics family for presentation.
 QueueFamilyIndices FindQueueFamilies( VkPhysicalDevice device,
                                       VkSurfaceKHR surface );
 
@@ -43,7 +132,8 @@ QueueFamilyIndices FindQueueFamilies( VkPhysicalDevice device,
  * Extensions
  */
 
-std::vector<const char*> GetRequiredExtensions( bool validate );
+std::vector<const char*> GetRequiredExtensions( bool validate,
+                                                bool headless = false );
 
 bool CheckDeviceExtensionSupport(
     VkPhysicalDevice               device,
@@ -0,0 +1,183 @@
+#include <cstring>
+
+#include "common.hpp"
+#include "vertexformat.hpp"
+
+/*
+ * Vertex Formats
+ */
+
+bool ParsePositionFormat( const std::string& name, PositionFormat* format )
+{
+    if ( name == "float" )
+    {
+        *format = PositionFormat::FLOAT32;
+    }
+    else if ( name == "snorm16" )
+    {
+        *format = PositionFormat::SNORM16;
+    }
+    else if ( name == "half" )
+    {
+        *format = PositionFormat::HALF;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool ParseTexCoordFormat( const std::string& name, TexCoordFormat* format )
+{
+    if ( name == "float" )
+    {
+        *format = TexCoordFormat::FLOAT32;
+    }
+    else if ( name == "unorm16" )
+    {
+        *format = TexCoordFormat::UNORM16;
+    }
+    else if ( name == "half" )
+    {
+        *format = TexCoordFormat::HALF;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+uint16_t FloatToHalf( float value )
+{
+    uint32_t bits;
+    std::memcpy( &bits, &value, sizeof(bits) );
+
+    uint32_t sign     = ( bits >> 16 ) & 0x8000;
+    int32_t  exponent = (int32_t)( ( bits >> 23 ) & 0xFF ) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // NaN and infinity
+    if ( ( ( bits >> 23 ) & 0xFF ) == 0xFF )
+    {
+        return (uint16_t)( sign | 0x7C00 | ( mantissa ? 0x200 : 0 ) );
+    }
+
+    // Overflow to infinity
+    if ( exponent >= 31 )
+    {
+        return (uint16_t)( sign | 0x7C00 );
+    }
+
+    // Denormals, or zero when too small
+    if ( exponent <= 0 )
+    {
+        if ( exponent < -10 )
+        {
+            return (uint16_t)sign;
+        }
+
+        mantissa |= 0x800000;
+        uint32_t shift   = (uint32_t)( 14 - exponent );
+        uint32_t half    = mantissa >> shift;
+        uint32_t rest    = mantissa & ( ( 1u << shift ) - 1 );
+        uint32_t halfway = 1u << ( shift - 1 );
+
+        // Round to nearest even
+        if ( rest > halfway || ( rest == halfway && ( half & 1 ) ) )
+        {
+            half++;
+        }
+
+        return (uint16_t)( sign | half );
+    }
+
+    uint32_t half = sign | ( (uint32_t)exponent << 10 ) | ( mantissa >> 13 );
+    uint32_t rest = mantissa & 0x1FFF;
+
+    // Round to nearest even, carrying into the exponent if needed
+    if ( rest > 0x1000 || ( rest == 0x1000 && ( half & 1 ) ) )
+    {
+        half++;
+    }
+
+    return (uint16_t)half;
+}
+
+/*
+ * Vertex Layout
+ */
+
+uint32_t VertexLayout::getPositionSize() const
+{
+    // Three component 16 bit formats are rarely supported for vertex input,
+    // so those are padded to four components
+    return ( this->position == PositionFormat::FLOAT32 ) ? 12 : 8;
+}
+
+uint32_t VertexLayout::getTexCoordSize() const
+{
+    return ( this->texCoord == TexCoordFormat::FLOAT32 ) ? 8 : 4;
+}
+
+uint32_t VertexLayout::getStride() const
+{
+    return this->getPositionSize() + this->getTexCoordSize();
+}
+
+VkVertexInputBindingDescription VertexLayout::getBindingDescription() const
+{
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.binding   = 0;
+    bindingDescription.stride    = this->getStride();
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexLayout::getAttributeDescriptions() const
+{
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions( 2 );
+
+    attributeDescriptions[0].binding  = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].offset   = 0;
+    switch ( this->position )
+    {
+    case PositionFormat::FLOAT32:
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        break;
+    case PositionFormat::SNORM16:
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+        break;
+    case PositionFormat::HALF:
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        break;
+    }
+
+    attributeDescriptions[1].binding  = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].offset   = this->getPositionSize();
+    switch ( this->texCoord )
+    {
+    case TexCoordFormat::FLOAT32:
+        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+        break;
+    case TexCoordFormat::UNORM16:
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_UNORM;
+        break;
+    case TexCoordFormat::HALF:
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+        break;
+    }
+
+    return attributeDescriptions;
+}
+
+uint32_t VertexLayout::getKey() const
+{
+    return ( (uint32_t)this->position << 4 ) | (uint32_t)this->texCoord;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+/*
+ * Vertex Formats
+ */
+
+enum class PositionFormat : uint32_t
+{
+    FLOAT32 = 0, // 12 bytes
+    SNORM16 = 1, // 8 bytes, normalized to the mesh bounds
+    HALF    = 2  // 8 bytes, normalized to the mesh bounds
+};
+
+enum class TexCoordFormat : uint32_t
+{
+    FLOAT32 = 0, // 8 bytes
+    UNORM16 = 1, // 4 bytes, normalized to the texture coordinate bounds
+    HALF    = 2  // 4 bytes
+};
+
+// Accepts "float", "snorm16" or "half". Returns false for anything else.
+bool ParsePositionFormat( const std::string& name, PositionFormat* format );
+
+// Accepts "float", "unorm16" or "half". Returns false for anything else.
+bool ParseTexCoordFormat( const std::string& name, TexCoordFormat* format );
+
+uint16_t FloatToHalf( float value );
+
+/*
+ * Vertex Layout
+ */
+
+// The packed vertex uploaded to the GPU: a position at location 0 followed
+// by a texture coordinate at location 1, in a single binding.
+struct VertexLayout
+{
+    PositionFormat position = PositionFormat::FLOAT32;
+    TexCoordFormat texCoord = TexCoordFormat::FLOAT32;
+
+    uint32_t getPositionSize() const;
+
+    uint32_t getTexCoordSize() const;
+
+    uint32_t getStride() const;
+
+    VkVertexInputBindingDescription getBindingDescription() const;
+
+    std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+
+    // Distinguishes layouts in caches, unique per format combination.
+    uint32_t getKey() const;
+};
+
+// Vertex shader push constants that undo the normalization of quantized
+// attributes: value = offset + scale * stored. Matches shader.vert.
+struct MeshDequantization
+{
+    glm::vec4 positionScale       = glm::vec4( 1.0f );
+    glm::vec4 positionOffset      = glm::vec4( 0.0f );
+    glm::vec4 texCoordScaleOffset = glm::vec4( 1.0f, 1.0f, 0.0f, 0.0f ); // xy scale, zw offset
+};
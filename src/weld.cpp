@@ -0,0 +1,275 @@
+#include <cstring>
+
+#include "common.hpp"
+#include "threadpool.hpp"
+#include "weld.hpp"
+
+static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+static const uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+
+static inline uint64_t RotateLeft( uint64_t value, int bits )
+{
+    return ( value << bits ) | ( value >> ( 64 - bits ) );
+}
+
+// Final avalanche from MurmurHash3.
+static inline uint64_t Finalize( uint64_t hash )
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+static std::size_t NextPowerOfTwo( std::size_t value )
+{
+    std::size_t result = 1;
+    while ( result < value )
+    {
+        result <<= 1;
+    }
+
+    return result;
+}
+
+/*
+ * Vertex Welding
+ */
+
+uint64_t HashVertex( const void* vertex, uint32_t stride )
+{
+    const uint8_t* bytes = (const uint8_t*)vertex;
+    uint64_t       hash  = HASH_PRIME_2 ^ stride;
+    uint32_t       i     = 0;
+
+    for ( ; i + 8 <= stride; i += 8 )
+    {
+        uint64_t word;
+        std::memcpy( &word, bytes + i, sizeof(word) );
+
+        hash ^= RotateLeft( word * HASH_PRIME_1, 31 ) * HASH_PRIME_2;
+        hash  = RotateLeft( hash, 27 ) * HASH_PRIME_1;
+    }
+
+    for ( ; i < stride; i++ )
+    {
+        hash ^= bytes[i] * HASH_PRIME_2;
+        hash  = RotateLeft( hash, 11 ) * HASH_PRIME_1;
+    }
+
+    return Finalize( hash );
+}
+
+namespace
+{
+    struct Slot
+    {
+        uint32_t tag;   // Upper hash bits, checked before comparing vertices
+        uint32_t index; // Shard local vertex index
+    };
+
+    // Welds the vertices whose top shardBits hash bits equal shard, writing
+    // shard local indices into remap. Hashes are recomputed when null.
+    class ShardWelder
+    {
+    public:
+
+        const uint8_t*         vertices;
+        uint32_t               stride;
+        const uint64_t*        hashes;
+        uint32_t*              remap;
+        std::vector<uint32_t>& firsts;
+
+        ShardWelder( const uint8_t*         vertices,
+                     uint32_t               stride,
+                     const uint64_t*        hashes,
+                     uint32_t*              remap,
+                     std::vector<uint32_t>& firsts ) :
+            vertices( vertices ),
+            stride( stride ),
+            hashes( hashes ),
+            remap( remap ),
+            firsts( firsts )
+        {}
+
+        void weld( std::size_t count,
+                   uint32_t    shard,
+                   uint32_t    shardBits,
+                   std::size_t expectedUnique )
+        {
+            this->resize( NextPowerOfTwo( expectedUnique * 2 + 64 ) );
+            this->firsts.clear();
+            this->firsts.reserve( expectedUnique );
+
+            for ( std::size_t i = 0; i < count; i++ )
+            {
+                uint64_t hash = this->hashOf( (uint32_t)i );
+
+                if ( shardBits > 0 && ( hash >> ( 64 - shardBits ) ) != shard )
+                {
+                    continue;
+                }
+
+                const uint8_t* vertex = this->vertices + i * this->stride;
+                uint32_t       tag    = (uint32_t)( hash >> 32 );
+                std::size_t    pos    = (std::size_t)hash & this->mask;
+
+                for ( ;; )
+                {
+                    Slot& slot = this->slots[ pos ];
+
+                    if ( slot.index == EMPTY_SLOT )
+                    {
+                        slot.tag   = tag;
+                        slot.index = (uint32_t)this->firsts.size();
+                        this->firsts.push_back( (uint32_t)i );
+                        this->remap[ i ] = slot.index;
+
+                        // Keep the load factor at or below one half
+                        if ( this->firsts.size() * 2 > this->slots.size() )
+                        {
+                            this->resize( this->slots.size() * 2 );
+                        }
+                        break;
+                    }
+
+                    if ( slot.tag == tag &&
+                         std::memcmp( this->vertices +
+                                      (std::size_t)this->firsts[ slot.index ] * this->stride,
+                                      vertex,
+                                      this->stride ) == 0 )
+                    {
+                        this->remap[ i ] = slot.index;
+                        break;
+                    }
+
+                    pos = ( pos + 1 ) & this->mask;
+                }
+            }
+        }
+
+    private:
+
+        std::vector<Slot> slots;
+        std::size_t       mask = 0;
+
+        uint64_t hashOf( uint32_t i ) const
+        {
+            return ( this->hashes != nullptr )
+                ? this->hashes[ i ]
+                : HashVertex( this->vertices + (std::size_t)i * this->stride,
+                              this->stride );
+        }
+
+        void resize( std::size_t capacity )
+        {
+            Slot empty = { 0, EMPTY_SLOT };
+
+            this->slots.assign( capacity, empty );
+            this->mask = capacity - 1;
+
+            for ( uint32_t index = 0; index < this->firsts.size(); index++ )
+            {
+                uint64_t    hash = this->hashOf( this->firsts[ index ] );
+                std::size_t pos  = (std::size_t)hash & this->mask;
+
+                while ( this->slots[ pos ].index != EMPTY_SLOT )
+                {
+                    pos = ( pos + 1 ) & this->mask;
+                }
+
+                this->slots[ pos ].tag   = (uint32_t)( hash >> 32 );
+                this->slots[ pos ].index = index;
+            }
+        }
+    };
+}
+
+void WeldVertices( const void*            vertices,
+                   uint32_t               stride,
+                   std::size_t            count,
+                   std::vector<uint32_t>& remap,
+                   std::vector<uint32_t>& firsts,
+                   ThreadPool*            pool )
+{
+    assert( count < EMPTY_SLOT );
+
+    const uint8_t* bytes = (const uint8_t*)vertices;
+
+    remap.resize( count );
+    firsts.clear();
+
+    // Meshes usually reference each vertex several times, so start with room
+    // for a quarter of the inputs and let the table grow past that.
+    if ( pool == nullptr || pool->getThreadCount() == 0 )
+    {
+        ShardWelder welder( bytes, stride, nullptr, remap.data(), firsts );
+        welder.weld( count, 0, 0, count / 4 );
+        return;
+    }
+
+    std::vector<uint64_t> hashes( count );
+    pool->parallelFor( count, 16384, [&]( std::size_t begin, std::size_t end ) {
+            for ( std::size_t i = begin; i < end; i++ )
+            {
+                hashes[ i ] = HashVertex( bytes + i * stride, stride );
+            }
+        } );
+
+    // Several shards per thread keeps the threads busy when shards differ in size
+    uint32_t shardBits = 0;
+    while ( ( 1u << shardBits ) < pool->getThreadCount() * 4 && shardBits < 8 )
+    {
+        shardBits++;
+    }
+    uint32_t shardCount = 1u << shardBits;
+
+    std::vector<std::vector<uint32_t>> shardFirsts( shardCount );
+    pool->parallelFor( shardCount, 1, [&]( std::size_t begin, std::size_t end ) {
+            for ( std::size_t shard = begin; shard < end; shard++ )
+            {
+                ShardWelder welder( bytes,
+                                    stride,
+                                    hashes.data(),
+                                    remap.data(),
+                                    shardFirsts[ shard ] );
+                welder.weld( count,
+                             (uint32_t)shard,
+                             shardBits,
+                             count / 4 / shardCount );
+            }
+        } );
+
+    // Number the unique vertices in order of first appearance, matching the
+    // serial result, and translate shard local indices to global ones.
+    std::vector<std::vector<uint32_t>> shardGlobal( shardCount );
+    std::vector<std::size_t>           seen( shardCount, 0 );
+    std::size_t                        unique = 0;
+
+    for ( uint32_t shard = 0; shard < shardCount; shard++ )
+    {
+        shardGlobal[ shard ].resize( shardFirsts[ shard ].size() );
+        unique += shardFirsts[ shard ].size();
+    }
+    firsts.reserve( unique );
+
+    for ( std::size_t i = 0; i < count; i++ )
+    {
+        uint32_t shard = (uint32_t)( hashes[ i ] >> ( 64 - shardBits ) );
+        uint32_t local = remap[ i ];
+
+        if ( local == seen[ shard ] )
+        {
+            shardGlobal[ shard ][ local ] = (uint32_t)firsts.size();
+            firsts.push_back( (uint32_t)i );
+            seen[ shard ]++;
+        }
+
+        remap[ i ] = shardGlobal[ shard ][ local ];
+    }
+}
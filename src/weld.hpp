@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/*
+ * Vertex Welding
+ */
+
+// Hashes the raw bytes of a vertex. Vertices are compared bytewise, so
+// types passed to the welder must not contain uninitialized padding.
+uint64_t HashVertex( const void* vertex, uint32_t stride );
+
+// Merges identical vertices in a stream of count vertices, each stride
+// bytes long, using an open addressing hash table.
+//
+// remap receives the output index of every input vertex. firsts receives,
+// for each unique vertex in order of first appearance, the position in the
+// input where it first occurs, so the welded vertex array is
+// input[ firsts[0] ], input[ firsts[1] ], ...
+//
+// With a pool, vertices are sharded by hash and each shard is welded on
+// its own thread. The result is identical to the serial one.
+void WeldVertices( const void*            vertices,
+                   uint32_t               stride,
+                   std::size_t            count,
+                   std::vector<uint32_t>& remap,
+                   std::vector<uint32_t>& firsts,
+                   ThreadPool*            pool = nullptr );
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "bcencoder.hpp"
+#include "threadpool.hpp"
+
+static const int TEXELS = 16;
+
+namespace
+{
+    struct Color
+    {
+        float r, g, b;
+    };
+}
+
+static uint16_t PackRGB565( const Color& color )
+{
+    int r = (int)std::lround( std::min( std::max( color.r, 0.0f ), 255.0f ) * 31.0f / 255.0f );
+    int g = (int)std::lround( std::min( std::max( color.g, 0.0f ), 255.0f ) * 63.0f / 255.0f );
+    int b = (int)std::lround( std::min( std::max( color.b, 0.0f ), 255.0f ) * 31.0f / 255.0f );
+
+    return (uint16_t)( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+static Color UnpackRGB565( uint16_t packed )
+{
+    int r = ( packed >> 11 ) & 31;
+    int g = ( packed >> 5 ) & 63;
+    int b = packed & 31;
+
+    return { (float)( ( r << 3 ) | ( r >> 2 ) ),
+             (float)( ( g << 2 ) | ( g >> 4 ) ),
+             (float)( ( b << 3 ) | ( b >> 2 ) ) };
+}
+
+static float DistanceSquared( const Color& a, const Color& b )
+{
+    float dr = a.r - b.r;
+    float dg = a.g - b.g;
+    float db = a.b - b.b;
+
+    return dr * dr + dg * dg + db * db;
+}
+
+// Picks the nearest of the four palette entries for every texel. Returns
+// the total squared error.
+static float SelectColorIndices( const Color* texels,
+                                 uint16_t     color0,
+                                 uint16_t     color1,
+                                 uint8_t*     indices )
+{
+    Color c0 = UnpackRGB565( color0 );
+    Color c1 = UnpackRGB565( color1 );
+    Color palette[4] = {
+        c0,
+        c1,
+        { ( 2.0f * c0.r + c1.r ) / 3.0f, ( 2.0f * c0.g + c1.g ) / 3.0f, ( 2.0f * c0.b + c1.b ) / 3.0f },
+        { ( c0.r + 2.0f * c1.r ) / 3.0f, ( c0.g + 2.0f * c1.g ) / 3.0f, ( c0.b + 2.0f * c1.b ) / 3.0f }
+    };
+
+    float error = 0.0f;
+    for ( int i = 0; i < TEXELS; i++ )
+    {
+        float best = DistanceSquared( texels[i], palette[0] );
+        indices[i] = 0;
+
+        for ( uint8_t p = 1; p < 4; p++ )
+        {
+            float distance = DistanceSquared( texels[i], palette[p] );
+            if ( distance < best )
+            {
+                best       = distance;
+                indices[i] = p;
+            }
+        }
+
+        error += best;
+    }
+
+    return error;
+}
+
+// Orders endpoints for four color mode, in which color0 > color1.
+static void OrderEndpoints( uint16_t& color0, uint16_t& color1 )
+{
+    if ( color0 < color1 )
+    {
+        std::swap( color0, color1 );
+    }
+}
+
+// Endpoints from the extremes of the texels along their principal axis,
+// refined once by least squares against the chosen indices.
+static void EncodeColorBlock( const uint8_t* rgba, uint8_t* block )
+{
+    Color texels[TEXELS];
+    Color mean = { 0.0f, 0.0f, 0.0f };
+    for ( int i = 0; i < TEXELS; i++ )
+    {
+        texels[i] = { (float)rgba[ i * 4 + 0 ],
+                      (float)rgba[ i * 4 + 1 ],
+                      (float)rgba[ i * 4 + 2 ] };
+        mean.r += texels[i].r / TEXELS;
+        mean.g += texels[i].g / TEXELS;
+        mean.b += texels[i].b / TEXELS;
+    }
+
+    // Covariance, then its principal eigenvector by power iteration
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for ( int i = 0; i < TEXELS; i++ )
+    {
+        float r = texels[i].r - mean.r;
+        float g = texels[i].g - mean.g;
+        float b = texels[i].b - mean.b;
+
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+
+    Color axis = { 1.0f, 1.0f, 1.0f };
+    for ( int iteration = 0; iteration < 8; iteration++ )
+    {
+        Color next = {
+            covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+            covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+            covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b
+        };
+        float length = std::max( std::max( std::fabs( next.r ), std::fabs( next.g ) ),
+                                 std::fabs( next.b ) );
+        if ( length == 0.0f )
+        {
+            break;
+        }
+
+        axis = { next.r / length, next.g / length, next.b / length };
+    }
+
+    float minProjection = 0.0f;
+    float maxProjection = 0.0f;
+    Color minColor      = texels[0];
+    Color maxColor      = texels[0];
+    for ( int i = 0; i < TEXELS; i++ )
+    {
+        float projection = ( texels[i].r - mean.r ) * axis.r +
+            ( texels[i].g - mean.g ) * axis.g +
+            ( texels[i].b - mean.b ) * axis.b;
+
+        if ( i == 0 || projection < minProjection )
+        {
+            minProjection = projection;
+            minColor      = texels[i];
+        }
+        if ( i == 0 || projection > maxProjection )
+        {
+            maxProjection = projection;
+            maxColor      = texels[i];
+        }
+    }
+
+    // Pull the endpoints in slightly, the extremes are rarely optimal
+    Color inset = { ( maxColor.r - minColor.r ) / 16.0f,
+                    ( maxColor.g - minColor.g ) / 16.0f,
+                    ( maxColor.b - minColor.b ) / 16.0f };
+    maxColor = { maxColor.r - inset.r, maxColor.g - inset.g, maxColor.b - inset.b };
+    minColor = { minColor.r + inset.r, minColor.g + inset.g, minColor.b + inset.b };
+
+    uint16_t color0 = PackRGB565( maxColor );
+    uint16_t color1 = PackRGB565( minColor );
+    OrderEndpoints( color0, color1 );
+
+    uint8_t indices[TEXELS];
+    float   error = SelectColorIndices( texels, color0, color1, indices );
+
+    // Least squares fit of both endpoints to the texels, given their
+    // interpolation weights
+    static const float WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    Color ax = { 0.0f, 0.0f, 0.0f };
+    Color bx = { 0.0f, 0.0f, 0.0f };
+    for ( int i = 0; i < TEXELS; i++ )
+    {
+        float a = WEIGHTS[ indices[i] ];
+        float b = 1.0f - a;
+
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        ax  = { ax.r + a * texels[i].r, ax.g + a * texels[i].g, ax.b + a * texels[i].b };
+        bx  = { bx.r + b * texels[i].r, bx.g + b * texels[i].g, bx.b + b * texels[i].b };
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if ( color0 != color1 && std::fabs( determinant ) > 1e-6f )
+    {
+        float scale = 1.0f / determinant;
+        Color end0  = { ( ax.r * bb - bx.r * ab ) * scale,
+                        ( ax.g * bb - bx.g * ab ) * scale,
+                        ( ax.b * bb - bx.b * ab ) * scale };
+        Color end1  = { ( bx.r * aa - ax.r * ab ) * scale,
+                        ( bx.g * aa - ax.g * ab ) * scale,
+                        ( bx.b * aa - ax.b * ab ) * scale };
+
+        uint16_t refined0 = PackRGB565( end0 );
+        uint16_t refined1 = PackRGB565( end1 );
+        OrderEndpoints( refined0, refined1 );
+
+        uint8_t refinedIndices[TEXELS];
+        float   refinedError = SelectColorIndices( texels,
+                                                   refined0,
+                                                   refined1,
+                                                   refinedIndices );
+        if ( refined0 != refined1 && refinedError < error )
+        {
+            color0 = refined0;
+            color1 = refined1;
+            std::memcpy( indices, refinedIndices, sizeof(indices) );
+        }
+    }
+
+    uint32_t bits = 0;
+    for ( int i = 0; i < TEXELS; i++ )
+    {
+        bits |= (uint32_t)indices[i] << ( 2 * i );
+    }
+
+    block[0] = (uint8_t)( color0 & 0xFF );
+    block[1] = (uint8_t)( color0 >> 8 );
+    block[2] = (uint8_t)( color1 & 0xFF );
+    block[3] = (uint8_t)( color1 >> 8 );
+    std::memcpy( block + 4, &bits, sizeof(bits) );
+}
+
+// Single channel block shared by BC3 alpha and both BC5 channels, always
+// in eight value mode.
+static void EncodeChannelBlock( const uint8_t* rgba, int channel, uint8_t* block )
+{
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+    for ( int i = 0; i < TEXELS; i++ )
+    {
+        minValue = std::min( minValue, rgba[ i * 4 + channel ] );
+        maxValue = std::max( maxValue, rgba[ i * 4 + channel ] );
+    }
+
+    block[0] = maxValue;
+    block[1] = minValue;
+
+    uint64_t bits = 0;
+    if ( maxValue > minValue )
+    {
+        float range = (float)( maxValue - minValue );
+        for ( int i = 0; i < TEXELS; i++ )
+        {
+            // Rank 0 is the minimum and 7 the maximum, palette indices
+            // order them as max, min, then interpolants from max to min
+            float    t    = (float)( rgba[ i * 4 + channel ] - minValue ) / range;
+            uint32_t rank = (uint32_t)std::lround( t * 7.0f );
+            uint64_t index;
+
+            if ( rank == 7 )
+            {
+                index = 0;
+            }
+            else if ( rank == 0 )
+            {
+                index = 1;
+            }
+            else
+            {
+                index = 8 - rank;
+            }
+
+            bits |= index << ( 3 * i );
+        }
+    }
+
+    for ( int i = 0; i < 6; i++ )
+    {
+        block[ 2 + i ] = (uint8_t)( bits >> ( 8 * i ) );
+    }
+}
+
+/*
+ * Block Compression
+ */
+
+uint32_t GetBlockSize( BlockFormat format )
+{
+    return ( format == BlockFormat::BC1 ) ? 8 : 16;
+}
+
+void EncodeBC1Block( const uint8_t* texels, uint8_t* block )
+{
+    EncodeColorBlock( texels, block );
+}
+
+void EncodeBC3Block( const uint8_t* texels, uint8_t* block )
+{
+    EncodeChannelBlock( texels, 3, block );
+    EncodeColorBlock( texels, block + 8 );
+}
+
+void EncodeBC5Block( const uint8_t* texels, uint8_t* block )
+{
+    EncodeChannelBlock( texels, 0, block );
+    EncodeChannelBlock( texels, 1, block + 8 );
+}
+
+void EncodeLevel( BlockFormat           format,
+                  const uint8_t*        pixels,
+                  uint32_t              width,
+                  uint32_t              height,
+                  std::vector<uint8_t>& blocks,
+                  ThreadPool*           pool )
+{
+    uint32_t blocksWide = ( width + 3 ) / 4;
+    uint32_t blocksHigh = ( height + 3 ) / 4;
+    uint32_t blockSize  = GetBlockSize( format );
+
+    blocks.resize( (std::size_t)blocksWide * blocksHigh * blockSize );
+
+    auto encodeRows = [&]( std::size_t begin, std::size_t end ) {
+        uint8_t texels[ TEXELS * 4 ];
+
+        for ( std::size_t by = begin; by < end; by++ )
+        {
+            for ( uint32_t bx = 0; bx < blocksWide; bx++ )
+            {
+                for ( uint32_t y = 0; y < 4; y++ )
+                {
+                    for ( uint32_t x = 0; x < 4; x++ )
+                    {
+                        uint32_t px = std::min( bx * 4 + x, width - 1 );
+                        uint32_t py = std::min( (uint32_t)by * 4 + y, height - 1 );
+
+                        std::memcpy( texels + ( y * 4 + x ) * 4,
+                                     pixels + ( (std::size_t)py * width + px ) * 4,
+                                     4 );
+                    }
+                }
+
+                uint8_t* block = blocks.data() +
+                    ( by * blocksWide + bx ) * blockSize;
+
+                switch ( format )
+                {
+                case BlockFormat::BC1:
+                    EncodeBC1Block( texels, block );
+                    break;
+                case BlockFormat::BC3:
+                    EncodeBC3Block( texels, block );
+                    break;
+                case BlockFormat::BC5:
+                    EncodeBC5Block( texels, block );
+                    break;
+                }
+            }
+        }
+    };
+
+    if ( pool != nullptr )
+    {
+        pool->parallelFor( blocksHigh, 4, encodeRows );
+    }
+    else
+    {
+        encodeRows( 0, blocksHigh );
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/*
+ * Block Compression
+ */
+
+enum class BlockFormat
+{
+    BC1, // RGB, 8 bytes per block
+    BC3, // RGBA, 16 bytes per block
+    BC5  // Red and green, 16 bytes per block, for normal maps
+};
+
+uint32_t GetBlockSize( BlockFormat format );
+
+// Each encodes one 4x4 block of 8 bit RGBA texels, 64 bytes in row order.
+void EncodeBC1Block( const uint8_t* texels, uint8_t* block );
+void EncodeBC3Block( const uint8_t* texels, uint8_t* block );
+void EncodeBC5Block( const uint8_t* texels, uint8_t* block );
+
+// Compresses a whole 8 bit RGBA level. Blocks that run past the edge of the
+// image repeat its last row and column. With a pool, rows of blocks are
+// encoded in parallel.
+void EncodeLevel( BlockFormat           format,
+                  const uint8_t*        pixels,
+                  uint32_t              width,
+                  uint32_t              height,
+                  std::vector<uint8_t>& blocks,
+                  ThreadPool*           pool = nullptr );
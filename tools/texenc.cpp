@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "bcencoder.hpp"
+#include "mipmap.hpp"
+#include "threadpool.hpp"
+
+// Converts a JPEG or PNG into a block compressed KTX2 file with a full mip
+// chain, which the renderer's Texture loads in place of the source image.
+
+static const uint8_t KTX2_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+// Khronos Data Format color models and channel ids for the basic
+// descriptor block
+static const uint8_t KHR_DF_MODEL_BC1A = 128;
+static const uint8_t KHR_DF_MODEL_BC3  = 130;
+static const uint8_t KHR_DF_MODEL_BC5  = 132;
+
+static const uint8_t KHR_DF_CHANNEL_BC1A_COLOR = 0;
+static const uint8_t KHR_DF_CHANNEL_BC3_COLOR  = 0;
+static const uint8_t KHR_DF_CHANNEL_BC3_ALPHA  = 15;
+static const uint8_t KHR_DF_CHANNEL_BC5_RED    = 0;
+static const uint8_t KHR_DF_CHANNEL_BC5_GREEN  = 1;
+
+static void PrintUsage( const char* program )
+{
+    std::cerr << "Usage: " << program
+              << " [--format bc1|bc3|bc5] [--no-mips] INPUT OUTPUT.ktx2"
+              << std::endl
+              << "Without --format, images with alpha use bc3 and others bc1."
+              << std::endl;
+}
+
+static bool ParseBlockFormat( const char* name, BlockFormat* format )
+{
+    if ( strcmp( name, "bc1" ) == 0 )
+    {
+        *format = BlockFormat::BC1;
+    }
+    else if ( strcmp( name, "bc3" ) == 0 )
+    {
+        *format = BlockFormat::BC3;
+    }
+    else if ( strcmp( name, "bc5" ) == 0 )
+    {
+        *format = BlockFormat::BC5;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static VkFormat GetVkFormat( BlockFormat format )
+{
+    switch ( format )
+    {
+    case BlockFormat::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case BlockFormat::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case BlockFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+static const char* GetFormatName( BlockFormat format )
+{
+    switch ( format )
+    {
+    case BlockFormat::BC1: return "BC1";
+    case BlockFormat::BC3: return "BC3";
+    case BlockFormat::BC5: return "BC5";
+    }
+
+    return "";
+}
+
+template<typename T>
+static void Append( std::vector<uint8_t>& out, T value )
+{
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert( out.end(), bytes, bytes + sizeof(value) );
+}
+
+// Builds the data format descriptor the KTX2 specification requires.
+static std::vector<uint8_t> BuildDataFormatDescriptor( BlockFormat format )
+{
+    struct Sample
+    {
+        uint8_t channel;
+        uint8_t bitOffset;
+    };
+
+    uint8_t             model;
+    std::vector<Sample> samples;
+    switch ( format )
+    {
+    case BlockFormat::BC1:
+        model   = KHR_DF_MODEL_BC1A;
+        samples = { { KHR_DF_CHANNEL_BC1A_COLOR, 0 } };
+        break;
+    case BlockFormat::BC3:
+        model   = KHR_DF_MODEL_BC3;
+        samples = { { KHR_DF_CHANNEL_BC3_ALPHA, 0 }, { KHR_DF_CHANNEL_BC3_COLOR, 64 } };
+        break;
+    case BlockFormat::BC5:
+    default:
+        model   = KHR_DF_MODEL_BC5;
+        samples = { { KHR_DF_CHANNEL_BC5_RED, 0 }, { KHR_DF_CHANNEL_BC5_GREEN, 64 } };
+        break;
+    }
+
+    uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+
+    std::vector<uint8_t> dfd;
+    Append<uint32_t>( dfd, 4 + blockSize );         // dfdTotalSize
+    Append<uint32_t>( dfd, 0 );                     // Khronos vendor, basic descriptor
+    Append<uint32_t>( dfd, 2 | ( blockSize << 16 ) ); // Version 1.3
+    Append<uint8_t>( dfd, model );
+    Append<uint8_t>( dfd, 1 );                      // BT.709 primaries
+    Append<uint8_t>( dfd, 1 );                      // Linear transfer
+    Append<uint8_t>( dfd, 0 );                      // Straight alpha
+    Append<uint32_t>( dfd, 3 | ( 3 << 8 ) );        // 4x4x1x1 texel block
+    Append<uint32_t>( dfd, GetBlockSize( format ) ); // bytesPlane0
+    Append<uint32_t>( dfd, 0 );
+
+    for ( const auto& sample : samples )
+    {
+        Append<uint16_t>( dfd, sample.bitOffset );
+        Append<uint8_t>( dfd, 63 );                 // bitLength - 1
+        Append<uint8_t>( dfd, sample.channel );
+        Append<uint32_t>( dfd, 0 );                 // Sample position
+        Append<uint32_t>( dfd, 0 );                 // sampleLower
+        Append<uint32_t>( dfd, UINT32_MAX );        // sampleUpper
+    }
+
+    return dfd;
+}
+
+// Writes levels, largest first, without supercompression. The file stores
+// them smallest first as the specification recommends.
+static bool WriteKtx2( const std::string&                       fileName,
+                       BlockFormat                              format,
+                       uint32_t                                 width,
+                       uint32_t                                 height,
+                       const std::vector<std::vector<uint8_t>>& levels )
+{
+    uint32_t             levelCount = (uint32_t)levels.size();
+    std::vector<uint8_t> dfd        = BuildDataFormatDescriptor( format );
+    uint64_t             alignment  = GetBlockSize( format );
+
+    uint32_t dfdOffset  = 80 + 24 * levelCount;
+    uint64_t dataOffset = dfdOffset + dfd.size();
+
+    std::vector<uint64_t> offsets( levelCount );
+    for ( uint32_t level = levelCount; level-- > 0; )
+    {
+        dataOffset      = ( dataOffset + alignment - 1 ) / alignment * alignment;
+        offsets[level]  = dataOffset;
+        dataOffset     += levels[level].size();
+    }
+
+    std::vector<uint8_t> header( KTX2_IDENTIFIER, KTX2_IDENTIFIER + 12 );
+    Append<uint32_t>( header, GetVkFormat( format ) );
+    Append<uint32_t>( header, 1 );          // typeSize
+    Append<uint32_t>( header, width );
+    Append<uint32_t>( header, height );
+    Append<uint32_t>( header, 0 );          // pixelDepth
+    Append<uint32_t>( header, 0 );          // layerCount
+    Append<uint32_t>( header, 1 );          // faceCount
+    Append<uint32_t>( header, levelCount );
+    Append<uint32_t>( header, 0 );          // No supercompression
+    Append<uint32_t>( header, dfdOffset );
+    Append<uint32_t>( header, (uint32_t)dfd.size() );
+    Append<uint32_t>( header, 0 );          // No key/value data
+    Append<uint32_t>( header, 0 );
+    Append<uint64_t>( header, 0 );          // No supercompression data
+    Append<uint64_t>( header, 0 );
+
+    for ( uint32_t level = 0; level < levelCount; level++ )
+    {
+        Append<uint64_t>( header, offsets[level] );
+        Append<uint64_t>( header, levels[level].size() );
+        Append<uint64_t>( header, levels[level].size() );
+    }
+    header.insert( header.end(), dfd.begin(), dfd.end() );
+
+    std::ofstream file( fileName, std::ios::binary | std::ios::trunc );
+    if ( !file.is_open() )
+    {
+        return false;
+    }
+
+    file.write( (const char*)header.data(), header.size() );
+
+    uint64_t position = header.size();
+    for ( uint32_t level = levelCount; level-- > 0; )
+    {
+        static const char padding[16] = {};
+
+        file.write( padding, offsets[level] - position );
+        file.write( (const char*)levels[level].data(), levels[level].size() );
+        position = offsets[level] + levels[level].size();
+    }
+
+    return file.good();
+}
+
+int main( int argc, char** argv )
+{
+    BlockFormat format    = BlockFormat::BC1;
+    bool        hasFormat = false;
+    bool        mips      = true;
+    const char* input     = nullptr;
+    const char* output    = nullptr;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[i], "--format" ) == 0 && i + 1 < argc &&
+             ParseBlockFormat( argv[i + 1], &format ) )
+        {
+            hasFormat = true;
+            i++;
+        }
+        else if ( strcmp( argv[i], "--no-mips" ) == 0 )
+        {
+            mips = false;
+        }
+        else if ( input == nullptr && argv[i][0] != '-' )
+        {
+            input = argv[i];
+        }
+        else if ( output == nullptr && argv[i][0] != '-' )
+        {
+            output = argv[i];
+        }
+        else
+        {
+            PrintUsage( argv[0] );
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ( input == nullptr || output == nullptr )
+    {
+        PrintUsage( argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    int      width, height, channels;
+    stbi_uc* pixels = stbi_load( input, &width, &height, &channels, STBI_rgb_alpha );
+    if ( pixels == nullptr )
+    {
+        std::cerr << "Failed to load " << input << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if ( !hasFormat )
+    {
+        format = ( channels == 2 || channels == 4 ) ? BlockFormat::BC3 : BlockFormat::BC1;
+    }
+
+    ThreadPool pool( 0 );
+
+    uint32_t             levelCount = mips ? GetMipLevelCount( width, height ) : 1;
+    std::vector<uint8_t> chain;
+    GenerateMipChain( pixels, width, height, levelCount, chain, &pool );
+    stbi_image_free( pixels );
+
+    std::vector<std::vector<uint8_t>> levels( levelCount );
+    std::size_t                       offset = 0;
+    std::size_t                       total  = 0;
+    for ( uint32_t level = 0; level < levelCount; level++ )
+    {
+        uint32_t levelWidth  = std::max( (uint32_t)width >> level, 1u );
+        uint32_t levelHeight = std::max( (uint32_t)height >> level, 1u );
+
+        EncodeLevel( format,
+                     chain.data() + offset,
+                     levelWidth,
+                     levelHeight,
+                     levels[level],
+                     &pool );
+
+        offset += (std::size_t)levelWidth * levelHeight * 4;
+        total  += levels[level].size();
+    }
+
+    if ( !WriteKtx2( output, format, width, height, levels ) )
+    {
+        std::cerr << "Failed to write " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Wrote " << output << ": " << GetFormatName( format ) << ", "
+              << width << "x" << height << ", " << levelCount << " levels, "
+              << total << " bytes (" << (double)chain.size() / (double)total
+              << "x smaller than RGBA8)" << std::endl;
+
+    return EXIT_SUCCESS;
+}